@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common/latency.hpp"
+
+// Minimal harness shared by the benchmark executables. Each case writes one
+// JSON object per line: its name, parameters, iteration count, mean and
+// percentile time per operation, and throughput. Lines from several runs can
+// be collected into a file and compared between releases.
+//
+// Options: --filter=<text> runs only the cases whose name contains <text>,
+// --min-time=<seconds> sets how long each case runs (default 0.5),
+// --out=<file> appends the results to <file> instead of stdout.
+class BenchRunner {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Params = std::vector<std::pair<std::string, uint64_t>>;
+
+    // What a case processed per operation, for the throughput columns
+    struct Work {
+        uint64_t items = 0;
+        uint64_t bytes = 0;
+    };
+
+private:
+    std::string filter_;
+    double min_seconds_ = 0.5;
+    std::ofstream file_;
+    std::ostream* out_ = &std::cout;
+
+    static const char* option(const char* arg, const char* name) {
+        size_t length = std::strlen(name);
+        return std::strncmp(arg, name, length) == 0 ? arg + length : nullptr;
+    }
+
+public:
+    BenchRunner(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (const char* value = option(argv[i], "--filter=")) {
+                filter_ = value;
+            } else if (const char* value = option(argv[i], "--min-time=")) {
+                min_seconds_ = std::stod(value);
+            } else if (const char* value = option(argv[i], "--out=")) {
+                file_.open(value, std::ios::app);
+                if (file_) out_ = &file_;
+                else std::cerr << "Cannot open " << value << ", writing to stdout" << std::endl;
+            }
+        }
+    }
+
+    double min_seconds() const { return min_seconds_; }
+
+    bool enabled(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    // Runs `body` until min_seconds() have passed, timing every call
+    template <typename Body>
+    void run(const std::string& name, const Params& params, Work work, Body&& body) {
+        if (!enabled(name)) return;
+
+        // One untimed call warms caches and grows reused buffers
+        body();
+
+        LatencyHistogram histogram;
+        uint64_t iterations = 0;
+        auto begin = Clock::now();
+        auto deadline = begin + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(min_seconds_));
+        auto now = begin;
+        while (now < deadline) {
+            body();
+            auto end = Clock::now();
+            histogram.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - now).count()));
+            now = end;
+            ++iterations;
+        }
+        report(name, params, work, histogram, iterations, now - begin);
+    }
+
+    // Writes the result of a case that timed itself
+    void report(const std::string& name, const Params& params, Work work,
+                const LatencyHistogram& histogram, uint64_t iterations, Clock::duration elapsed) {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        double per_second = seconds > 0 ? static_cast<double>(iterations) / seconds : 0.0;
+
+        auto& out = *out_;
+        out << "{\"benchmark\":\"" << name << "\"";
+        for (const auto& param : params) out << ",\"" << param.first << "\":" << param.second;
+        out << ",\"iterations\":" << iterations
+            << ",\"ns_per_op\":" << (iterations ? seconds * 1e9 / static_cast<double>(iterations) : 0.0)
+            << ",\"p50_ns\":" << histogram.percentile(0.5)
+            << ",\"p99_ns\":" << histogram.percentile(0.99)
+            << ",\"p999_ns\":" << histogram.percentile(0.999)
+            << ",\"max_ns\":" << histogram.max()
+            << ",\"ops_per_second\":" << per_second;
+        if (work.items) out << ",\"items_per_second\":" << per_second * static_cast<double>(work.items);
+        if (work.bytes) out << ",\"bytes_per_second\":" << per_second * static_cast<double>(work.bytes);
+        out << "}" << std::endl;
+    }
+};
+
+// Keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+// Benchmark groups of quicsim_bench
+void run_protocol_benchmarks(BenchRunner& runner);
+void run_ring_benchmarks(BenchRunner& runner);
+void run_quic_benchmarks(BenchRunner& runner);
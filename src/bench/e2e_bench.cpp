@@ -0,0 +1,113 @@
+#include "bench.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <yaml-cpp/yaml.h>
+#include "quicclient/client.hpp"
+#include "quicserver/server.hpp"
+
+namespace {
+
+constexpr uint64_t kStepSizeUs = 1000;
+
+// Runs steps until every client has answered; false after `timeout`
+bool lockstep(QuicServer& server, std::chrono::seconds timeout) {
+    if (!server.step(kStepSizeUs)) return false;
+    auto deadline = BenchRunner::Clock::now() + timeout;
+    while (!server.collect_responses()) {
+        if (BenchRunner::Clock::now() > deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+}  // namespace
+
+// Full step rate of a configuration: the server in this process steps in
+// lockstep, waiting for every client's response before the next request.
+// The hosts named after the configuration run in this process over shared
+// memory; any other client is started separately and connects as usual.
+//
+//   quicsim_bench_e2e <config> [host ...] [--min-time=<s>] [--out=<file>]
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]).rfind("--", 0) != 0) args.emplace_back(argv[i]);
+    }
+    if (args.empty()) {
+        std::cout << "Usage: " << argv[0] << " <config> [host ...] [--min-time=<s>] [--out=<file>]" << std::endl;
+        return 1;
+    }
+    BenchRunner runner(argc, argv);
+    const std::string& config_path = args.front();
+
+    uint64_t client_count = 0;
+    try {
+        client_count = YAML::LoadFile(config_path)["clients"].size();
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading " << config_path << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // A segment left behind by an aborted run would keep the server from starting
+    boost::interprocess::shared_memory_object::remove("simulation_shared_memory");
+    int result = 1;
+    {
+        QuicServer server(config_path);
+        if (!server.init()) {
+            std::cerr << "Failed to initialize server" << std::endl;
+            return 1;
+        }
+
+        std::vector<std::unique_ptr<QuicClient>> hosts;
+        for (size_t i = 1; i < args.size(); ++i) {
+            hosts.push_back(std::make_unique<QuicClient>(config_path, args[i]));
+            if (!hosts.back()->init_local()) {
+                std::cerr << "Failed to attach host " << args[i] << std::endl;
+                return 1;
+            }
+        }
+
+        std::atomic<bool> running{true};
+        std::thread serve([&hosts, &running] {
+            while (running.load(std::memory_order_relaxed)) {
+                for (auto& host : hosts) host->poll_local();
+            }
+        });
+
+        // The first steps also wait for the clients to connect and say Hello
+        bool ok = lockstep(server, std::chrono::seconds(30));
+        for (int i = 0; ok && i < 100; ++i) ok = lockstep(server, std::chrono::seconds(10));
+
+        if (ok) {
+            LatencyHistogram histogram;
+            uint64_t steps = 0;
+            auto begin = BenchRunner::Clock::now();
+            auto deadline = begin + std::chrono::duration_cast<BenchRunner::Clock::duration>(
+                std::chrono::duration<double>(runner.min_seconds()));
+            auto now = begin;
+            while (ok && now < deadline) {
+                ok = lockstep(server, std::chrono::seconds(10));
+                auto end = BenchRunner::Clock::now();
+                histogram.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - now).count()));
+                now = end;
+                ++steps;
+            }
+            if (ok) {
+                runner.report("e2e/step", {{"clients", client_count}, {"step_us", kStepSizeUs}},
+                              {client_count, 0}, histogram, steps, now - begin);
+                result = 0;
+            }
+        }
+        if (!ok) std::cerr << "A step failed or a client stopped answering" << std::endl;
+
+        running.store(false, std::memory_order_relaxed);
+        serve.join();
+    }
+    boost::interprocess::shared_memory_object::remove("simulation_shared_memory");
+    return result;
+}
@@ -0,0 +1,11 @@
+#include "bench.hpp"
+
+// Microbenchmarks of the step path: message encoding and decoding, response
+// routing, shared-memory ring and QUIC loopback round trips
+int main(int argc, char* argv[]) {
+    BenchRunner runner(argc, argv);
+    run_protocol_benchmarks(runner);
+    run_ring_benchmarks(runner);
+    run_quic_benchmarks(runner);
+    return 0;
+}
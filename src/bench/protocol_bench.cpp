@@ -0,0 +1,249 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "simulation_protocol_generated.h"
+#include "quicserver/routing.hpp"
+
+namespace {
+
+const size_t kSizes[] = {10000, 100000};
+constexpr uint64_t kTimestep = 1000;
+constexpr uint32_t kProducer = 1;
+constexpr uint32_t kConsumer = 2;
+
+// Variable i has reference i. Seven in ten are reals, two integers and one a
+// boolean, roughly the mix of a plant model.
+SimProtocol::ValueType type_of(size_t i) {
+    if (i % 10 < 7) return SimProtocol::ValueType_Real;
+    if (i % 10 < 9) return SimProtocol::ValueType_Integer;
+    return SimProtocol::ValueType_Boolean;
+}
+
+// Values of one step, held per type as an FMU wrapper holds them
+struct Signals {
+    std::vector<uint32_t> real_refs, integer_refs, boolean_refs;
+    std::vector<double> reals;
+    std::vector<int32_t> integers;
+    std::vector<uint8_t> booleans;
+
+    explicit Signals(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            auto ref = static_cast<uint32_t>(i);
+            switch (type_of(i)) {
+                case SimProtocol::ValueType_Real:
+                    real_refs.push_back(ref);
+                    reals.push_back(0.5 * static_cast<double>(i));
+                    break;
+                case SimProtocol::ValueType_Integer:
+                    integer_refs.push_back(ref);
+                    integers.push_back(static_cast<int32_t>(i));
+                    break;
+                default:
+                    boolean_refs.push_back(ref);
+                    booleans.push_back(static_cast<uint8_t>(i % 2));
+                    break;
+            }
+        }
+    }
+};
+
+template <typename T>
+flatbuffers::Offset<flatbuffers::Vector<T>> copy_vector(flatbuffers::FlatBufferBuilder& builder,
+                                                        const std::vector<T>& source) {
+    T* data = nullptr;
+    auto vector = builder.CreateUninitializedVector(source.size(), &data);
+    std::copy(source.begin(), source.end(), data);
+    return vector;
+}
+
+flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SimProtocol::Variable>>> write_variables(
+    flatbuffers::FlatBufferBuilder& builder, const Signals& signals,
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>>& offsets) {
+    offsets.clear();
+    for (size_t i = 0; i < signals.reals.size(); ++i) {
+        offsets.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_Real, signals.real_refs[i], signals.reals[i]));
+    }
+    for (size_t i = 0; i < signals.integers.size(); ++i) {
+        offsets.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_Integer, signals.integer_refs[i], 0.0, signals.integers[i]));
+    }
+    for (size_t i = 0; i < signals.booleans.size(); ++i) {
+        offsets.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_Boolean, signals.boolean_refs[i], 0.0, 0, signals.booleans[i] != 0));
+    }
+    return builder.CreateVector(offsets);
+}
+
+flatbuffers::Offset<SimProtocol::SignalVector> write_signals(flatbuffers::FlatBufferBuilder& builder,
+                                                             const Signals& signals) {
+    // Each vector is filled before the next one is started
+    auto real_refs = copy_vector(builder, signals.real_refs);
+    auto real_values = copy_vector(builder, signals.reals);
+    auto integer_refs = copy_vector(builder, signals.integer_refs);
+    auto integer_values = copy_vector(builder, signals.integers);
+    auto boolean_refs = copy_vector(builder, signals.boolean_refs);
+    auto boolean_values = copy_vector(builder, signals.booleans);
+    return SimProtocol::CreateSignalVector(builder, real_refs, real_values, integer_refs, integer_values,
+                                           boolean_refs, boolean_values);
+}
+
+void build_request_v1(flatbuffers::FlatBufferBuilder& builder, const Signals& signals,
+                      std::vector<flatbuffers::Offset<SimProtocol::Variable>>& offsets) {
+    builder.Clear();
+    auto inputs = write_variables(builder, signals, offsets);
+    auto request = SimProtocol::CreateStepRequest(builder, kTimestep, inputs, kConsumer);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepRequest, request.Union()));
+}
+
+void build_response_v1(flatbuffers::FlatBufferBuilder& builder, const Signals& signals,
+                       std::vector<flatbuffers::Offset<SimProtocol::Variable>>& offsets) {
+    builder.Clear();
+    auto outputs = write_variables(builder, signals, offsets);
+    auto response = SimProtocol::CreateStepResponse(builder, outputs, kProducer);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepResponse, response.Union()));
+}
+
+void build_request_v2(flatbuffers::FlatBufferBuilder& builder, const Signals& signals) {
+    builder.Clear();
+    auto inputs = write_signals(builder, signals);
+    auto request = SimProtocol::CreateStepRequestV2(builder, kTimestep, kConsumer, inputs);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepRequestV2, request.Union()));
+}
+
+void build_response_v2(flatbuffers::FlatBufferBuilder& builder, const Signals& signals) {
+    builder.Clear();
+    auto outputs = write_signals(builder, signals);
+    auto response = SimProtocol::CreateStepResponseV2(builder, kProducer, outputs);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepResponseV2, response.Union()));
+}
+
+// Reads every value, as a client applying the inputs would
+double read_variables(const flatbuffers::Vector<flatbuffers::Offset<SimProtocol::Variable>>* variables) {
+    double sum = 0.0;
+    if (!variables) return sum;
+    for (const auto* variable : *variables) {
+        switch (variable->value_type()) {
+            case SimProtocol::ValueType_Real: sum += variable->real_value(); break;
+            case SimProtocol::ValueType_Integer: sum += variable->integer_value(); break;
+            case SimProtocol::ValueType_Boolean: sum += variable->boolean_value() ? 1.0 : 0.0; break;
+            default: break;
+        }
+        sum += variable->value_reference();
+    }
+    return sum;
+}
+
+template <typename T>
+double read_vector(const flatbuffers::Vector<uint32_t>* refs, const flatbuffers::Vector<T>* values) {
+    double sum = 0.0;
+    if (!refs || !values) return sum;
+    for (uint32_t i = 0; i < values->size(); ++i) sum += static_cast<double>(values->Get(i)) + refs->Get(i);
+    return sum;
+}
+
+double read_signals(const SimProtocol::SignalVector* signals) {
+    if (!signals) return 0.0;
+    return read_vector(signals->real_refs(), signals->real_values()) +
+           read_vector(signals->integer_refs(), signals->integer_values()) +
+           read_vector(signals->boolean_refs(), signals->boolean_values());
+}
+
+void run_codec(BenchRunner& runner, size_t count) {
+    Signals signals(count);
+    BenchRunner::Params params{{"variables", count}};
+    flatbuffers::FlatBufferBuilder builder(1024 * 1024);
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>> offsets;
+    offsets.reserve(count);
+
+    auto work = [&builder, count] { return BenchRunner::Work{count, builder.GetSize()}; };
+
+    build_request_v1(builder, signals, offsets);
+    runner.run("protocol/encode_request_v1", params, work(), [&] { build_request_v1(builder, signals, offsets); });
+    runner.run("protocol/decode_request_v1", params, work(), [&] {
+        const auto* request = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                  ->message_type_as_StepRequest();
+        keep(read_variables(request->inputs()));
+    });
+
+    build_response_v1(builder, signals, offsets);
+    runner.run("protocol/encode_response_v1", params, work(), [&] { build_response_v1(builder, signals, offsets); });
+    runner.run("protocol/decode_response_v1", params, work(), [&] {
+        const auto* response = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                   ->message_type_as_StepResponse();
+        keep(read_variables(response->outputs()));
+    });
+
+    build_request_v2(builder, signals);
+    runner.run("protocol/encode_request_v2", params, work(), [&] { build_request_v2(builder, signals); });
+    runner.run("protocol/decode_request_v2", params, work(), [&] {
+        const auto* request = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                  ->message_type_as_StepRequestV2();
+        keep(read_signals(request->inputs()));
+    });
+
+    build_response_v2(builder, signals);
+    runner.run("protocol/encode_response_v2", params, work(), [&] { build_response_v2(builder, signals); });
+    runner.run("protocol/decode_response_v2", params, work(), [&] {
+        const auto* response = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                   ->message_type_as_StepResponseV2();
+        keep(read_signals(response->outputs()));
+    });
+}
+
+// Routing of a response as the server does it: under the routing lock, every
+// output is looked up among the producer's connected outputs and stored in its slot
+void run_routing(BenchRunner& runner, size_t count) {
+    std::vector<RoutingTable::SignalConnection> connections;
+    connections.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        connections.push_back({kProducer, std::to_string(i), kConsumer, std::to_string(i)});
+    }
+    RoutingTable routing;
+    bool built = routing.build(connections,
+        [](uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) {
+            size_t index = std::stoul(name);
+            info = {static_cast<uint32_t>(index), type_of(index), client_id == kProducer};
+            return true;
+        });
+    const auto* routes = built ? routing.routes(kProducer) : nullptr;
+    if (!routes) {
+        std::cerr << "Failed to build the routing table" << std::endl;
+        return;
+    }
+
+    Signals signals(count);
+    BenchRunner::Params params{{"variables", count}};
+    flatbuffers::FlatBufferBuilder builder(1024 * 1024);
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>> offsets;
+    std::mutex routing_mutex;
+
+    build_response_v1(builder, signals, offsets);
+    runner.run("routing/response_v1", params, {count, builder.GetSize()}, [&] {
+        const auto* response = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                   ->message_type_as_StepResponse();
+        std::lock_guard<std::mutex> lock(routing_mutex);
+        routing.store_variables(*routes, response->outputs());
+    });
+
+    build_response_v2(builder, signals);
+    runner.run("routing/response_v2", params, {count, builder.GetSize()}, [&] {
+        const auto* response = flatbuffers::GetRoot<SimProtocol::Message>(builder.GetBufferPointer())
+                                   ->message_type_as_StepResponseV2();
+        std::lock_guard<std::mutex> lock(routing_mutex);
+        routing.store_signals(*routes, response->outputs());
+    });
+    keep(routing.real_slots()[0]);
+}
+
+}  // namespace
+
+void run_protocol_benchmarks(BenchRunner& runner) {
+    for (size_t count : kSizes) {
+        run_codec(runner, count);
+        run_routing(runner, count);
+    }
+}
@@ -0,0 +1,88 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "common/network.hpp"
+
+namespace {
+
+constexpr uint16_t kPort = 18080;
+constexpr size_t kBatch = 64;
+const size_t kLatencySizes[] = {64, 4096, 65536};
+const size_t kThroughputSizes[] = {4096, 65536};
+
+// Waits until `bytes` have arrived; false after five seconds without them
+bool await(const std::atomic<uint64_t>& received, uint64_t bytes) {
+    auto deadline = BenchRunner::Clock::now() + std::chrono::seconds(5);
+    while (received.load(std::memory_order_acquire) < bytes) {
+        if (BenchRunner::Clock::now() > deadline) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// Loopback client to server over one QUIC stream, in one process. Latency is
+// one message from send() to its last byte reaching the server's handler;
+// throughput keeps kBatch messages in flight.
+void run_quic_benchmarks(BenchRunner& runner) {
+    if (!runner.enabled("quic/")) return;
+
+    std::unique_ptr<QuicConnection> server;
+    std::unique_ptr<QuicConnection> client;
+    std::atomic<uint64_t> received{0};
+    std::atomic<bool> connected{false};
+    try {
+        server = std::make_unique<QuicConnection>(true);
+        server->set_message_handler([&received](const uint8_t*, size_t len) {
+            received.fetch_add(len, std::memory_order_release);
+        });
+        if (!server->listen(kPort)) {
+            std::cerr << "QUIC benchmarks skipped: cannot listen on port " << kPort << std::endl;
+            return;
+        }
+
+        client = std::make_unique<QuicConnection>(false);
+        client->set_connected_handler([&connected] { connected.store(true, std::memory_order_release); });
+        if (!client->connect("localhost", kPort)) {
+            std::cerr << "QUIC benchmarks skipped: cannot connect" << std::endl;
+            return;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "QUIC benchmarks skipped: " << e.what() << std::endl;
+        return;
+    }
+
+    auto deadline = BenchRunner::Clock::now() + std::chrono::seconds(5);
+    while (!connected.load(std::memory_order_acquire)) {
+        if (BenchRunner::Clock::now() > deadline) {
+            std::cerr << "QUIC benchmarks skipped: no handshake" << std::endl;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // MsQuic reads the payload in place, so it is never modified while in flight
+    std::vector<uint8_t> payload(*std::max_element(std::begin(kLatencySizes), std::end(kLatencySizes)), 0x5a);
+    bool ok = true;
+
+    for (size_t size : kLatencySizes) {
+        runner.run("quic/latency", {{"bytes", size}}, {1, size}, [&] {
+            uint64_t target = received.load(std::memory_order_relaxed) + size;
+            ok = ok && client->send(payload.data(), size) && await(received, target);
+        });
+    }
+
+    for (size_t size : kThroughputSizes) {
+        runner.run("quic/throughput", {{"bytes", size * kBatch}}, {kBatch, size * kBatch}, [&] {
+            uint64_t target = received.load(std::memory_order_relaxed) + size * kBatch;
+            for (size_t i = 0; i < kBatch && ok; ++i) ok = client->send(payload.data(), size);
+            ok = ok && await(received, target);
+        });
+    }
+
+    if (!ok) std::cerr << "QUIC benchmarks incomplete: a send failed or timed out" << std::endl;
+}
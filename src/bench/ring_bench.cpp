@@ -0,0 +1,102 @@
+#include "bench.hpp"
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include "common/shm_transport.hpp"
+
+namespace {
+
+constexpr uint32_t kSlotCount = 4;
+constexpr uint32_t kSlotSize = 1024 * 1024;
+const size_t kSizes[] = {10, 1000, 10000};
+
+struct AlignedDelete {
+    void operator()(uint8_t* memory) const { ::operator delete(memory, std::align_val_t(64)); }
+};
+
+// A request and a response ring as the server creates them for a local
+// client. The rings live in process memory here; their layout and
+// synchronization are those of the shared-memory segment.
+struct RingPair {
+    std::unique_ptr<uint8_t, AlignedDelete> memory;
+    std::unique_ptr<SharedMessageWriter> request_writer;
+    std::unique_ptr<SharedMessageRing> request_ring;
+    std::unique_ptr<SharedMessageWriter> response_writer;
+    std::unique_ptr<SharedMessageRing> response_ring;
+
+    RingPair() {
+        size_t ring_bytes = SharedMessageRing::required_size(kSlotCount, kSlotSize);
+        memory.reset(static_cast<uint8_t*>(::operator new(2 * ring_bytes, std::align_val_t(64))));
+        uint8_t* requests = memory.get();
+        uint8_t* responses = memory.get() + ring_bytes;
+        request_writer = std::make_unique<SharedMessageWriter>(
+            SharedMessageRing::create(requests, kSlotCount, kSlotSize));
+        request_ring = std::make_unique<SharedMessageRing>(requests);
+        response_writer = std::make_unique<SharedMessageWriter>(
+            SharedMessageRing::create(responses, kSlotCount, kSlotSize));
+        response_ring = std::make_unique<SharedMessageRing>(responses);
+    }
+};
+
+// A v2 message carrying `count` reals
+void build_message(flatbuffers::FlatBufferBuilder& builder, size_t count, bool request) {
+    uint32_t* refs = nullptr;
+    auto real_refs = builder.CreateUninitializedVector(count, &refs);
+    for (size_t i = 0; i < count; ++i) refs[i] = static_cast<uint32_t>(i);
+    double* values = nullptr;
+    auto real_values = builder.CreateUninitializedVector(count, &values);
+    for (size_t i = 0; i < count; ++i) values[i] = static_cast<double>(i);
+    auto signals = SimProtocol::CreateSignalVector(builder, real_refs, real_values);
+
+    if (request) {
+        auto body = SimProtocol::CreateStepRequestV2(builder, 1000, 1, signals);
+        builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepRequestV2, body.Union()));
+    } else {
+        auto body = SimProtocol::CreateStepResponseV2(builder, 1, signals);
+        builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepResponseV2, body.Union()));
+    }
+}
+
+// Request and response round trip between two threads, each message built in
+// place in its slot and read in place by the other side
+void run_round_trip(BenchRunner& runner, size_t count) {
+    RingPair rings;
+    std::atomic<bool> running{true};
+
+    // The peer answers every request with a response of the same size
+    std::thread peer([&rings, &running, count] {
+        while (running.load(std::memory_order_relaxed)) {
+            const auto* request = rings.request_ring->front();
+            if (!request) continue;
+            auto* builder = rings.response_writer->begin();
+            if (!builder) continue;
+            keep(request->message_type());
+            build_message(*builder, count, false);
+            rings.request_ring->pop();
+            rings.response_writer->commit();
+        }
+    });
+
+    runner.run("ring/round_trip", {{"variables", count}}, {count, 0}, [&] {
+        auto* builder = rings.request_writer->begin();
+        build_message(*builder, count, true);
+        rings.request_writer->commit();
+
+        while (!rings.response_ring->front()) {
+        }
+        rings.response_ring->pop();
+    });
+
+    running.store(false, std::memory_order_relaxed);
+    peer.join();
+}
+
+}  // namespace
+
+void run_ring_benchmarks(BenchRunner& runner) {
+    if (!runner.enabled("ring/round_trip")) return;
+    for (size_t count : kSizes) {
+        run_round_trip(runner, count);
+    }
+}
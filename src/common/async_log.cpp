@@ -0,0 +1,216 @@
+#include "async_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char* category_name(LogCategory category) {
+    switch (category) {
+        case LogCategory::Network: return "network";
+        case LogCategory::Protocol: return "protocol";
+        case LogCategory::Step: return "step";
+        case LogCategory::Transfer: return "transfer";
+        default: return "other";
+    }
+}
+
+// Single-producer ring of one thread's records. The owning thread writes at
+// tail, the drain thread reads at head.
+struct LogRing {
+    static constexpr size_t kCapacity = 256;  // power of two
+
+    std::array<LogRecord, kCapacity> records;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};  // owning thread has exited
+};
+
+// Limits are admitted from every logging thread, so each gets a cache line of its own
+struct alignas(64) CategoryLimit {
+    LogRateLimit limit;
+};
+
+class AsyncLog {
+private:
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    std::array<CategoryLimit, static_cast<size_t>(LogCategory::Count)> limits_;
+
+    std::thread drain_thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> running_{true};
+
+    void drain_loop() {
+        std::string out;
+        while (running_.load(std::memory_order_relaxed)) {
+            drain(out);
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(5));
+        }
+        drain(out);
+    }
+
+    void drain(std::string& out) {
+        out.clear();
+        std::vector<std::shared_ptr<LogRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings = rings_;
+            // Rings of exited threads go once they are empty
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<LogRing>& ring) {
+                return ring->retired.load(std::memory_order_acquire) &&
+                       ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+            }), rings_.end());
+        }
+
+        for (const auto& ring : rings) {
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            size_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                out += ring->records[head & (LogRing::kCapacity - 1)].format_message();
+                out += '\n';
+            }
+            ring->head.store(head, std::memory_order_release);
+
+            if (uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                out += std::to_string(dropped) + " log messages dropped, log ring full\n";
+            }
+        }
+        for (size_t i = 0; i < limits_.size(); ++i) {
+            if (uint64_t suppressed = limits_[i].limit.suppressed.exchange(0, std::memory_order_relaxed)) {
+                out += std::to_string(suppressed) + " " + category_name(static_cast<LogCategory>(i)) +
+                       " messages suppressed by rate limit\n";
+            }
+        }
+
+        if (!out.empty()) {
+            std::cerr << out;
+            std::cerr.flush();
+        }
+    }
+
+public:
+    // Started once every member is constructed
+    AsyncLog() { drain_thread_ = std::thread([this] { drain_loop(); }); }
+
+    // Never destroyed: threads may still log during static destruction
+    static AsyncLog& instance() {
+        static AsyncLog* log = [] {
+            auto* created = new AsyncLog();
+            std::atexit(flush_async_log);
+            return created;
+        }();
+        return *log;
+    }
+
+    bool running() const { return running_.load(std::memory_order_acquire); }
+    LogRateLimit& limit(LogCategory category) { return limits_[static_cast<size_t>(category)].limit; }
+
+    void add_ring(std::shared_ptr<LogRing> ring) {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.push_back(std::move(ring));
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) return;
+        wake_cv_.notify_one();
+        if (drain_thread_.joinable()) drain_thread_.join();
+    }
+};
+
+// The calling thread's ring, registered on first use and retired on thread exit
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring = std::make_shared<LogRing>();
+
+    ThreadRing() { AsyncLog::instance().add_ring(ring); }
+    ~ThreadRing() { ring->retired.store(true, std::memory_order_release); }
+};
+
+ThreadRing& thread_ring() {
+    thread_local ThreadRing ring;
+    return ring;
+}
+
+thread_local LogRecord fallback_record;
+thread_local bool fallback_pending = false;
+
+}  // namespace
+
+std::string LogRecord::format_message() const {
+    std::string message;
+    size_t next = 0;
+    for (const char* p = format; p && *p; ++p) {
+        if (p[0] != '{' || p[1] != '}') {
+            message += *p;
+            continue;
+        }
+        ++p;
+        if (next >= arg_count) continue;
+        switch (kinds[next]) {
+            case Kind::Signed: message += std::to_string(static_cast<int64_t>(values[next])); break;
+            case Kind::Unsigned: message += std::to_string(values[next]); break;
+            case Kind::Real: {
+                double real;
+                std::memcpy(&real, &values[next], sizeof(real));
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%g", real);
+                message += buffer;
+                break;
+            }
+            case Kind::Text: message += text + values[next]; break;
+        }
+        ++next;
+    }
+    return message;
+}
+
+namespace async_log_detail {
+
+LogRecord* begin(LogCategory category) {
+    auto& log = AsyncLog::instance();
+    if (!log.limit(category).admit()) return nullptr;
+
+    // Once the drain thread has stopped, messages are written on the spot
+    if (!log.running()) {
+        fallback_pending = true;
+        return &fallback_record;
+    }
+
+    auto& ring = *thread_ring().ring;
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) == LogRing::kCapacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &ring.records[tail & (LogRing::kCapacity - 1)];
+}
+
+void commit() {
+    if (fallback_pending) {
+        fallback_pending = false;
+        std::cerr << fallback_record.format_message() << std::endl;
+        return;
+    }
+    auto& ring = *thread_ring().ring;
+    ring.tail.store(ring.tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+}  // namespace async_log_detail
+
+void set_log_rate_limit(LogCategory category, uint32_t per_second) {
+    AsyncLog::instance().limit(category).limit.store(per_second, std::memory_order_relaxed);
+}
+
+void flush_async_log() {
+    AsyncLog::instance().stop();
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+// Diagnostics from the step and receive paths. The calling thread only fills
+// a fixed-size record in its own ring; a background thread formats and
+// writes it to stderr. Messages beyond the rate limit of their category are
+// counted instead of queued, so a burst of warnings cannot stall a step.
+enum class LogCategory : uint8_t {
+    Network,   // MsQuic callbacks and sends
+    Protocol,  // malformed or unexpected messages
+    Step,      // failed steps and back-pressure
+    Transfer,  // blobs and compression
+    Count
+};
+
+// Fixed window rate limit: up to `limit` messages per second, the rest are
+// counted in `suppressed`. Safe to call from any thread.
+struct LogRateLimit {
+    std::atomic<uint32_t> limit{100};
+    std::atomic<int64_t> window_start{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint64_t> suppressed{0};
+
+    bool admit() {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t start = window_start.load(std::memory_order_relaxed);
+        if (now - start >= 1000 && window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1, std::memory_order_relaxed) < limit.load(std::memory_order_relaxed)) return true;
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+// One queued message. `format` is a string literal in which each {} takes
+// the next argument; string arguments are copied into `text`.
+struct LogRecord {
+    enum class Kind : uint8_t { Signed, Unsigned, Real, Text };
+    static constexpr size_t kMaxArgs = 4;
+    static constexpr size_t kTextSize = 160;
+
+    const char* format = nullptr;
+    LogCategory category = LogCategory::Network;
+    uint8_t arg_count = 0;
+    uint16_t text_used = 0;
+    std::array<Kind, kMaxArgs> kinds{};
+    std::array<uint64_t, kMaxArgs> values{};  // value, bits of a double, or offset into text
+    char text[kTextSize];
+
+    void add(const char* value) {
+        if (arg_count == kMaxArgs) return;
+        size_t length = value ? std::strlen(value) : 0;
+        length = std::min(length, kTextSize - text_used - 1);
+        std::memcpy(text + text_used, value, length);
+        text[text_used + length] = '\0';
+        kinds[arg_count] = Kind::Text;
+        values[arg_count++] = text_used;
+        text_used = static_cast<uint16_t>(std::min(kTextSize - 1, text_used + length + 1));
+    }
+    void add(const std::string& value) { add(value.c_str()); }
+
+    template <typename T>
+    std::enable_if_t<std::is_arithmetic<T>::value> add(T value) {
+        if (arg_count == kMaxArgs) return;
+        if (std::is_floating_point<T>::value) {
+            double real = static_cast<double>(value);
+            kinds[arg_count] = Kind::Real;
+            std::memcpy(&values[arg_count], &real, sizeof(real));
+        } else if (std::is_signed<T>::value) {
+            kinds[arg_count] = Kind::Signed;
+            values[arg_count] = static_cast<uint64_t>(static_cast<int64_t>(value));
+        } else {
+            kinds[arg_count] = Kind::Unsigned;
+            values[arg_count] = static_cast<uint64_t>(value);
+        }
+        ++arg_count;
+    }
+
+    // The message with its arguments filled in
+    std::string format_message() const;
+};
+
+namespace async_log_detail {
+
+// Claims a record in the calling thread's ring; nullptr if the category is
+// over its rate or the ring is full
+LogRecord* begin(LogCategory category);
+
+// Publishes the record obtained from begin()
+void commit();
+
+}  // namespace async_log_detail
+
+// Messages per second allowed in `category` before the rest are suppressed
+void set_log_rate_limit(LogCategory category, uint32_t per_second);
+
+// Writes out everything queued and stops the drain thread; later messages
+// are written synchronously. Runs at exit.
+void flush_async_log();
+
+template <typename... Args>
+void async_log(LogCategory category, const char* format, const Args&... args) {
+    LogRecord* record = async_log_detail::begin(category);
+    if (!record) return;
+    record->format = format;
+    record->category = category;
+    record->arg_count = 0;
+    record->text_used = 0;
+    (void)std::initializer_list<int>{(record->add(args), 0)...};
+    async_log_detail::commit();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bytes of a binary value owned by someone else: an FMU, a received blob
+// or a slot of a shared blob store
+struct BinaryView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+using Blob = std::vector<uint8_t>;
+
+// Recycled buffers for binary values. A blob is shared by reference between
+// its producer and consumers and becomes free again once the pool holds the
+// only reference, so steady-state transfers neither copy nor allocate.
+class BlobPool {
+private:
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Blob>> blobs_;
+
+public:
+    // Buffer of `size` bytes nobody else references
+    std::shared_ptr<Blob> acquire(size_t size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& blob : blobs_) {
+            if (blob.use_count() != 1) continue;
+            // Pairs with the release of the last outside reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+            blob->resize(size);
+            return blob;
+        }
+        blobs_.push_back(std::make_shared<Blob>(size));
+        return blobs_.back();
+    }
+};
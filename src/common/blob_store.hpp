@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include "blob.hpp"
+
+// Fixed ring of blob slots in the shared-memory segment. One writer (a local
+// client, or the server for store 0) copies each binary value into the next
+// slot, and consumers read it in place by offset. Slots are reused
+// round-robin; the server sizes each store so a slot is only rewritten after
+// the message rings would have forced every reader past it.
+class SharedBlobStore {
+public:
+    static constexpr uint32_t kNoSlot = 0xFFFFFFFFu;
+
+private:
+    static constexpr uint32_t kMagic = 0x53424C42u;  // "SBLB"
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        uint32_t next;  // next slot the writer fills
+    };
+
+    Header* header_;
+    uint8_t* base_;
+
+public:
+    static constexpr size_t required_size(uint32_t slot_count, uint32_t slot_size) {
+        return sizeof(Header) + static_cast<size_t>(slot_count) * ((slot_size + 63) & ~63u);
+    }
+
+    // Formats `region` as an empty store. Only the creator of the segment calls this.
+    static SharedBlobStore create(void* region, uint32_t slot_count, uint32_t slot_size) {
+        auto* header = new (region) Header();
+        header->magic = kMagic;
+        header->slot_count = slot_count;
+        header->slot_size = (slot_size + 63) & ~63u;
+        header->next = 0;
+        return SharedBlobStore(region);
+    }
+
+    // Attaches to a store previously formatted with create()
+    explicit SharedBlobStore(void* region)
+        : header_(static_cast<Header*>(region))
+        , base_(static_cast<uint8_t*>(region)) {}
+
+    bool valid() const { return header_ && header_->magic == kMagic; }
+    uint32_t slot_size() const { return header_->slot_size; }
+    uint32_t slot_count() const { return header_->slot_count; }
+
+    // Copies `value` into the next slot and returns its offset, or kNoSlot if it does not fit
+    uint32_t write(BinaryView value) {
+        if (value.size > header_->slot_size || header_->slot_count == 0) return kNoSlot;
+        uint32_t slot = header_->next;
+        header_->next = (slot + 1) % header_->slot_count;
+        auto offset = static_cast<uint32_t>(sizeof(Header) + static_cast<size_t>(slot) * header_->slot_size);
+        std::memcpy(base_ + offset, value.data, value.size);
+        return offset;
+    }
+
+    // Value written at `offset`; empty if the location lies outside the store
+    BinaryView view(uint32_t offset, uint32_t size) const {
+        size_t end = sizeof(Header) + static_cast<size_t>(header_->slot_count) * header_->slot_size;
+        if (offset < sizeof(Header) || size > header_->slot_size || static_cast<size_t>(offset) + size > end) return {};
+        return {base_ + offset, size};
+    }
+};
@@ -0,0 +1,94 @@
+#include "blob_transfer.hpp"
+#include "async_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+// Room for the BlobChunk fields and the FlatBuffers framing around the data
+constexpr size_t kChunkOverhead = 256;
+
+}  // namespace
+
+BlobSender::BlobSender(size_t chunk_size, size_t max_buffers)
+    : chunk_size_(chunk_size)
+    , max_buffers_(std::max<size_t>(max_buffers, 4))
+    , chunks_(4, chunk_size + kChunkOverhead) {}
+
+flatbuffers::FlatBufferBuilder* BlobSender::next_chunk() {
+    auto* builder = chunks_.begin();
+    if (builder) return builder;
+    if (chunks_.size() < max_buffers_) {
+        chunks_.grow();
+        return chunks_.begin();
+    }
+
+    // Every buffer is in flight: let the network catch up
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!(builder = chunks_.begin())) {
+        if (std::chrono::steady_clock::now() > deadline) return nullptr;
+        std::this_thread::yield();
+    }
+    return builder;
+}
+
+bool BlobSender::send(QuicConnection& connection, uint64_t blob_id, BinaryView value) {
+    size_t offset = 0;
+    do {
+        auto* builder = next_chunk();
+        if (!builder) {
+            async_log(LogCategory::Transfer, "No chunk buffer came back for blob {}", blob_id);
+            return false;
+        }
+
+        size_t length = std::min(chunk_size_, value.size - offset);
+        uint8_t* data = nullptr;
+        auto bytes = builder->CreateUninitializedVector(length, &data);
+        if (length > 0) std::memcpy(data, value.data + offset, length);
+
+        auto chunk = SimProtocol::CreateBlobChunk(
+            *builder, blob_id, static_cast<uint32_t>(value.size), static_cast<uint32_t>(offset), bytes);
+        builder->Finish(SimProtocol::CreateMessage(
+            *builder,
+            SimProtocol::MessageType_BlobChunk,
+            chunk.Union()));
+
+        if (!chunks_.send(connection)) {
+            async_log(LogCategory::Transfer, "Failed to send chunk of blob {}", blob_id);
+            return false;
+        }
+        offset += length;
+    } while (offset < value.size);
+    return true;
+}
+
+void BlobAssembler::add(const SimProtocol::BlobChunk* chunk) {
+    const auto* data = chunk->data();
+    size_t length = data ? data->size() : 0;
+    if (static_cast<size_t>(chunk->offset()) + length > chunk->total_size()) {
+        async_log(LogCategory::Transfer, "Dropping chunk beyond the end of blob {}", chunk->blob_id());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& partial = partial_[chunk->blob_id()];
+    if (!partial.blob) partial.blob = pool_.acquire(chunk->total_size());
+    if (length > 0) std::memcpy(partial.blob->data() + chunk->offset(), data->data(), length);
+    partial.received += length;
+
+    if (partial.received >= partial.blob->size()) {
+        complete_[chunk->blob_id()] = std::move(partial.blob);
+        partial_.erase(chunk->blob_id());
+    }
+}
+
+std::shared_ptr<const Blob> BlobAssembler::take(uint64_t blob_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = complete_.find(blob_id);
+    if (it == complete_.end()) return nullptr;
+    auto blob = std::move(it->second);
+    complete_.erase(it);
+    return blob;
+}
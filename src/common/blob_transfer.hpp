@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "simulation_protocol_generated.h"
+#include "blob.hpp"
+#include "network.hpp"
+#include "send_pool.hpp"
+
+// Binary values over QUIC. A value travels as BlobChunk messages of at most
+// chunk_size bytes, sent ahead of the message that refers to it by blob id.
+// The stream keeps them in order, so the value is complete once that
+// message arrives.
+class BlobSender {
+private:
+    size_t chunk_size_;
+    size_t max_buffers_;
+    SendPool chunks_;
+
+    // Free chunk buffer, waiting for MsQuic to hand one back once the pool
+    // has reached max_buffers_; nullptr if none comes back in time
+    flatbuffers::FlatBufferBuilder* next_chunk();
+
+public:
+    explicit BlobSender(size_t chunk_size = 64 * 1024, size_t max_buffers = 64);
+
+    // Sends `value` as blob `blob_id`. Each chunk is copied once into a pooled
+    // buffer; the pool grows while MsQuic still holds every buffer, up to
+    // max_buffers, and then the sender waits for a send to complete.
+    bool send(QuicConnection& connection, uint64_t blob_id, BinaryView value);
+};
+
+// Puts received chunks back together into pooled blobs
+class BlobAssembler {
+private:
+    struct Partial {
+        std::shared_ptr<Blob> blob;
+        size_t received = 0;
+    };
+
+    BlobPool pool_;
+    std::mutex mutex_;
+    std::map<uint64_t, Partial> partial_;
+    std::map<uint64_t, std::shared_ptr<const Blob>> complete_;
+
+public:
+    // Copies a chunk out of the receive buffer into its blob
+    void add(const SimProtocol::BlobChunk* chunk);
+
+    // Takes a completed blob; nullptr if it has not fully arrived
+    std::shared_ptr<const Blob> take(uint64_t blob_id);
+};
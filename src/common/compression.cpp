@@ -0,0 +1,42 @@
+#include "compression.hpp"
+#include <limits>
+#include <lz4.h>
+
+namespace {
+
+// Upper bound on a decompressed message, as a guard against corrupt size fields
+constexpr uint32_t kMaxMessageSize = 64 * 1024 * 1024;
+
+}  // namespace
+
+bool MessageCompressor::compress(const uint8_t* data, size_t size, flatbuffers::FlatBufferBuilder& builder) {
+    if (size > static_cast<size_t>(std::numeric_limits<int>::max())) return false;
+
+    int bound = LZ4_compressBound(static_cast<int>(size));
+    if (scratch_.size() < static_cast<size_t>(bound)) scratch_.resize(static_cast<size_t>(bound));
+
+    int packed = LZ4_compress_default(reinterpret_cast<const char*>(data), scratch_.data(),
+                                      static_cast<int>(size), bound);
+    if (packed <= 0 || static_cast<size_t>(packed) >= size) return false;
+
+    auto bytes = builder.CreateVector(reinterpret_cast<const uint8_t*>(scratch_.data()), static_cast<size_t>(packed));
+    auto compressed = SimProtocol::CreateCompressedMessage(builder, static_cast<uint32_t>(size), bytes);
+    builder.Finish(SimProtocol::CreateMessage(
+        builder,
+        SimProtocol::MessageType_CompressedMessage,
+        compressed.Union()));
+    return true;
+}
+
+bool decompress_message(const SimProtocol::CompressedMessage* compressed, std::vector<uint8_t>& out) {
+    const auto* data = compressed->data();
+    uint32_t raw_size = compressed->raw_size();
+    if (!data || raw_size == 0 || raw_size > kMaxMessageSize) return false;
+
+    // resize() keeps the capacity, so a steady stream of messages allocates once
+    out.resize(raw_size);
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(data->data()),
+                                   reinterpret_cast<char*>(out.data()),
+                                   static_cast<int>(data->size()), static_cast<int>(raw_size));
+    return size == static_cast<int>(raw_size);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "simulation_protocol_generated.h"
+
+// LZ4 compression of whole messages for QUIC peers that agreed on
+// Feature_Compression. Only messages above the agreed threshold are
+// compressed, so small step messages on a LAN take no detour.
+class MessageCompressor {
+private:
+    // Agreed in the Welcome, which arrives on an MsQuic thread
+    std::atomic<uint32_t> threshold_{0};
+    std::vector<char> scratch_;
+
+public:
+    // 0 disables compression
+    void set_threshold(uint32_t threshold) { threshold_.store(threshold, std::memory_order_relaxed); }
+
+    bool wants(size_t size) const {
+        uint32_t threshold = threshold_.load(std::memory_order_relaxed);
+        return threshold != 0 && size > threshold;
+    }
+
+    // Builds a CompressedMessage holding `data` into `builder`. Returns false,
+    // leaving `builder` untouched, if compression does not shrink the message.
+    bool compress(const uint8_t* data, size_t size, flatbuffers::FlatBufferBuilder& builder);
+};
+
+// Decompresses the message wrapped in `compressed` into `out`; false if it is corrupt
+bool decompress_message(const SimProtocol::CompressedMessage* compressed, std::vector<uint8_t>& out);
@@ -0,0 +1,27 @@
+#pragma once
+#include <iostream>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Pins `thread` to core `cpu`; a negative cpu leaves it to the scheduler.
+// Returns false where pinning is unsupported or the core does not exist.
+inline bool pin_thread(std::thread& thread, int cpu) {
+    if (cpu < 0) return true;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (result != 0) {
+        std::cerr << "Failed to pin thread to CPU " << cpu << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "CPU pinning is not supported on this platform" << std::endl;
+    return false;
+#endif
+}
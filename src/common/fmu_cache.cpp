@@ -0,0 +1,224 @@
+#include "fmu_cache.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <cosim/fmi/importer.hpp>
+#include <fmilib.h>
+
+namespace {
+
+const char* kTableFile = "variables.bin";
+const char* kModelDescriptionFile = "modelDescription.xml";
+
+// Name for a scratch file or directory no other thread or process picks
+std::string unique_suffix() {
+    static std::atomic<uint64_t> counter{0};
+    auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    return ".tmp-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+           "-" + std::to_string(ticks) + "-" + std::to_string(counter.fetch_add(1));
+}
+
+// Moves a finished scratch entry into place. Losing the race against
+// another writer of the same content is fine; the scratch copy is dropped.
+void publish(const cosim::filesystem::path& scratch, const cosim::filesystem::path& target) {
+    try {
+        cosim::filesystem::rename(scratch, target);
+    } catch (const std::exception&) {
+        cosim::filesystem::remove_all(scratch);
+        if (!cosim::filesystem::exists(target)) throw;
+    }
+}
+
+}  // namespace
+
+FmuCache::FmuCache(const std::string& root) {
+    if (!root.empty()) {
+        root_ = root;
+    } else if (const char* env = std::getenv("QUICSIM_FMU_CACHE")) {
+        root_ = env;
+    } else {
+        root_ = cosim::filesystem::temp_directory_path() / "quicsim_fmu_cache";
+    }
+    cosim::filesystem::create_directories(root_);
+}
+
+std::string FmuCache::content_hash(const cosim::filesystem::path& file) {
+    std::ifstream in(file.string(), std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot read " + file.string());
+
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> chunk(64 * 1024);
+    while (in) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        std::streamsize got = in.gcount();
+        for (std::streamsize i = 0; i < got; ++i) {
+            hash ^= static_cast<uint8_t>(chunk[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+
+    static const char* digits = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i, hash >>= 4) hex[i] = digits[hash & 0xF];
+    return hex;
+}
+
+std::string FmuCache::hash(const cosim::filesystem::path& fmu_path) {
+    // Instances of one FMU hash its file once
+    std::string key = fmu_path.string();
+    auto size = cosim::filesystem::file_size(fmu_path);
+    {
+        std::lock_guard<std::mutex> lock(hashes_mutex_);
+        auto it = hashes_.find(key);
+        if (it != hashes_.end() && it->second.first == size) return it->second.second;
+    }
+
+    std::string hash = content_hash(fmu_path);
+    std::lock_guard<std::mutex> lock(hashes_mutex_);
+    hashes_[key] = std::make_pair(size, hash);
+    return hash;
+}
+
+cosim::filesystem::path FmuCache::entry_path(const cosim::filesystem::path& fmu_path) {
+    return root_ / hash(fmu_path);
+}
+
+cosim::filesystem::path FmuCache::unpacked(const cosim::filesystem::path& fmu_path) {
+    auto entry = entry_path(fmu_path);
+    if (cosim::filesystem::exists(entry / kModelDescriptionFile)) return entry;
+
+    auto scratch = root_ / (entry.filename().string() + unique_suffix());
+    cosim::filesystem::create_directories(scratch);
+
+    // FMI Library unpacks the archive while probing its FMI version
+    fmi_import_context_t* context = fmi_import_allocate_context(jm_get_default_callbacks());
+    fmi_version_enu_t version = fmi_import_get_fmi_version(
+        context, fmu_path.string().c_str(), scratch.string().c_str());
+    fmi_import_free_context(context);
+    if (version == fmi_version_unknown_enu) {
+        cosim::filesystem::remove_all(scratch);
+        throw std::runtime_error("Failed to unpack " + fmu_path.string());
+    }
+
+    publish(scratch, entry);
+    return entry;
+}
+
+std::shared_ptr<cosim::fmi::fmu> FmuCache::import(const cosim::filesystem::path& fmu_path) {
+    auto entry = unpacked(fmu_path);
+
+    // One importer per call; importers are not shared between threads
+    auto fmu = cosim::fmi::importer::create()->import_unpacked(entry);
+
+    auto table = entry / kTableFile;
+    if (!cosim::filesystem::exists(table)) {
+        try {
+            write_table(table, *fmu->model_description());
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to cache variable table of " << fmu_path.string() << ": " << e.what() << std::endl;
+        }
+    }
+    return fmu;
+}
+
+std::shared_ptr<const cosim::model_description> FmuCache::model_description(const cosim::filesystem::path& fmu_path) {
+    auto table = entry_path(fmu_path) / kTableFile;
+    if (cosim::filesystem::exists(table)) {
+        if (auto model = read_table(table)) return model;
+    }
+    return import(fmu_path)->model_description();
+}
+
+std::shared_ptr<const cosim::model_description> FmuCache::read_table(const cosim::filesystem::path& file) {
+    std::ifstream in(file.string(), std::ios::binary | std::ios::ate);
+    if (!in) return nullptr;
+    std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!in) return nullptr;
+
+    flatbuffers::Verifier verifier(data.data(), data.size());
+    if (!FmuCacheFormat::VerifyModelTableBuffer(verifier)) {
+        std::cerr << "Ignoring corrupt variable table " << file.string() << std::endl;
+        return nullptr;
+    }
+    return parse_table(*FmuCacheFormat::GetModelTable(data.data()));
+}
+
+std::shared_ptr<const cosim::model_description> FmuCache::parse_table(const FmuCacheFormat::ModelTable& table) {
+    if (table.format_version() != kFormatVersion) return nullptr;
+
+    auto text = [](const flatbuffers::String* value) {
+        return value ? value->str() : std::string();
+    };
+
+    auto model = std::make_shared<cosim::model_description>();
+    model->name = text(table.name());
+    model->uuid = text(table.uuid());
+    model->description = text(table.description());
+    model->author = text(table.author());
+    model->version = text(table.version());
+    if (const auto* variables = table.variables()) {
+        model->variables.reserve(variables->size());
+        for (const auto* var : *variables) {
+            cosim::variable_description desc;
+            desc.name = text(var->name());
+            desc.reference = var->reference();
+            desc.type = static_cast<cosim::variable_type>(var->type());
+            desc.causality = static_cast<cosim::variable_causality>(var->causality());
+            desc.variability = static_cast<cosim::variable_variability>(var->variability());
+            model->variables.push_back(std::move(desc));
+        }
+    }
+    return model;
+}
+
+flatbuffers::Offset<FmuCacheFormat::ModelTable> FmuCache::build_table(flatbuffers::FlatBufferBuilder& builder,
+                                                                      const cosim::model_description& model) {
+    std::vector<flatbuffers::Offset<FmuCacheFormat::CachedVariable>> variables;
+    variables.reserve(model.variables.size());
+    for (const auto& var : model.variables) {
+        variables.push_back(FmuCacheFormat::CreateCachedVariable(
+            builder,
+            builder.CreateString(var.name),
+            static_cast<uint32_t>(var.reference),
+            static_cast<uint8_t>(var.type),
+            static_cast<uint8_t>(var.causality),
+            static_cast<uint8_t>(var.variability)));
+    }
+
+    auto name = builder.CreateString(model.name);
+    auto uuid = builder.CreateString(model.uuid);
+    auto description = builder.CreateString(model.description);
+    auto author = builder.CreateString(model.author);
+    auto version = builder.CreateString(model.version);
+    return FmuCacheFormat::CreateModelTable(
+        builder, kFormatVersion, name, uuid, description, author, version,
+        builder.CreateVector(variables));
+}
+
+void FmuCache::write_table(const cosim::filesystem::path& file, const cosim::model_description& model) {
+    flatbuffers::FlatBufferBuilder builder(16 * 1024);
+    builder.Finish(build_table(builder, model));
+
+    // Written aside and renamed, so readers never see a partial table
+    auto scratch = file;
+    scratch += unique_suffix();
+    {
+        std::ofstream out(scratch.string(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                  static_cast<std::streamsize>(builder.GetSize()));
+        if (!out) {
+            out.close();
+            cosim::filesystem::remove(scratch);
+            throw std::runtime_error("cannot write " + scratch.string());
+        }
+    }
+    publish(scratch, file);
+}
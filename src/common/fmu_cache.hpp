@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <cosim/fs_portability.hpp>
+#include <cosim/fmi/fmu.hpp>
+#include <cosim/model_description.hpp>
+#include <flatbuffers/flatbuffers.h>
+#include "fmu_cache_generated.h"
+
+// Persistent cache of unpacked FMUs, keyed by a hash of the FMU file's
+// content. Each entry holds the extracted archive and, once parsed, a
+// binary copy of the variable table (schemas/fmu_cache.fbs). A warm start
+// does not unzip, and callers that only need the variable table skip
+// modelDescription.xml as well. Entries are published by renaming a
+// finished directory, so several processes can share one cache.
+class FmuCache {
+private:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    cosim::filesystem::path root_;
+
+    // Content hashes by FMU path, along with the file size they were computed for
+    std::mutex hashes_mutex_;
+    std::map<std::string, std::pair<uintmax_t, std::string>> hashes_;
+
+    cosim::filesystem::path entry_path(const cosim::filesystem::path& fmu_path);
+
+    static std::shared_ptr<const cosim::model_description> read_table(const cosim::filesystem::path& file);
+    static void write_table(const cosim::filesystem::path& file, const cosim::model_description& model);
+
+public:
+    // Cache under `root`; empty selects $QUICSIM_FMU_CACHE or a directory in the system temp dir
+    explicit FmuCache(const std::string& root = std::string());
+
+    const cosim::filesystem::path& root() const { return root_; }
+
+    // FNV-1a hash of the file content, as 16 hex digits
+    static std::string content_hash(const cosim::filesystem::path& file);
+
+    // Content hash of an FMU file, computed once per path and file size
+    std::string hash(const cosim::filesystem::path& fmu_path);
+
+    // Directory holding the extracted FMU, unpacking it on first use
+    cosim::filesystem::path unpacked(const cosim::filesystem::path& fmu_path);
+
+    // Imports the FMU from its unpacked directory. Safe to call from several threads.
+    std::shared_ptr<cosim::fmi::fmu> import(const cosim::filesystem::path& fmu_path);
+
+    // Variable table of the FMU, read from the binary copy when present.
+    // Start values are not cached.
+    std::shared_ptr<const cosim::model_description> model_description(const cosim::filesystem::path& fmu_path);
+
+    // Serializes a variable table, as kept in cache entries and run plans
+    static flatbuffers::Offset<FmuCacheFormat::ModelTable> build_table(flatbuffers::FlatBufferBuilder& builder,
+                                                                      const cosim::model_description& model);
+
+    // Variable table from its serialized form; nullptr if written by another format version
+    static std::shared_ptr<const cosim::model_description> parse_table(const FmuCacheFormat::ModelTable& table);
+};
@@ -0,0 +1,50 @@
+#include "latency.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+
+namespace {
+
+std::mutex registry_mutex;
+std::vector<const PhaseLatencies*>& registry() {
+    static std::vector<const PhaseLatencies*> latencies;
+    return latencies;
+}
+
+}  // namespace
+
+PhaseLatencies::PhaseLatencies(std::string owner, std::vector<const char*> phases)
+    : owner_(std::move(owner))
+    , phases_(std::move(phases))
+    , histograms_(std::make_unique<LatencyHistogram[]>(phases_.size()))
+    , trace_track_(trace_name(owner_)) {
+    for (const char* phase : phases_) trace_names_.push_back(trace_name(phase));
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry().push_back(this);
+}
+
+PhaseLatencies::~PhaseLatencies() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& latencies = registry();
+    latencies.erase(std::remove(latencies.begin(), latencies.end(), this), latencies.end());
+}
+
+void PhaseLatencies::report(std::ostream& out) const {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    for (size_t i = 0; i < phases_.size(); ++i) {
+        const auto& histogram = histograms_[i];
+        uint64_t count = histogram.count();
+        if (count == 0) continue;
+        out << owner_ << " " << phases_[i] << ": n " << count << std::fixed << std::setprecision(1)
+            << ", p50 " << us(histogram.percentile(0.5))
+            << " us, p99 " << us(histogram.percentile(0.99))
+            << " us, p99.9 " << us(histogram.percentile(0.999))
+            << " us, max " << us(histogram.max()) << " us" << std::endl;
+    }
+}
+
+void report_latencies(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    out << "Step latencies:" << std::endl;
+    for (const auto* latencies : registry()) latencies->report(out);
+}
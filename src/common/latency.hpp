@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Log-linear histogram of latencies in nanoseconds, HDR style: values below
+// 64 ns have a bucket each, larger ones 32 buckets per power of two (3%
+// resolution) up to 2^40 ns, about 18 minutes; longer ones fall into the
+// last bucket. Recording is one relaxed increment, so a histogram can be
+// read while its owner keeps recording.
+class LatencyHistogram {
+private:
+    static constexpr int kSubBits = 5;
+    static constexpr uint64_t kSubCount = uint64_t{1} << kSubBits;  // 32
+    static constexpr int kMaxBits = 40;
+    // 64 linear buckets, then 32 for each power of two from 2^6 up to 2^(kMaxBits-1)
+    static constexpr size_t kBuckets = 2 * kSubCount + (kMaxBits - kSubBits - 1) * kSubCount;
+
+    std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+    std::atomic<uint64_t> max_{0};
+
+    static size_t bucket(uint64_t ns) {
+        if (ns >= (uint64_t{1} << kMaxBits)) ns = (uint64_t{1} << kMaxBits) - 1;
+        if (ns < 2 * kSubCount) return static_cast<size_t>(ns);
+#ifdef _MSC_VER
+        unsigned long msb_index;
+        _BitScanReverse64(&msb_index, ns);
+        int msb = static_cast<int>(msb_index);
+#else
+        int msb = 63 - __builtin_clzll(ns);
+#endif
+        int shift = msb - kSubBits;
+        return static_cast<size_t>(2 * kSubCount + (shift - 1) * kSubCount + ((ns >> shift) - kSubCount));
+    }
+
+    // Largest value that falls into `index`
+    static uint64_t upper_bound(size_t index) {
+        if (index < 2 * kSubCount) return index;
+        size_t shift = (index - 2 * kSubCount) / kSubCount + 1;
+        uint64_t sub = (index - 2 * kSubCount) % kSubCount + kSubCount;
+        return ((sub + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t ns) {
+        counts_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const auto& count : counts_) total += count.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // Value at or below which a fraction `q` of the recordings lie
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        auto target = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= target) return std::min(upper_bound(i), max());
+        }
+        return max();
+    }
+};
+
+// Per-phase latency histograms of one step path owner, such as a client on
+// the server or an instance on a client host. Each phase has one writer at a
+// time; the histograms are registered for report_latencies() while they live.
+// With tracing on, every recording is also a span on the owner's track.
+class PhaseLatencies {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::string owner_;
+    std::vector<const char*> phases_;
+    std::unique_ptr<LatencyHistogram[]> histograms_;
+    uint32_t trace_track_;
+    std::vector<uint32_t> trace_names_;
+
+public:
+    PhaseLatencies(std::string owner, std::vector<const char*> phases);
+    ~PhaseLatencies();
+
+    PhaseLatencies(const PhaseLatencies&) = delete;
+    PhaseLatencies& operator=(const PhaseLatencies&) = delete;
+
+    static Clock::time_point now() { return Clock::now(); }
+
+    void record(size_t phase, Clock::time_point begin, Clock::time_point end) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        histograms_[phase].record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+        trace_span(trace_track_, trace_names_[phase], begin, end);
+    }
+
+    // Records the time since `start` under `phase` and returns the current
+    // time, so consecutive phases chain without extra clock reads
+    Clock::time_point lap(size_t phase, Clock::time_point start) {
+        auto end = now();
+        record(phase, start, end);
+        return end;
+    }
+
+    // One line per phase with recordings: count, p50, p99, p99.9 and max in microseconds
+    void report(std::ostream& out) const;
+};
+
+// Writes the histograms of every live PhaseLatencies
+void report_latencies(std::ostream& out = std::cerr);
@@ -1,7 +1,27 @@
 #include "network.hpp"
+#include "async_log.hpp"
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 
+namespace {
+
+// A message send() copied, freed once MsQuic is done with it
+struct OwnedSend : PendingSend {
+    std::unique_ptr<uint8_t[]> data;
+};
+
+void release(PendingSend* pending) {
+    if (pending->owned) {
+        delete static_cast<OwnedSend*>(pending);
+    } else {
+        pending->in_flight.store(false, std::memory_order_release);
+    }
+}
+
+}  // namespace
+
 const QUIC_API_TABLE* QuicConnection::MsQuic = nullptr;
 HQUIC QuicConnection::Registration = nullptr;
 
@@ -36,6 +56,7 @@ QuicConnection::QuicConnection(bool is_server)
     , stream_(nullptr)
     , context_(std::make_unique<ConnectionContext>())
     , is_server_(is_server) {
+    context_->owner = this;
     
     if (!InitializeMsQuic()) {
         throw std::runtime_error("Failed to initialize MSQUIC");
@@ -44,10 +65,15 @@ QuicConnection::QuicConnection(bool is_server)
     QUIC_SETTINGS Settings = {0};
     Settings.IdleTimeoutMs = 5000;
     Settings.IsSet.IdleTimeoutMs = TRUE;
+    // Clients open the one stream each connection carries
+    Settings.PeerBidiStreamCount = 1;
+    Settings.IsSet.PeerBidiStreamCount = TRUE;
 
+    // The ALPN the listener announces
+    QUIC_BUFFER alpn = { sizeof("simulation") - 1, (uint8_t*)"simulation" };
     QUIC_STATUS status = MsQuic->ConfigurationOpen(
         Registration,
-        nullptr, 0,  // No ALPN needed for our use case
+        &alpn, 1,
         &Settings,
         sizeof(Settings),
         nullptr,
@@ -59,7 +85,19 @@ QuicConnection::QuicConnection(bool is_server)
     }
 }
 
+QuicConnection::QuicConnection(HQUIC accepted)
+    : connection_(accepted)
+    , configuration_(nullptr)
+    , stream_(nullptr)
+    , context_(std::make_unique<ConnectionContext>())
+    , is_server_(true) {
+    context_->owner = this;
+}
+
 QuicConnection::~QuicConnection() {
+    // Accepted connections go first, as they use the listener's configuration
+    if (listener_) MsQuic->ListenerClose(listener_);
+    peers_.clear();
     if (stream_) MsQuic->StreamClose(stream_);
     if (connection_) MsQuic->ConnectionClose(connection_);
     if (configuration_) MsQuic->ConfigurationClose(configuration_);
@@ -75,14 +113,26 @@ QUIC_STATUS QuicConnection::ConnectionCallback(
     switch (Event->Type) {
         case QUIC_CONNECTION_EVENT_CONNECTED:
             conn_context->connected = true;
+            if (conn_context->on_connected) {
+                conn_context->on_connected();
+            }
             break;
             
+        case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED: {
+            // An accepted connection answers on the stream its client opened
+            HQUIC stream = Event->PEER_STREAM_STARTED.Stream;
+            MsQuic->SetCallbackHandler(stream, reinterpret_cast<void*>(StreamCallback), conn_context);
+            std::lock_guard<std::mutex> lock(conn_context->owner->send_mutex_);
+            if (!conn_context->owner->stream_) conn_context->owner->stream_ = stream;
+            break;
+        }
+
         case QUIC_CONNECTION_EVENT_SHUTDOWN_INITIATED_BY_PEER:
             // Handle shutdown
             break;
             
         case QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE:
-            // Handle complete shutdown
+            conn_context->connected = false;
             break;
     }
     
@@ -98,22 +148,73 @@ QUIC_STATUS QuicConnection::StreamCallback(
     
     switch (Event->Type) {
         case QUIC_STREAM_EVENT_RECEIVE:
-            if (conn_context->handler) {
-                conn_context->handler(
-                    Event->RECEIVE.Buffers[0].Buffer,
-                    Event->RECEIVE.Buffers[0].Length
-                );
+            if (!receive(*conn_context, Event->RECEIVE.Buffers, Event->RECEIVE.BufferCount)) {
+                async_log(LogCategory::Network, "Aborting stream after a message length of {}",
+                          conn_context->message_size);
+                MsQuic->StreamShutdown(Stream, QUIC_STREAM_SHUTDOWN_FLAG_ABORT, 0);
             }
             break;
             
         case QUIC_STREAM_EVENT_SEND_COMPLETE:
-            // Handle send complete
+            // Zero-copy sends hand their buffer back to its owner
+            if (auto* pending = static_cast<PendingSend*>(Event->SEND_COMPLETE.ClientContext)) {
+                release(pending);
+            }
             break;
     }
     
     return QUIC_STATUS_SUCCESS;
 }
 
+bool QuicConnection::receive(ConnectionContext& context, const QUIC_BUFFER* buffers, uint32_t count) {
+    auto deliver = [&context](const uint8_t* data, size_t size) {
+        if (context.handler) context.handler(data, size);
+        context.header_bytes = 0;
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t* data = buffers[i].Buffer;
+        size_t size = buffers[i].Length;
+        while (size > 0) {
+            if (context.header_bytes < sizeof(context.header)) {
+                size_t take = std::min(size, sizeof(context.header) - context.header_bytes);
+                std::memcpy(context.header + context.header_bytes, data, take);
+                context.header_bytes += take;
+                data += take;
+                size -= take;
+                if (context.header_bytes < sizeof(context.header)) break;
+
+                context.message_size = static_cast<size_t>(context.header[0]) |
+                                       static_cast<size_t>(context.header[1]) << 8 |
+                                       static_cast<size_t>(context.header[2]) << 16 |
+                                       static_cast<size_t>(context.header[3]) << 24;
+                if (context.message_size > kMaxMessageSize) return false;
+                context.recv_buffer.clear();
+                if (context.message_size == 0) deliver(data, 0);
+                continue;
+            }
+
+            // A message lying whole in this buffer is handled in place
+            if (context.recv_buffer.empty() && size >= context.message_size) {
+                deliver(data, context.message_size);
+                data += context.message_size;
+                size -= context.message_size;
+                continue;
+            }
+
+            size_t take = std::min(size, context.message_size - context.recv_buffer.size());
+            context.recv_buffer.insert(context.recv_buffer.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (context.recv_buffer.size() == context.message_size) {
+                deliver(context.recv_buffer.data(), context.message_size);
+                context.recv_buffer.clear();
+            }
+        }
+    }
+    return true;
+}
+
 bool QuicConnection::connect(const std::string& host, uint16_t port) {
     if (is_server_) return false;
 
@@ -151,28 +252,11 @@ bool QuicConnection::listen(uint16_t port) {
     QUIC_ADDR addr = {0};
     QuicAddrSetPort(&addr, port);
 
-    auto ListenerCallback = [](
-        HQUIC Listener,
-        void* Context,
-        QUIC_LISTENER_EVENT* Event
-    ) -> QUIC_STATUS {
-        auto conn_context = static_cast<ConnectionContext*>(Context);
-        
-        if (Event->Type == QUIC_LISTENER_EVENT_NEW_CONNECTION) {
-            return ConnectionCallback(
-                Event->NEW_CONNECTION.Connection,
-                Context,
-                nullptr
-            );
-        }
-        return QUIC_STATUS_SUCCESS;
-    };
-
     QUIC_STATUS status = MsQuic->ListenerOpen(
         Registration,
         ListenerCallback,
-        context_.get(),
-        &connection_
+        this,
+        &listener_
     );
 
     if (QUIC_FAILED(status)) {
@@ -182,7 +266,7 @@ bool QuicConnection::listen(uint16_t port) {
 
     QUIC_BUFFER alpn = { sizeof("simulation") - 1, (uint8_t*)"simulation" };
     status = MsQuic->ListenerStart(
-        connection_,
+        listener_,
         &alpn,
         1,
         &addr
@@ -196,45 +280,108 @@ bool QuicConnection::listen(uint16_t port) {
     return true;
 }
 
+QUIC_STATUS QuicConnection::ListenerCallback(
+    HQUIC Listener,
+    void* Context,
+    QUIC_LISTENER_EVENT* Event
+) {
+    auto listener = static_cast<QuicConnection*>(Context);
+    if (Event->Type != QUIC_LISTENER_EVENT_NEW_CONNECTION) return QUIC_STATUS_SUCCESS;
+
+    // Each client gets its own connection object; the handler sets it up
+    // before MsQuic delivers any of its events
+    HQUIC accepted = Event->NEW_CONNECTION.Connection;
+    std::shared_ptr<QuicConnection> peer(new QuicConnection(accepted));
+    MsQuic->SetCallbackHandler(accepted, reinterpret_cast<void*>(ConnectionCallback), peer->context_.get());
+    if (listener->on_peer_) listener->on_peer_(peer);
+
+    QUIC_STATUS status = MsQuic->ConnectionSetConfiguration(accepted, listener->configuration_);
+    if (QUIC_FAILED(status)) {
+        // MsQuic closes a connection the listener refuses
+        async_log(LogCategory::Network, "ConnectionSetConfiguration failed with status: {}", status);
+        peer->connection_ = nullptr;
+        return status;
+    }
+
+    std::lock_guard<std::mutex> lock(listener->peers_mutex_);
+    listener->peers_.push_back(std::move(peer));
+    return QUIC_STATUS_SUCCESS;
+}
+
+bool QuicConnection::open_stream() {
+    if (stream_) return true;
+
+    QUIC_STATUS status = MsQuic->StreamOpen(
+        connection_,
+        QUIC_STREAM_OPEN_FLAG_NONE,
+        StreamCallback,
+        context_.get(),
+        &stream_
+    );
+
+    if (QUIC_FAILED(status)) {
+        std::cerr << "StreamOpen failed with status: " << status << std::endl;
+        stream_ = nullptr;
+        return false;
+    }
+
+    status = MsQuic->StreamStart(stream_, QUIC_STREAM_START_FLAG_NONE);
+    if (QUIC_FAILED(status)) {
+        std::cerr << "StreamStart failed with status: " << status << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 bool QuicConnection::send(const uint8_t* data, size_t len) {
     if (!connection_ || !context_->connected) return false;
+    if (len > kMaxMessageSize) return false;
 
-    if (!stream_) {
-        QUIC_STATUS status = MsQuic->StreamOpen(
-            connection_,
-            QUIC_STREAM_OPEN_FLAG_NONE,
-            StreamCallback,
-            context_.get(),
-            &stream_
-        );
-
-        if (QUIC_FAILED(status)) {
-            std::cerr << "StreamOpen failed with status: " << status << std::endl;
-            return false;
-        }
+    auto copy = std::make_unique<OwnedSend>();
+    copy->data = std::make_unique<uint8_t[]>(len);
+    if (len > 0) std::memcpy(copy->data.get(), data, len);
+    copy->buffer = {static_cast<uint32_t>(len), copy->data.get()};
+    copy->owned = true;
 
-        status = MsQuic->StreamStart(stream_, QUIC_STREAM_START_FLAG_NONE);
-        if (QUIC_FAILED(status)) {
-            std::cerr << "StreamStart failed with status: " << status << std::endl;
-            return false;
-        }
-    }
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (!open_stream()) return false;
 
-    QUIC_BUFFER buffer = {
-        static_cast<uint32_t>(len),
-        const_cast<uint8_t*>(data)
-    };
+    // On success the stream callback frees the copy
+    if (!send_frame(*copy)) return false;
+    copy.release();
+    return true;
+}
+
+bool QuicConnection::send(PendingSend& pending) {
+    if (!connection_ || !context_->connected) return false;
+    if (pending.buffer.Length > kMaxMessageSize) return false;
 
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (!open_stream()) return false;
+    return send_frame(pending);
+}
+
+bool QuicConnection::send_frame(PendingSend& pending) {
+    uint32_t length = pending.buffer.Length;
+    for (size_t i = 0; i < sizeof(pending.prefix); ++i) {
+        pending.prefix[i] = static_cast<uint8_t>(length >> (8 * i));
+    }
+    pending.frame[0] = {sizeof(pending.prefix), pending.prefix};
+    pending.frame[1] = pending.buffer;
+
+    pending.in_flight.store(true, std::memory_order_relaxed);
     QUIC_STATUS status = MsQuic->StreamSend(
         stream_,
-        &buffer,
-        1,
+        pending.frame,
+        2,
         QUIC_SEND_FLAG_NONE,
-        nullptr
+        &pending
     );
 
     if (QUIC_FAILED(status)) {
-        std::cerr << "StreamSend failed with status: " << status << std::endl;
+        pending.in_flight.store(false, std::memory_order_relaxed);
+        async_log(LogCategory::Network, "StreamSend failed with status: {}", status);
         return false;
     }
 
@@ -245,6 +392,14 @@ void QuicConnection::set_message_handler(MessageHandler handler) {
     context_->handler = std::move(handler);
 }
 
+void QuicConnection::set_connected_handler(ConnectedHandler handler) {
+    context_->on_connected = std::move(handler);
+}
+
+void QuicConnection::set_peer_handler(PeerHandler handler) {
+    on_peer_ = std::move(handler);
+}
+
 void QuicConnection::poll() {
     // MSQUIC is event-driven, no need for explicit polling
 } 
\ No newline at end of file
@@ -10,23 +10,54 @@
  */
 
 #pragma once
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
 #include <functional>
+#include <mutex>
 #include <msquic.h>
 
+// A send whose data MsQuic reads without copying. `buffer` and the data it
+// points to must stay untouched while `in_flight` is set; the stream callback
+// clears it on completion.
+struct PendingSend {
+    QUIC_BUFFER buffer{};
+    std::atomic<bool> in_flight{false};
+    // Length prefix and the buffers handed to MsQuic, filled in by QuicConnection::send()
+    uint8_t prefix[4]{};
+    QUIC_BUFFER frame[2]{};
+    // Set on the copies QuicConnection makes itself, which it frees on completion
+    bool owned = false;
+};
+
+// Messages travel on one stream, each behind a little-endian uint32 length,
+// since MsQuic splits and merges the bytes of a stream freely across
+// receive events. The message handler sees whole messages only.
 class QuicConnection {
 public:
+    // Larger lengths mean the stream is corrupt, and it is aborted
+    static constexpr uint32_t kMaxMessageSize = 256u * 1024 * 1024;
+
     using MessageHandler = std::function<void(const uint8_t*, size_t)>;
+    using ConnectedHandler = std::function<void()>;
+    // Gets each connection a listener accepts, before any of its messages
+    using PeerHandler = std::function<void(const std::shared_ptr<QuicConnection>&)>;
 
     QuicConnection(bool is_server);
     ~QuicConnection();
 
     bool connect(const std::string& host, uint16_t port);
     bool listen(uint16_t port);
+    // Copies the message; MsQuic may send it after the call returns
     bool send(const uint8_t* data, size_t len);
+    // Sends `pending.buffer` in place, see PendingSend
+    bool send(PendingSend& pending);
     void set_message_handler(MessageHandler handler);
+    // Called on an MsQuic thread once the handshake completes; the place to greet the peer
+    void set_connected_handler(ConnectedHandler handler);
+    // Set on a listener before listen(); the peer answers on the stream its client opened
+    void set_peer_handler(PeerHandler handler);
     void poll();
 
 private:
@@ -35,26 +66,56 @@ private:
     static bool InitializeMsQuic();
     
     struct ConnectionContext {
+        QuicConnection* owner;
         MessageHandler handler;
+        ConnectedHandler on_connected;
+        // Length prefix and body of the message being received
+        uint8_t header[4];
+        size_t header_bytes;
+        size_t message_size;
         std::vector<uint8_t> recv_buffer;
         bool connected;
     };
 
+    // Hands the complete messages among `buffers` to the handler and keeps
+    // the rest for the next receive event; false if the stream is corrupt
+    static bool receive(ConnectionContext& context, const QUIC_BUFFER* buffers, uint32_t count);
+
     static QUIC_STATUS QUIC_API ConnectionCallback(
         HQUIC Connection,
         void* Context,
         QUIC_CONNECTION_EVENT* Event
     );
 
+    static QUIC_STATUS QUIC_API ListenerCallback(
+        HQUIC Listener,
+        void* Context,
+        QUIC_LISTENER_EVENT* Event
+    );
+
     static QUIC_STATUS QUIC_API StreamCallback(
         HQUIC Stream,
         void* Context,
         QUIC_STREAM_EVENT* Event
     );
 
+    // A connection accepted by a listener, which keeps the configuration
+    explicit QuicConnection(HQUIC accepted);
+
     HQUIC connection_;
     HQUIC configuration_;
     HQUIC stream_;
+    HQUIC listener_ = nullptr;
+    // Connections accepted by a listener
+    PeerHandler on_peer_;
+    std::mutex peers_mutex_;
+    std::vector<std::shared_ptr<QuicConnection>> peers_;
+    // Serializes senders; a client host answers from several pool threads
+    std::mutex send_mutex_;
+
+    bool open_stream();
+    // Sends `pending` with its length prefix; caller holds send_mutex_
+    bool send_frame(PendingSend& pending);
     std::unique_ptr<ConnectionContext> context_;
     bool is_server_;
 }; 
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "osmp.hpp"
+#include <map>
+
+namespace {
+
+struct Components {
+    const cosim::variable_description* lo = nullptr;
+    const cosim::variable_description* hi = nullptr;
+    const cosim::variable_description* size = nullptr;
+};
+
+bool strip_suffix(const std::string& name, const std::string& suffix, std::string& stem) {
+    if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    stem = name.substr(0, name.size() - suffix.size());
+    return true;
+}
+
+}  // namespace
+
+std::vector<BinaryVariable> binary_variables(const cosim::model_description& model) {
+    // Ordered by name, so both ends of a connection list them alike
+    std::map<std::string, Components> candidates;
+    for (const auto& var : model.variables) {
+        if (var.type != cosim::variable_type::integer) continue;
+        std::string stem;
+        if (strip_suffix(var.name, ".base.lo", stem)) {
+            candidates[stem].lo = &var;
+        } else if (strip_suffix(var.name, ".base.hi", stem)) {
+            candidates[stem].hi = &var;
+        } else if (strip_suffix(var.name, ".size", stem)) {
+            candidates[stem].size = &var;
+        }
+    }
+
+    std::vector<BinaryVariable> binaries;
+    for (const auto& entry : candidates) {
+        const auto& parts = entry.second;
+        if (!parts.lo || !parts.hi || !parts.size) continue;
+        if (parts.hi->causality != parts.lo->causality || parts.size->causality != parts.lo->causality) continue;
+        binaries.push_back({entry.first, parts.lo->reference, parts.hi->reference, parts.size->reference,
+                            parts.lo->causality});
+    }
+    return binaries;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cosim/model_description.hpp>
+
+// FMI 2 has no binary type. Following the OSI Sensor Model Packaging
+// convention, a binary variable X is exposed as three integer variables:
+// X.base.lo and X.base.hi hold the two halves of a pointer to the data and
+// X.size its length. The binary variable is addressed by the reference of
+// X.base.lo.
+struct BinaryVariable {
+    std::string name;
+    cosim::value_reference lo;
+    cosim::value_reference hi;
+    cosim::value_reference size;
+    cosim::variable_causality causality;
+};
+
+// Binary variables of `model`: every complete lo/hi/size triple of integer
+// variables with the same causality
+std::vector<BinaryVariable> binary_variables(const cosim::model_description& model);
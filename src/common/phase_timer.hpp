@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Wall-clock durations of consecutive startup phases, printed as one summary
+class PhaseTimer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start_;
+    Clock::time_point last_;
+    std::vector<std::pair<std::string, double>> phases_;
+
+public:
+    PhaseTimer()
+        : start_(Clock::now())
+        , last_(start_) {}
+
+    // Ends the running phase under `name` and starts the next one
+    void mark(const std::string& name) {
+        auto now = Clock::now();
+        phases_.emplace_back(name, std::chrono::duration<double, std::milli>(now - last_).count());
+        last_ = now;
+    }
+
+    void report(const std::string& title, std::ostream& out = std::cerr) const {
+        out << title << " startup:";
+        for (const auto& phase : phases_) {
+            out << " " << phase.first << " " << std::fixed << std::setprecision(1) << phase.second << " ms,";
+        }
+        out << " total " << std::fixed << std::setprecision(1)
+            << std::chrono::duration<double, std::milli>(last_ - start_).count() << " ms" << std::endl;
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "simulation_protocol_generated.h"
+#include "trace.hpp"
+#include "variable_table.hpp"
+
+// Wire protocol version spoken by this build. Version 1 carries every value
+// as a Variable table; version 2 carries SignalVector reference and value
+// arrays. A peer that never sends Hello or Welcome is treated as version 1.
+constexpr uint32_t kProtocolVersion = 2;
+
+// Optional features (SimProtocol::Feature bits) this build implements
+constexpr uint32_t kSupportedFeatures = SimProtocol::Feature_Compression | SimProtocol::Feature_SlotMap;
+
+// Version both sides use once they know the peer's
+inline uint32_t negotiated_version(uint32_t peer_version) {
+    return std::max<uint32_t>(1, std::min(peer_version, kProtocolVersion));
+}
+
+inline bool is_step_request(const SimProtocol::Message* msg) {
+    return msg->message_type_type() == SimProtocol::MessageType_StepRequest ||
+           msg->message_type_type() == SimProtocol::MessageType_StepRequestV2;
+}
+
+// Instance addressed by a step request of either version
+inline uint32_t request_instance_id(const SimProtocol::Message* msg) {
+    if (const auto* request = msg->message_type_as_StepRequestV2()) return request->instance_id();
+    if (const auto* request = msg->message_type_as_StepRequest()) return request->instance_id();
+    return 0;
+}
+
+inline bool has_feature(uint32_t features, SimProtocol::Feature feature) {
+    return (features & static_cast<uint32_t>(feature)) != 0;
+}
+
+// Build right before sending: the Hello carries the send time for the clock offset
+inline void build_hello(flatbuffers::FlatBufferBuilder& builder, const std::vector<uint32_t>& client_ids,
+                        uint32_t features) {
+    auto hello = SimProtocol::CreateHello(builder, kProtocolVersion, builder.CreateVector(client_ids),
+                                          static_cast<SimProtocol::Feature>(features), trace_clock_now());
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_Hello, hello.Union()));
+}
+
+// Server clock readings around the Hello it answers
+struct HandshakeClock {
+    int64_t hello_ns = 0;     // Hello.clock_ns
+    int64_t received_ns = 0;  // When the Hello arrived
+};
+
+// `features` are those both sides support
+inline void build_welcome(flatbuffers::FlatBufferBuilder& builder, uint32_t features, uint32_t compression_threshold,
+                          HandshakeClock clock = {}, bool trace = false) {
+    auto welcome = SimProtocol::CreateWelcome(builder, kProtocolVersion,
+                                              static_cast<SimProtocol::Feature>(features), compression_threshold,
+                                              clock.hello_ns, clock.received_ns, trace_clock_now(), trace);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_Welcome, welcome.Union()));
+}
+
+// Server clock minus client clock, NTP style: the mean of the offsets seen
+// on the way there and back, off by at most half the path asymmetry.
+// `arrived_ns` is when the Welcome arrived; 0 if the server sent no clock.
+inline int64_t clock_offset(const SimProtocol::Welcome* welcome, int64_t arrived_ns) {
+    if (welcome->hello_clock_ns() == 0) return 0;
+    return ((welcome->received_ns() - welcome->hello_clock_ns()) + (welcome->sent_ns() - arrived_ns)) / 2;
+}
+
+// Takes over the clock offset and tracing switch of a Welcome
+inline void apply_welcome_trace(const SimProtocol::Welcome* welcome, int64_t arrived_ns) {
+    set_trace_clock_offset(clock_offset(welcome, arrived_ns));
+    if (welcome->trace()) set_tracing(true);
+}
+
+inline void build_trace_request(flatbuffers::FlatBufferBuilder& builder, uint32_t instance_id) {
+    auto request = SimProtocol::CreateTraceRequest(builder, instance_id);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_TraceRequest, request.Union()));
+}
+
+// Spans [first, first + count) of `trace`; the name table goes with the first message only
+inline void build_trace_data(flatbuffers::FlatBufferBuilder& builder, uint32_t instance_id, const std::string& process,
+                             const TraceSnapshot& trace, size_t first, size_t count, bool last) {
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> names;
+    if (first == 0) names = builder.CreateVectorOfStrings(trace.names);
+    SimProtocol::TraceSpan* spans = nullptr;
+    auto span_vector = builder.CreateUninitializedVectorOfStructs(count, &spans);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& span = trace.spans[first + i];
+        spans[i] = SimProtocol::TraceSpan(span.begin_ns, span.end_ns, span.track, span.name);
+    }
+    auto data = SimProtocol::CreateTraceData(builder, instance_id, builder.CreateString(process), names,
+                                             span_vector, last);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_TraceData, data.Union()));
+}
+
+// Variables [first, first + count) of a client's table
+inline void build_variable_table(flatbuffers::FlatBufferBuilder& builder, uint32_t instance_id,
+                                 const std::vector<SignalVariable>& variables, size_t first, size_t count,
+                                 bool last) {
+    std::vector<flatbuffers::Offset<SimProtocol::VariableDescription>> entries;
+    entries.reserve(count);
+    for (size_t i = first; i < first + count; ++i) {
+        const auto& var = variables[i];
+        entries.push_back(SimProtocol::CreateVariableDescription(builder, builder.CreateString(var.name),
+                                                                 var.reference, var.type, var.causality));
+    }
+    auto table = SimProtocol::CreateVariableTable(builder, instance_id, builder.CreateVector(entries), last);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_VariableTable, table.Union()));
+}
+
+// References of the real, integer and boolean variables in one half of a slot map
+using SlotMapRefs = std::array<std::vector<uint32_t>, 3>;
+
+inline void build_slot_map(flatbuffers::FlatBufferBuilder& builder, uint32_t instance_id, const SlotMapRefs& inputs,
+                           const SlotMapRefs& outputs, bool last, uint32_t epoch) {
+    auto refs_only = [&builder](const SlotMapRefs& refs) {
+        auto reals = builder.CreateVector(refs[SimProtocol::ValueType_Real]);
+        auto integers = builder.CreateVector(refs[SimProtocol::ValueType_Integer]);
+        auto booleans = builder.CreateVector(refs[SimProtocol::ValueType_Boolean]);
+        return SimProtocol::CreateSignalVector(builder, reals, 0, integers, 0, booleans);
+    };
+    auto input_refs = refs_only(inputs);
+    auto output_refs = refs_only(outputs);
+    auto map = SimProtocol::CreateSlotMap(builder, instance_id, input_refs, output_refs, last, epoch);
+    builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_SlotMap, map.Union()));
+}
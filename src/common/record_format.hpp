@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// On-disk layout of a recorded result file. Values are stored column by
+// column in chunks of `chunk_rows` rows, so a reader maps only the pages of
+// the columns it needs:
+//
+//   FileHeader
+//   ColumnInfo[column_count]
+//   name table (column names, not terminated)
+//   chunk 0, chunk 1, ...  at first_chunk + k * chunk_bytes
+//
+// Every chunk has the same layout: the time column (int64 microseconds of
+// simulated time, one per row), then one block per column, each starting on
+// a page boundary. A column recorded every `every` rows holds the rows whose
+// index is a multiple of `every`. All integers are in host byte order.
+namespace record_format {
+
+constexpr char kMagic[8] = {'Q', 'S', 'I', 'M', 'R', 'E', 'C', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kAlignment = 4096;
+
+// Same values as SimProtocol::ValueType
+enum ColumnType : uint8_t { Real = 0, Integer = 1, Boolean = 2 };
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint32_t chunk_rows;
+    uint32_t reserved;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t first_chunk;
+    uint64_t chunk_bytes;
+    uint64_t row_count;  // Rows written so far; updated while recording
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+
+struct ColumnInfo {
+    uint64_t name_offset;  // Into the name table
+    uint32_t name_size;
+    uint32_t every;        // Decimation: rows per recorded sample
+    uint32_t client_id;
+    uint32_t reference;    // Value reference of the recorded output
+    uint8_t type;          // ColumnType
+    uint8_t reserved[7];
+};
+static_assert(sizeof(ColumnInfo) == 32, "ColumnInfo layout");
+
+inline uint64_t align(uint64_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+
+inline size_t value_size(uint8_t type) {
+    switch (type) {
+        case Real: return sizeof(double);
+        case Integer: return sizeof(int32_t);
+        default: return sizeof(uint8_t);
+    }
+}
+
+// First sample of a column taken in or after `row`
+inline uint64_t sample_index(uint64_t row, uint32_t every) { return (row + every - 1) / every; }
+
+// Most samples a chunk can hold for a column
+inline uint64_t sample_capacity(uint32_t chunk_rows, uint32_t every) { return (chunk_rows + every - 1) / every; }
+
+// Offsets of the column blocks within a chunk, and the chunk size
+inline std::vector<uint64_t> column_offsets(const ColumnInfo* columns, size_t count, uint32_t chunk_rows,
+                                            uint64_t& chunk_bytes) {
+    std::vector<uint64_t> offsets(count);
+    uint64_t offset = align(uint64_t{chunk_rows} * sizeof(int64_t));
+    for (size_t i = 0; i < count; ++i) {
+        offsets[i] = offset;
+        offset = align(offset + sample_capacity(chunk_rows, columns[i].every) * value_size(columns[i].type));
+    }
+    chunk_bytes = offset;
+    return offsets;
+}
+
+}  // namespace record_format
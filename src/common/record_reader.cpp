@@ -0,0 +1,85 @@
+#include "record_reader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+RecordReader::RecordReader(const std::string& path)
+    : path_(path) {
+    using namespace record_format;
+
+    std::ifstream in(path_, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + path_);
+    in.read(reinterpret_cast<char*>(&header_), sizeof(header_));
+    if (!in || std::memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0 || header_.version != kVersion) {
+        throw std::runtime_error(path_ + " is not a result file of this version");
+    }
+
+    infos_.resize(header_.column_count);
+    in.read(reinterpret_cast<char*>(infos_.data()), static_cast<std::streamsize>(infos_.size() * sizeof(ColumnInfo)));
+    std::string names(header_.names_size, '\0');
+    in.seekg(static_cast<std::streamoff>(header_.names_offset));
+    in.read(&names[0], static_cast<std::streamsize>(names.size()));
+    if (!in) throw std::runtime_error("Truncated column table in " + path_);
+
+    for (const auto& info : infos_) {
+        if (info.name_offset + info.name_size > names.size() || info.every == 0 || info.type > Boolean) {
+            throw std::runtime_error("Corrupt column table in " + path_);
+        }
+        columns_.push_back({names.substr(info.name_offset, info.name_size), static_cast<ColumnType>(info.type),
+                            info.every, info.client_id, info.reference});
+    }
+
+    uint64_t chunk_bytes = 0;
+    offsets_ = column_offsets(infos_.data(), infos_.size(), header_.chunk_rows, chunk_bytes);
+    if (chunk_bytes != header_.chunk_bytes) throw std::runtime_error("Inconsistent chunk layout in " + path_);
+
+    file_ = boost::interprocess::file_mapping(path_.c_str(), boost::interprocess::read_only);
+}
+
+int RecordReader::find(const std::string& name) const {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        if (columns_[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+uint64_t RecordReader::chunk_count() const {
+    return (header_.row_count + header_.chunk_rows - 1) / header_.chunk_rows;
+}
+
+uint64_t RecordReader::chunk_rows(uint64_t chunk) const {
+    uint64_t start = chunk * header_.chunk_rows;
+    if (start >= header_.row_count) return 0;
+    return std::min<uint64_t>(header_.chunk_rows, header_.row_count - start);
+}
+
+uint64_t RecordReader::sample_count(size_t column, uint64_t chunk) const {
+    uint32_t every = columns_.at(column).every;
+    uint64_t start = chunk * header_.chunk_rows;
+    return record_format::sample_index(start + chunk_rows(chunk), every) - record_format::sample_index(start, every);
+}
+
+boost::interprocess::mapped_region RecordReader::map(uint64_t chunk, uint64_t offset, size_t bytes) const {
+    if (bytes == 0) return {};
+    using namespace boost::interprocess;
+    uint64_t position = header_.first_chunk + chunk * header_.chunk_bytes + offset;
+    return mapped_region(file_, read_only, static_cast<offset_t>(position), bytes);
+}
+
+RecordReader::ChunkView<int64_t> RecordReader::times(uint64_t chunk) const {
+    size_t rows = static_cast<size_t>(chunk_rows(chunk));
+    return ChunkView<int64_t>(map(chunk, 0, rows * sizeof(int64_t)), rows);
+}
+
+std::vector<int64_t> RecordReader::sample_times(size_t column) const {
+    uint32_t every = columns_.at(column).every;
+    std::vector<int64_t> result;
+    for (uint64_t chunk = 0; chunk < chunk_count(); ++chunk) {
+        auto view = times(chunk);
+        uint64_t start = chunk * header_.chunk_rows;
+        for (uint64_t row = record_format::sample_index(start, every) * every; row < start + view.size(); row += every) {
+            result.push_back(view[static_cast<size_t>(row - start)]);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "record_format.hpp"
+
+// Reads result files of the server's recorder (layout in record_format.hpp).
+// Opening reads only the header and column table; column data is mapped one
+// chunk block at a time, so a reader touches just the pages of the columns
+// it asks for. A file still being recorded reads up to the rows written
+// when it was opened.
+class RecordReader {
+public:
+    struct Column {
+        std::string name;  // "<client id>.<variable>"
+        record_format::ColumnType type;
+        uint32_t every;    // Rows per sample
+        uint32_t client_id;
+        uint32_t reference;
+    };
+
+    // Values of one column in one chunk, mapped read-only
+    template <typename T>
+    class ChunkView {
+    private:
+        boost::interprocess::mapped_region region_;
+        size_t size_ = 0;
+
+    public:
+        ChunkView() = default;
+        ChunkView(boost::interprocess::mapped_region region, size_t size)
+            : region_(std::move(region))
+            , size_(size) {}
+
+        const T* data() const { return static_cast<const T*>(region_.get_address()); }
+        size_t size() const { return size_; }
+        const T* begin() const { return data(); }
+        const T* end() const { return data() + size_; }
+        const T& operator[](size_t i) const { return data()[i]; }
+    };
+
+private:
+    std::string path_;
+    boost::interprocess::file_mapping file_;
+    record_format::FileHeader header_{};
+    std::vector<record_format::ColumnInfo> infos_;
+    std::vector<uint64_t> offsets_;
+    std::vector<Column> columns_;
+
+    // Maps `bytes` bytes at `offset` within chunk `chunk`
+    boost::interprocess::mapped_region map(uint64_t chunk, uint64_t offset, size_t bytes) const;
+
+    // Rows of chunk `chunk`
+    uint64_t chunk_rows(uint64_t chunk) const;
+
+    template <typename T>
+    static constexpr record_format::ColumnType column_type();
+
+public:
+    // Throws std::runtime_error if the file is missing or not a result file
+    explicit RecordReader(const std::string& path);
+
+    const std::vector<Column>& columns() const { return columns_; }
+
+    // Index of the column named `name`, or -1
+    int find(const std::string& name) const;
+
+    uint64_t row_count() const { return header_.row_count; }
+    uint64_t chunk_count() const;
+
+    // Samples of `column` in chunk `chunk`
+    uint64_t sample_count(size_t column, uint64_t chunk) const;
+
+    // Simulated time in microseconds of every row of a chunk
+    ChunkView<int64_t> times(uint64_t chunk) const;
+
+    // Samples of a column in one chunk; T must be double, int32_t or uint8_t to match its type
+    template <typename T>
+    ChunkView<T> column(size_t column, uint64_t chunk) const {
+        if (columns_.at(column).type != column_type<T>()) {
+            throw std::invalid_argument("Column " + columns_[column].name + " has another type");
+        }
+        size_t count = static_cast<size_t>(sample_count(column, chunk));
+        return ChunkView<T>(map(chunk, offsets_[column], count * sizeof(T)), count);
+    }
+
+    // Every sample of a column, copied chunk by chunk
+    template <typename T>
+    std::vector<T> read(size_t column) const {
+        std::vector<T> values;
+        for (uint64_t chunk = 0; chunk < chunk_count(); ++chunk) {
+            auto view = this->column<T>(column, chunk);
+            values.insert(values.end(), view.begin(), view.end());
+        }
+        return values;
+    }
+
+    // Simulated time of every sample of a column
+    std::vector<int64_t> sample_times(size_t column) const;
+};
+
+template <>
+constexpr record_format::ColumnType RecordReader::column_type<double>() { return record_format::Real; }
+template <>
+constexpr record_format::ColumnType RecordReader::column_type<int32_t>() { return record_format::Integer; }
+template <>
+constexpr record_format::ColumnType RecordReader::column_type<uint8_t>() { return record_format::Boolean; }
@@ -0,0 +1,72 @@
+#include "run_plan.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <cosim/fs_portability.hpp>
+#include "fmu_cache.hpp"
+
+namespace {
+
+std::string text(const flatbuffers::String* value) { return value ? value->str() : std::string(); }
+
+void check_source(const RunPlanFormat::SourceFile& source, const std::string& hash, const std::string& plan_path) {
+    std::string path = text(source.path());
+    if (cosim::filesystem::file_size(path) != source.size() || (!hash.empty() && hash != text(source.hash()))) {
+        throw std::runtime_error(path + " changed since " + plan_path + " was compiled");
+    }
+}
+
+}  // namespace
+
+bool RunPlan::is_plan(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char head[8] = {};
+    in.read(head, sizeof(head));
+    return in.gcount() == sizeof(head) && RunPlanFormat::RunPlanBufferHasIdentifier(head);
+}
+
+RunPlan::RunPlan(const std::string& path)
+    : path_(path) {
+    using namespace boost::interprocess;
+    file_ = file_mapping(path_.c_str(), read_only);
+    region_ = mapped_region(file_, read_only);
+
+    // Large configurations exceed the verifier's default table limit
+    const auto* data = static_cast<const uint8_t*>(region_.get_address());
+    flatbuffers::Verifier verifier(data, region_.get_size(), 64, 1u << 30);
+    if (!RunPlanFormat::VerifyRunPlanBuffer(verifier)) throw std::runtime_error(path_ + " is not a valid run plan");
+    plan_ = RunPlanFormat::GetRunPlan(data);
+    if (plan_->format_version() != kFormatVersion) {
+        throw std::runtime_error(path_ + " was compiled by another version, compile it again");
+    }
+
+    const auto* config = plan_->config();
+    if (!config || !plan_->settings() || !plan_->clients() || !plan_->fmus()) {
+        throw std::runtime_error(path_ + " is incomplete");
+    }
+    check_source(*config, FmuCache::content_hash(text(config->path())), path_);
+}
+
+YAML::Node RunPlan::settings() const {
+    return YAML::Load(plan_->settings()->str());
+}
+
+std::shared_ptr<const cosim::model_description> RunPlan::model(size_t index) const {
+    const auto* client = plan_->clients()->Get(static_cast<flatbuffers::uoffset_t>(index));
+    std::shared_ptr<const cosim::model_description> model;
+    if (client->model()) model = FmuCache::parse_table(*client->model());
+    if (!model) throw std::runtime_error("No variable table for client " + std::to_string(client->client_id()));
+    return model;
+}
+
+void RunPlan::check_fmu(const std::string& fmu_path, const std::string& hash) const {
+    for (const auto* fmu : *plan_->fmus()) {
+        if (text(fmu->path()) != fmu_path) continue;
+        check_source(*fmu, hash, path_);
+        return;
+    }
+    throw std::runtime_error(fmu_path + " is not part of " + path_);
+}
+
+void RunPlan::check_fmus() const {
+    for (const auto* fmu : *plan_->fmus()) check_source(*fmu, std::string(), path_);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cosim/model_description.hpp>
+#include <yaml-cpp/yaml.h>
+#include "run_plan_generated.h"
+
+// A configuration compiled into one FlatBuffers file (schemas/run_plan.fbs):
+// its settings, the variable table of every client and the resolved routes.
+// The file is mapped and read in place. It records the content hash of its
+// configuration and the size and hash of every FMU, and a plan whose
+// sources changed since it was compiled is refused.
+class RunPlan {
+private:
+    std::string path_;
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region region_;
+    const RunPlanFormat::RunPlan* plan_ = nullptr;
+
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    // True if the file at `path` carries the run plan identifier
+    static bool is_plan(const std::string& path);
+
+    // Maps and verifies the plan and checks its configuration file. Throws
+    // std::runtime_error if the plan is corrupt or the configuration changed.
+    explicit RunPlan(const std::string& path);
+
+    RunPlan(const RunPlan&) = delete;
+    RunPlan& operator=(const RunPlan&) = delete;
+
+    const std::string& path() const { return path_; }
+    const RunPlanFormat::RunPlan& plan() const { return *plan_; }
+
+    // The configuration without its `connections:`
+    YAML::Node settings() const;
+
+    // Variable table of the client at `index` in configuration order
+    std::shared_ptr<const cosim::model_description> model(size_t index) const;
+
+    // Throws std::runtime_error unless the FMU at `fmu_path` is the one the
+    // plan was compiled from. With an empty `hash` only the size is compared.
+    void check_fmu(const std::string& fmu_path, const std::string& hash = std::string()) const;
+
+    // Compares the size of every FMU of the plan
+    void check_fmus() const;
+};
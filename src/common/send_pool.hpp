@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "async_log.hpp"
+#include "compression.hpp"
+#include "network.hpp"
+#include "shm_transport.hpp"
+
+// Fixed set of send buffers for one sender. Messages are built in place in a
+// free buffer and handed to MsQuic without copying; a buffer becomes free
+// again when MsQuic reports the send complete. The sender never blocks on
+// the network and never reuses memory that is still being transmitted.
+class SendPool {
+private:
+    struct Buffer {
+        std::unique_ptr<uint8_t[]> memory;
+        FixedBufferAllocator allocator;
+        flatbuffers::FlatBufferBuilder builder;
+        PendingSend pending;
+
+        explicit Buffer(size_t size)
+            : memory(std::make_unique<uint8_t[]>(size))
+            , allocator(memory.get(), size)
+            , builder(size, &allocator, false) {}
+    };
+
+    size_t buffer_size_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    Buffer* current_ = nullptr;
+    size_t next_ = 0;
+
+    // Cleared buffer that is neither in flight nor current_, or nullptr
+    Buffer* acquire() {
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            Buffer* buffer = buffers_[(next_ + i) % buffers_.size()].get();
+            if (buffer == current_ || buffer->pending.in_flight.load(std::memory_order_acquire)) continue;
+            next_ = (next_ + i + 1) % buffers_.size();
+            buffer->builder.Clear();
+            return buffer;
+        }
+        return nullptr;
+    }
+
+public:
+    SendPool(size_t buffer_count, size_t buffer_size)
+        : buffer_size_(buffer_size) {
+        for (size_t i = 0; i < buffer_count; ++i) {
+            buffers_.push_back(std::make_unique<Buffer>(buffer_size));
+        }
+    }
+
+    // Adds a buffer, for senders whose bursts have no fixed bound
+    void grow() {
+        buffers_.push_back(std::make_unique<Buffer>(buffer_size_));
+    }
+
+    size_t size() const { return buffers_.size(); }
+
+    // Cleared builder over a buffer no longer in flight, or nullptr if all are
+    flatbuffers::FlatBufferBuilder* begin() {
+        current_ = nullptr;
+        current_ = acquire();
+        return current_ ? &current_->builder : nullptr;
+    }
+
+    // Sends the message finished in the builder returned by begin()
+    bool send(QuicConnection& connection) {
+        Buffer* buffer = current_;
+        current_ = nullptr;
+        buffer->pending.buffer.Length = static_cast<uint32_t>(buffer->builder.GetSize());
+        buffer->pending.buffer.Buffer = buffer->builder.GetBufferPointer();
+        return connection.send(buffer->pending);
+    }
+
+    // Like send(), but first compresses the message into a second buffer if
+    // `compressor` asks for it. Falls back to the plain message when no
+    // buffer is free or compression does not pay off.
+    bool send(QuicConnection& connection, MessageCompressor& compressor) {
+        Buffer* raw = current_;
+        if (compressor.wants(raw->builder.GetSize())) {
+            if (Buffer* packed = acquire()) {
+                try {
+                    if (compressor.compress(raw->builder.GetBufferPointer(), raw->builder.GetSize(), packed->builder)) {
+                        current_ = packed;
+                    }
+                } catch (const std::exception& e) {
+                    packed->builder.Reset();
+                    async_log(LogCategory::Transfer, "Sending uncompressed: {}", e.what());
+                }
+            }
+        }
+        return send(connection);
+    }
+
+    // Drops a partially built message, e.g. after it overflowed its buffer
+    void abort() {
+        if (current_) current_->builder.Reset();
+        current_ = nullptr;
+    }
+};
@@ -10,7 +10,7 @@ struct SharedMemoryLayout {
             double real;
             int32_t integer;
             uint8_t boolean;
-            uint32_t string_offset;  // Offset into string pool
+            uint32_t string_offset;  // Offset into SharedStringPool (string_pool.hpp)
         } value;
     };
 
@@ -0,0 +1,247 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <flatbuffers/flatbuffers.h>
+#include "simulation_protocol_generated.h"
+
+// Single-producer/single-consumer ring of fixed-size message slots placed in
+// the shared-memory segment. Messages are built in place by
+// SharedMessageWriter and read in place by the consumer, so a local message
+// is serialized once and never copied.
+class SharedMessageRing {
+private:
+    static constexpr uint32_t kMagic = 0x53524E47u;  // "SRNG"
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t slot_count;
+        uint32_t slot_size;    // payload bytes per slot
+        alignas(64) std::atomic<uint64_t> head;  // next slot the producer publishes
+        alignas(64) std::atomic<uint64_t> tail;  // next slot the consumer reads
+    };
+
+    // Where the finished FlatBuffer lies inside the slot payload
+    struct alignas(64) SlotHeader {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    Header* header_;
+    uint8_t* slots_;
+
+    size_t slot_stride() const { return sizeof(SlotHeader) + header_->slot_size; }
+
+    SlotHeader* slot_header(uint64_t sequence) const {
+        return reinterpret_cast<SlotHeader*>(
+            slots_ + (sequence % header_->slot_count) * slot_stride());
+    }
+
+public:
+    static constexpr size_t required_size(uint32_t slot_count, uint32_t slot_size) {
+        return sizeof(Header) + slot_count * (sizeof(SlotHeader) + ((slot_size + 63) & ~63u));
+    }
+
+    // Formats `region` as an empty ring. Only the creator of the segment calls this.
+    static SharedMessageRing create(void* region, uint32_t slot_count, uint32_t slot_size) {
+        auto* header = new (region) Header();
+        header->magic = kMagic;
+        header->slot_count = slot_count;
+        header->slot_size = (slot_size + 63) & ~63u;
+        header->head.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_relaxed);
+        return SharedMessageRing(region);
+    }
+
+    // Attaches to a ring previously formatted with create()
+    explicit SharedMessageRing(void* region)
+        : header_(static_cast<Header*>(region))
+        , slots_(static_cast<uint8_t*>(region) + sizeof(Header)) {}
+
+    bool valid() const { return header_ && header_->magic == kMagic; }
+    uint32_t slot_count() const { return header_->slot_count; }
+    uint32_t slot_size() const { return header_->slot_size; }
+
+    // ---- Producer side ---------------------------------------------------
+
+    // Payload area of slot `index`; stable for the lifetime of the mapping
+    uint8_t* slot_payload(uint32_t index) const {
+        return slots_ + index * slot_stride() + sizeof(SlotHeader);
+    }
+
+    // Index of the slot the next message goes into, or -1 if the consumer lags a full ring behind
+    int32_t next_slot() const {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        uint64_t tail = header_->tail.load(std::memory_order_acquire);
+        if (head - tail >= header_->slot_count) return -1;
+        return static_cast<int32_t>(head % header_->slot_count);
+    }
+
+    // Publishes a finished buffer that lives inside the payload of next_slot()
+    void commit(const uint8_t* data, size_t size) {
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        SlotHeader* slot = slot_header(head);
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader);
+        slot->offset = static_cast<uint32_t>(data - payload);
+        slot->size = static_cast<uint32_t>(size);
+        header_->head.store(head + 1, std::memory_order_release);
+    }
+
+    // ---- Consumer side ---------------------------------------------------
+
+    // Oldest unread message, read directly from the segment. Returns false when empty.
+    bool front(const uint8_t*& data, size_t& size) const {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        if (tail == header_->head.load(std::memory_order_acquire)) return false;
+        const SlotHeader* slot = slot_header(tail);
+        data = reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader) + slot->offset;
+        size = slot->size;
+        return true;
+    }
+
+    // Zero-copy view of the oldest unread message, or nullptr when empty
+    const SimProtocol::Message* front() const {
+        const uint8_t* data;
+        size_t size;
+        if (!front(data, size)) return nullptr;
+        return flatbuffers::GetRoot<SimProtocol::Message>(data);
+    }
+
+    // Slot index of the oldest unread message
+    uint32_t front_index() const {
+        return static_cast<uint32_t>(header_->tail.load(std::memory_order_relaxed) % header_->slot_count);
+    }
+
+    // Hands the oldest slot back to the producer
+    void pop() {
+        header_->tail.fetch_add(1, std::memory_order_release);
+    }
+};
+
+// SharedMessageRing over ordinary process memory, handing messages from a
+// network thread to a worker thread without locks. Messages are copied in
+// and read in place.
+class MessageMailbox {
+private:
+    struct AlignedDelete {
+        void operator()(uint8_t* memory) const { ::operator delete(memory, std::align_val_t(64)); }
+    };
+
+    std::unique_ptr<uint8_t, AlignedDelete> memory_;
+    SharedMessageRing ring_;
+    // When each slot's message was pushed, published along with it
+    std::unique_ptr<std::chrono::steady_clock::time_point[]> received_at_;
+
+public:
+    MessageMailbox(uint32_t slot_count, uint32_t slot_size)
+        : memory_(static_cast<uint8_t*>(::operator new(
+              SharedMessageRing::required_size(slot_count, slot_size), std::align_val_t(64))))
+        , ring_(SharedMessageRing::create(memory_.get(), slot_count, slot_size))
+        , received_at_(std::make_unique<std::chrono::steady_clock::time_point[]>(slot_count)) {}
+
+    // Copies a message in. Fails if the mailbox is full or the message too large.
+    bool push(const uint8_t* data, size_t size) {
+        if (size > ring_.slot_size()) return false;
+        int32_t slot = ring_.next_slot();
+        if (slot < 0) return false;
+        uint8_t* payload = ring_.slot_payload(static_cast<uint32_t>(slot));
+        std::memcpy(payload, data, size);
+        received_at_[slot] = std::chrono::steady_clock::now();
+        ring_.commit(payload, size);
+        return true;
+    }
+
+    // Oldest message, or nullptr when empty
+    const SimProtocol::Message* front() const { return ring_.front(); }
+
+    // When the oldest message was pushed; only valid while front() is not null
+    std::chrono::steady_clock::time_point front_received_at() const { return received_at_[ring_.front_index()]; }
+
+    void pop() { ring_.pop(); }
+};
+
+// FlatBuffers allocator backed by a fixed region of memory, typically a
+// shared-memory slot. The builder gets the whole region on its first
+// allocation and keeps it across Clear(); a message that does not fit fails
+// instead of spilling onto the heap.
+class FixedBufferAllocator : public flatbuffers::Allocator {
+private:
+    uint8_t* memory_;
+    size_t capacity_;
+
+public:
+    FixedBufferAllocator(uint8_t* memory, size_t capacity)
+        : memory_(memory)
+        , capacity_(capacity) {}
+
+    size_t capacity() const { return capacity_; }
+
+    uint8_t* allocate(size_t size) override {
+        if (size > capacity_) throw std::length_error("FlatBuffer exceeds its fixed buffer");
+        return memory_;
+    }
+
+    void deallocate(uint8_t*, size_t) override {}
+
+    uint8_t* reallocate_downward(uint8_t*, size_t, size_t, size_t, size_t) override {
+        throw std::length_error("FlatBuffer exceeds its fixed buffer");
+    }
+};
+
+// Builds messages directly inside the slots of a SharedMessageRing: one
+// FlatBufferBuilder per slot, each backed by a FixedBufferAllocator over that
+// slot's payload.
+class SharedMessageWriter {
+private:
+    struct SlotBuilder {
+        FixedBufferAllocator allocator;
+        flatbuffers::FlatBufferBuilder builder;
+
+        SlotBuilder(uint8_t* payload, size_t size)
+            : allocator(payload, size)
+            , builder(size, &allocator, false) {}
+    };
+
+    SharedMessageRing ring_;
+    std::vector<std::unique_ptr<SlotBuilder>> builders_;
+    SlotBuilder* current_ = nullptr;
+
+public:
+    explicit SharedMessageWriter(SharedMessageRing ring)
+        : ring_(ring) {
+        for (uint32_t i = 0; i < ring_.slot_count(); ++i) {
+            builders_.push_back(std::make_unique<SlotBuilder>(
+                ring_.slot_payload(i), ring_.slot_size()));
+        }
+    }
+
+    // Largest message a slot holds
+    size_t slot_size() const { return ring_.slot_size(); }
+
+    // Cleared builder writing into the next free slot, or nullptr if the ring is full
+    flatbuffers::FlatBufferBuilder* begin() {
+        int32_t slot = ring_.next_slot();
+        if (slot < 0) return nullptr;
+        current_ = builders_[slot].get();
+        current_->builder.Clear();
+        return &current_->builder;
+    }
+
+    // Publishes the message finished in the builder returned by begin()
+    void commit() {
+        ring_.commit(current_->builder.GetBufferPointer(), current_->builder.GetSize());
+        current_ = nullptr;
+    }
+
+    // Drops a partially built message, e.g. after it overflowed its slot
+    void abort() {
+        if (current_) current_->builder.Reset();
+        current_ = nullptr;
+    }
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <csignal>
+
+// Process signals polled by the main loops: SIGINT/SIGTERM end the run so
+// statistics can be written on the way out, SIGUSR1 asks for them on demand
+// and SIGHUP asks the server to reload its configuration.
+namespace signals_detail {
+inline volatile std::sig_atomic_t stop = 0;
+inline volatile std::sig_atomic_t report = 0;
+inline volatile std::sig_atomic_t reload = 0;
+}  // namespace signals_detail
+
+inline void watch_signals() {
+    std::signal(SIGINT, [](int) { signals_detail::stop = 1; });
+    std::signal(SIGTERM, [](int) { signals_detail::stop = 1; });
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, [](int) { signals_detail::report = 1; });
+#endif
+#ifdef SIGHUP
+    std::signal(SIGHUP, [](int) { signals_detail::reload = 1; });
+#endif
+}
+
+inline bool stop_requested() { return signals_detail::stop != 0; }
+
+// True once per SIGUSR1
+inline bool take_report_request() {
+    if (!signals_detail::report) return false;
+    signals_detail::report = 0;
+    return true;
+}
+
+// True once per SIGHUP
+inline bool take_reload_request() {
+    if (!signals_detail::reload) return false;
+    signals_detail::reload = 0;
+    return true;
+}
@@ -0,0 +1,125 @@
+#include "stats.hpp"
+#include <chrono>
+#include <iostream>
+#include <new>
+
+namespace {
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+StatsPublisher::StatsPublisher(const std::vector<std::pair<uint32_t, bool>>& clients, const std::string& segment_name)
+    : name_(segment_name) {
+    create(clients);
+    publish();
+}
+
+void StatsPublisher::create(const std::vector<std::pair<uint32_t, bool>>& clients) {
+    using namespace boost::interprocess;
+    size_t size = stats::segment_size(clients.size());
+
+    uint8_t* base = nullptr;
+    region_ = mapped_region();
+    private_.reset();
+    if (!name_.empty()) {
+        try {
+            shared_memory_object::remove(name_.c_str());
+            shared_memory_object segment(create_only, name_.c_str(), read_write);
+            segment.truncate(static_cast<offset_t>(size));
+            region_ = mapped_region(segment, read_write);
+            base = static_cast<uint8_t*>(region_.get_address());
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot publish statistics in " << name_ << ": " << e.what() << std::endl;
+            name_.clear();
+        }
+    }
+    if (!base) {
+        private_ = std::make_unique<uint8_t[]>(size);
+        base = private_.get();
+    }
+
+    header_ = new (base) stats::Header{0, stats::kVersion, static_cast<uint32_t>(clients.size()), steady_now_ns()};
+    run_ = new (base + sizeof(stats::Header)) stats::RunStats();
+    clients_ = reinterpret_cast<stats::ClientStats*>(base + sizeof(stats::Header) + sizeof(stats::RunStats));
+    client_count_ = clients.size();
+    for (size_t i = 0; i < clients.size(); ++i) {
+        auto* client = new (&clients_[i]) stats::ClientStats();
+        client->requests.client_id = clients[i].first;
+        client->requests.is_local = clients[i].second ? 1 : 0;
+    }
+}
+
+void StatsPublisher::publish() {
+    // The magic goes last, so a reader never sees a half-initialized segment as valid
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = stats::kMagic;
+}
+
+void StatsPublisher::republish(const std::vector<std::pair<uint32_t, bool>>& clients) {
+    // The old mapping outlives the name, so its values can still be copied
+    auto old_region = std::move(region_);
+    auto old_private = std::move(private_);
+    const auto* old_run = run_;
+    const auto* old_clients = clients_;
+    size_t old_count = client_count_;
+    create(clients);
+
+    auto copy = [](auto& to, const auto& from) { to.store(stats::read(from), std::memory_order_relaxed); };
+    copy(run_->steps, old_run->steps);
+    copy(run_->sim_time_us, old_run->sim_time_us);
+    copy(run_->lateness_ns, old_run->lateness_ns);
+    copy(run_->step_ns, old_run->step_ns);
+    copy(run_->updated_ns, old_run->updated_ns);
+    for (size_t i = 0; i < client_count_; ++i) {
+        auto& client = clients_[i];
+        for (size_t j = 0; j < old_count; ++j) {
+            const auto& old = old_clients[j];
+            if (old.requests.client_id != client.requests.client_id) continue;
+            copy(client.requests.count, old.requests.count);
+            copy(client.requests.bytes, old.requests.bytes);
+            copy(client.responses.count, old.responses.count);
+            copy(client.responses.bytes, old.responses.bytes);
+            copy(client.responses.round_trip_ns, old.responses.round_trip_ns);
+            copy(client.responses.last_round_trip_ns, old.responses.last_round_trip_ns);
+            break;
+        }
+    }
+    publish();
+}
+
+StatsPublisher::~StatsPublisher() {
+    if (!name_.empty()) boost::interprocess::shared_memory_object::remove(name_.c_str());
+}
+
+bool StatsReader::open(const std::string& segment_name) {
+    using namespace boost::interprocess;
+    header_ = nullptr;
+    try {
+        shared_memory_object segment(open_only, segment_name.c_str(), read_only);
+        region_ = mapped_region(segment, read_only);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    const auto* header = static_cast<const stats::Header*>(region_.get_address());
+    if (region_.get_size() < sizeof(stats::Header)) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != stats::kMagic || header->version != stats::kVersion) return false;
+    if (region_.get_size() < stats::segment_size(header->client_count)) return false;
+    header_ = header;
+    return true;
+}
+
+const stats::RunStats& StatsReader::run() const {
+    auto* base = static_cast<const uint8_t*>(region_.get_address());
+    return *reinterpret_cast<const stats::RunStats*>(base + sizeof(stats::Header));
+}
+
+const stats::ClientStats& StatsReader::client(size_t index) const {
+    auto* base = static_cast<const uint8_t*>(region_.get_address());
+    return reinterpret_cast<const stats::ClientStats*>(base + sizeof(stats::Header) + sizeof(stats::RunStats))[index];
+}
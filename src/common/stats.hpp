@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+// Live statistics the server publishes in a small shared-memory segment of
+// its own, apart from the message rings, for quicsim-top to read while the
+// run goes on. Every field has a single writer, which updates it with a
+// relaxed load and store, and each writer's fields sit on cache lines of
+// their own, so the step path pays a few uncontended stores per message.
+// Readers take rates from the difference of two samples.
+namespace stats {
+
+constexpr const char* kDefaultSegment = "simulation_stats";
+constexpr uint32_t kMagic = 0x51535453;  // "QSTS"
+constexpr uint32_t kVersion = 1;
+
+using Counter = std::atomic<uint64_t>;
+using Gauge = std::atomic<int64_t>;
+static_assert(Counter::is_always_lock_free && Gauge::is_always_lock_free, "stats need lock-free 64-bit atomics");
+
+// Only writer of a field: no read-modify-write needed
+inline void add(Counter& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+inline void set(Gauge& gauge, int64_t value) { gauge.store(value, std::memory_order_relaxed); }
+inline uint64_t read(const Counter& counter) { return counter.load(std::memory_order_relaxed); }
+inline int64_t read(const Gauge& gauge) { return gauge.load(std::memory_order_relaxed); }
+
+// Written once, before the segment is handed to readers
+struct alignas(64) Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t client_count;
+    int64_t started_ns;  // Steady clock when the server created the segment; changes on restart
+};
+
+// Written by the step thread after every step
+struct alignas(64) RunStats {
+    Counter steps{0};
+    Counter sim_time_us{0};
+    Gauge lateness_ns{0};   // Wall time since the first step minus simulated time
+    Gauge step_ns{0};       // Duration of the last step
+    Gauge updated_ns{0};    // Steady clock at the end of the last step
+};
+
+// One client. Requests are counted by the step thread, responses by
+// whichever thread routes them, so the two halves never share a line.
+struct ClientStats {
+    struct alignas(64) Requests {
+        uint32_t client_id = 0;
+        uint32_t is_local = 0;
+        Counter count{0};
+        Counter bytes{0};
+    } requests;
+    struct alignas(64) Responses {
+        Counter count{0};
+        Counter bytes{0};
+        Counter round_trip_ns{0};  // Sum over all responses
+        Gauge last_round_trip_ns{0};
+    } responses;
+};
+
+// Bytes of a segment for `clients` clients
+inline size_t segment_size(size_t clients) {
+    return sizeof(Header) + sizeof(RunStats) + clients * sizeof(ClientStats);
+}
+
+}  // namespace stats
+
+// The server's side. With a segment name it creates the segment, replacing
+// a stale one, and removes it when done; without one the statistics live in
+// private memory, so the step path writes them the same way either way.
+class StatsPublisher {
+private:
+    std::string name_;
+    boost::interprocess::mapped_region region_;
+    std::unique_ptr<uint8_t[]> private_;
+    stats::Header* header_ = nullptr;
+    stats::RunStats* run_ = nullptr;
+    stats::ClientStats* clients_ = nullptr;
+    size_t client_count_ = 0;
+
+    // Creates the segment, replacing any under the same name, and initializes
+    // everything but the magic
+    void create(const std::vector<std::pair<uint32_t, bool>>& clients);
+
+    // Hands the segment to readers
+    void publish();
+
+public:
+    // One entry per client: its id and whether it is local
+    StatsPublisher(const std::vector<std::pair<uint32_t, bool>>& clients, const std::string& segment_name);
+    ~StatsPublisher();
+
+    StatsPublisher(const StatsPublisher&) = delete;
+    StatsPublisher& operator=(const StatsPublisher&) = delete;
+
+    // Replaces the segment with one for `clients`, under the same name and
+    // with a new start time, so readers attach again. The run statistics and
+    // those of clients in both lists carry over. References from run() and
+    // client() are invalid afterwards; no writer may use them meanwhile.
+    void republish(const std::vector<std::pair<uint32_t, bool>>& clients);
+
+    stats::RunStats& run() { return *run_; }
+    stats::ClientStats& client(size_t index) { return clients_[index]; }
+};
+
+// quicsim-top's side: maps a published segment read-only
+class StatsReader {
+private:
+    boost::interprocess::mapped_region region_;
+    const stats::Header* header_ = nullptr;
+
+public:
+    // False if there is no valid segment named `segment_name`
+    bool open(const std::string& segment_name);
+
+    bool is_open() const { return header_ != nullptr; }
+    const stats::Header& header() const { return *header_; }
+    const stats::RunStats& run() const;
+    const stats::ClientStats& client(size_t index) const;
+};
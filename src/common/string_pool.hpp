@@ -0,0 +1,262 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+// Arena-style string pool placed inside the shared-memory segment.
+//
+// One writer owns the pool. Strings are written once into size-classed
+// blocks and readers refer to them by offset (see
+// SignalVector::string_offsets) until the writer replaces them. A replaced block is retired with the current generation and
+// only handed out again once every reader has entered a later generation, so
+// a reader never observes a block being overwritten underneath it.
+class SharedStringPool {
+public:
+    static constexpr uint32_t kNullOffset = 0xFFFFFFFFu;
+    static constexpr uint32_t kMaxReaders = 64;
+    static constexpr uint32_t kSizeClasses = 16;    // 32 B .. 1 MB blocks
+    static constexpr uint32_t kMinBlockSize = 32;
+
+private:
+    static constexpr uint32_t kMagic = 0x53504F4Cu;  // "SPOL"
+    static constexpr uint64_t kReaderIdle = ~0ull;
+    static constexpr uint64_t kLive = ~0ull;
+
+    struct Block {
+        uint64_t retired;     // generation the block was retired in, kLive while in use
+        uint32_t next;        // link in the free/retired list of its size class
+        uint32_t length;      // string length, excluding the terminator
+        uint32_t size_class;
+        uint32_t reserved;
+        // char data[] follows
+    };
+    static_assert(sizeof(Block) % 8 == 0, "Block header must keep data 8-byte aligned");
+
+    struct BlockList {
+        uint32_t head;
+        uint32_t tail;
+    };
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> generation;
+    };
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t capacity;    // bytes in the block area
+        uint32_t bump;        // first never-used byte of the block area
+        uint32_t reserved;
+        BlockList free_lists[kSizeClasses];
+        BlockList retired_lists[kSizeClasses];
+        alignas(64) std::atomic<uint64_t> generation;
+        ReaderSlot readers[kMaxReaders];
+    };
+
+    Header* header_;
+    char* blocks_;
+
+public:
+    // Bytes of shared memory needed for a pool with `capacity` bytes of blocks
+    static constexpr size_t required_size(uint32_t capacity) {
+        return sizeof(Header) + capacity;
+    }
+
+    // Formats `region` as an empty pool. Only the creator of the segment calls this.
+    static SharedStringPool create(void* region, size_t size) {
+        auto* header = new (region) Header();
+        header->magic = kMagic;
+        header->capacity = static_cast<uint32_t>(size - sizeof(Header));
+        header->bump = 0;
+        for (uint32_t i = 0; i < kSizeClasses; ++i) {
+            header->free_lists[i] = {kNullOffset, kNullOffset};
+            header->retired_lists[i] = {kNullOffset, kNullOffset};
+        }
+        header->generation.store(1, std::memory_order_relaxed);
+        for (auto& reader : header->readers) {
+            reader.generation.store(kReaderIdle, std::memory_order_relaxed);
+        }
+        return SharedStringPool(region);
+    }
+
+    // Attaches to a pool previously formatted with create()
+    explicit SharedStringPool(void* region)
+        : header_(static_cast<Header*>(region))
+        , blocks_(static_cast<char*>(region) + sizeof(Header)) {}
+
+    bool valid() const { return header_ && header_->magic == kMagic; }
+
+    // ---- Reader side -----------------------------------------------------
+
+    // Pins the current generation; offsets read afterwards stay valid until
+    // end_read(). Returns false for a reader id outside the pool's slots.
+    bool begin_read(uint32_t reader) {
+        if (reader >= kMaxReaders) return false;
+        auto& slot = header_->readers[reader].generation;
+        // The writer may publish between the load and the store and reclaim
+        // without seeing this slot, so the pin only counts once it matches
+        uint64_t gen = header_->generation.load(std::memory_order_acquire);
+        for (;;) {
+            slot.store(gen, std::memory_order_seq_cst);
+            const uint64_t current = header_->generation.load(std::memory_order_seq_cst);
+            if (current == gen) return true;
+            gen = current;
+        }
+    }
+
+    void end_read(uint32_t reader) {
+        if (reader >= kMaxReaders) return;
+        header_->readers[reader].generation.store(kReaderIdle, std::memory_order_release);
+    }
+
+    // Zero-copy access to a stored string. Returns an empty view for kNullOffset.
+    std::string_view view(uint32_t offset) const {
+        if (offset == kNullOffset) return {};
+        return std::string_view(blocks_ + offset, block_of(offset)->length);
+    }
+
+    // Null-terminated access, suitable for passing straight to fmi2SetString
+    const char* c_str(uint32_t offset) const {
+        return offset == kNullOffset ? "" : blocks_ + offset;
+    }
+
+    // ---- Writer side -----------------------------------------------------
+
+    // Stores `value` into the slot referenced by `offset`. Unchanged strings
+    // keep their offset and are not copied; changed strings are written to a
+    // fresh block and the old block is retired. Returns false if the pool is
+    // exhausted, in which case `offset` is left untouched.
+    bool assign(uint32_t& offset, std::string_view value) {
+        if (offset != kNullOffset && view(offset) == value) return true;
+
+        uint32_t fresh = allocate(value.size());
+        if (fresh == kNullOffset) return false;
+
+        std::memcpy(blocks_ + fresh, value.data(), value.size());
+        blocks_[fresh + value.size()] = '\0';
+        block_of(fresh)->length = static_cast<uint32_t>(value.size());
+
+        if (offset != kNullOffset) retire(offset);
+        offset = fresh;
+        return true;
+    }
+
+    // Pins `generation` (at most the current one) for `reader` on its behalf,
+    // e.g. for offsets handed to a client that reads them later. Only the
+    // writer calls this, so no reclaim can slip in between.
+    bool hold(uint32_t reader, uint64_t generation) {
+        if (reader >= kMaxReaders) return false;
+        header_->readers[reader].generation.store(generation, std::memory_order_seq_cst);
+        return true;
+    }
+
+    // Drops the string referenced by `offset`
+    void release(uint32_t& offset) {
+        if (offset == kNullOffset) return;
+        retire(offset);
+        offset = kNullOffset;
+    }
+
+    // Ends the current generation. Call after all offsets for a step have been
+    // published; retired blocks older than every active reader become reusable.
+    void publish() {
+        header_->generation.fetch_add(1, std::memory_order_acq_rel);
+        reclaim();
+    }
+
+    uint64_t generation() const {
+        return header_->generation.load(std::memory_order_acquire);
+    }
+
+private:
+    Block* block_of(uint32_t data_offset) const {
+        return reinterpret_cast<Block*>(blocks_ + data_offset - sizeof(Block));
+    }
+
+    Block* block_at(uint32_t block_offset) const {
+        return reinterpret_cast<Block*>(blocks_ + block_offset);
+    }
+
+    static uint32_t size_class_for(size_t length) {
+        const size_t needed = sizeof(Block) + length + 1;
+        uint32_t cls = 0;
+        size_t size = kMinBlockSize;
+        while (size < needed && cls < kSizeClasses) {
+            size <<= 1;
+            ++cls;
+        }
+        return cls;
+    }
+
+    uint32_t allocate(size_t length) {
+        const uint32_t cls = size_class_for(length);
+        if (cls >= kSizeClasses) return kNullOffset;
+
+        auto& free_list = header_->free_lists[cls];
+        if (free_list.head == kNullOffset) {
+            reclaim();
+        }
+
+        uint32_t block_offset;
+        if (free_list.head != kNullOffset) {
+            block_offset = free_list.head;
+            free_list.head = block_at(block_offset)->next;
+            if (free_list.head == kNullOffset) free_list.tail = kNullOffset;
+        } else {
+            const uint32_t size = kMinBlockSize << cls;
+            if (header_->capacity - header_->bump < size) return kNullOffset;
+            block_offset = header_->bump;
+            header_->bump += size;
+        }
+
+        Block* block = block_at(block_offset);
+        block->retired = kLive;
+        block->next = kNullOffset;
+        block->length = 0;
+        block->size_class = cls;
+        return block_offset + static_cast<uint32_t>(sizeof(Block));
+    }
+
+    void retire(uint32_t data_offset) {
+        const uint32_t block_offset = data_offset - static_cast<uint32_t>(sizeof(Block));
+        Block* block = block_at(block_offset);
+        block->retired = header_->generation.load(std::memory_order_relaxed);
+        append(header_->retired_lists[block->size_class], block_offset);
+    }
+
+    void append(BlockList& list, uint32_t block_offset) {
+        block_at(block_offset)->next = kNullOffset;
+        if (list.tail == kNullOffset) {
+            list.head = block_offset;
+        } else {
+            block_at(list.tail)->next = block_offset;
+        }
+        list.tail = block_offset;
+    }
+
+    uint64_t oldest_reader_generation() const {
+        uint64_t oldest = header_->generation.load(std::memory_order_acquire);
+        for (const auto& reader : header_->readers) {
+            const uint64_t gen = reader.generation.load(std::memory_order_acquire);
+            if (gen < oldest) oldest = gen;
+        }
+        return oldest;
+    }
+
+    // Retired lists are ordered by generation, so each one is drained from
+    // the front until it reaches a block some reader may still see.
+    void reclaim() {
+        const uint64_t oldest = oldest_reader_generation();
+        for (uint32_t cls = 0; cls < kSizeClasses; ++cls) {
+            auto& retired = header_->retired_lists[cls];
+            while (retired.head != kNullOffset && block_at(retired.head)->retired < oldest) {
+                const uint32_t block_offset = retired.head;
+                retired.head = block_at(block_offset)->next;
+                if (retired.head == kNullOffset) retired.tail = kNullOffset;
+                append(header_->free_lists[cls], block_offset);
+            }
+        }
+    }
+};
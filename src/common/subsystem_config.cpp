@@ -0,0 +1,98 @@
+#include "subsystem_config.hpp"
+#include <stdexcept>
+
+namespace {
+
+SubsystemConfig::Endpoint parse_endpoint(const std::vector<SubsystemConfig::Member>& members,
+                                         const std::string& member, const std::string& variable) {
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (members[i].name == member) return {i, variable};
+    }
+    throw std::runtime_error("Unknown sub-system member '" + member + "'");
+}
+
+// Splits "member.variable" at the first dot; variable names may contain dots
+SubsystemConfig::Endpoint parse_qualified(const std::vector<SubsystemConfig::Member>& members,
+                                          const std::string& qualified) {
+    auto dot = qualified.find('.');
+    if (dot == std::string::npos) {
+        throw std::runtime_error("Boundary variable '" + qualified + "' is not of the form member.variable");
+    }
+    return parse_endpoint(members, qualified.substr(0, dot), qualified.substr(dot + 1));
+}
+
+}  // namespace
+
+SubsystemConfig SubsystemConfig::parse(const YAML::Node& node) {
+    SubsystemConfig config;
+    config.step_size = node["step_size"].as<double>(config.step_size);
+
+    for (const auto& member : node["members"]) {
+        config.members.push_back({
+            member["name"].as<std::string>(),
+            member["fmu_path"].as<std::string>()
+        });
+    }
+
+    for (const auto& conn : node["connections"]) {
+        config.connections.push_back({
+            parse_endpoint(config.members, conn["from"]["member"].as<std::string>(),
+                           conn["from"]["variable"].as<std::string>()),
+            parse_endpoint(config.members, conn["to"]["member"].as<std::string>(),
+                           conn["to"]["variable"].as<std::string>())
+        });
+    }
+
+    for (const auto& port : node["boundary"]) {
+        config.boundary.push_back(parse_qualified(config.members, port.as<std::string>()));
+    }
+
+    return config;
+}
+
+const cosim::variable_description& SubsystemConfig::find_variable(
+    const cosim::model_description& model, const std::string& name) {
+    for (const auto& var : model.variables) {
+        if (var.name == name) return var;
+    }
+    throw std::runtime_error("Model '" + model.name + "' has no variable '" + name + "'");
+}
+
+std::vector<SubsystemConfig::Port> SubsystemConfig::resolve_ports(
+    const std::vector<std::shared_ptr<const cosim::model_description>>& models) const {
+    std::vector<Port> ports;
+    ports.reserve(boundary.size());
+
+    for (const auto& endpoint : boundary) {
+        const auto& var = find_variable(*models[endpoint.member], endpoint.variable);
+        bool is_input = var.causality == cosim::variable_causality::input;
+        if (!is_input && var.causality != cosim::variable_causality::output) {
+            throw std::runtime_error("Boundary variable '" + endpoint.variable + "' is neither input nor output");
+        }
+        // An input already fed inside the group cannot also be driven from outside
+        for (const auto& conn : connections) {
+            if (is_input && conn.to.member == endpoint.member && conn.to.variable == endpoint.variable) {
+                throw std::runtime_error("Boundary input '" + endpoint.variable + "' is connected internally");
+            }
+        }
+        ports.push_back({endpoint.member, var});
+    }
+
+    return ports;
+}
+
+std::shared_ptr<const cosim::model_description> SubsystemConfig::boundary_description(
+    const std::vector<Port>& ports) const {
+    auto description = std::make_shared<cosim::model_description>();
+    description->name = "subsystem";
+    description->variables.reserve(ports.size());
+
+    for (size_t i = 0; i < ports.size(); ++i) {
+        cosim::variable_description var = ports[i].variable;
+        var.name = members[ports[i].member].name + "." + var.name;
+        var.reference = static_cast<cosim::value_reference>(i);
+        description->variables.push_back(std::move(var));
+    }
+
+    return description;
+}
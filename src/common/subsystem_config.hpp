@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cosim/model_description.hpp>
+#include <yaml-cpp/yaml.h>
+
+// A group of tightly coupled FMUs that one client steps in-process with
+// libcosim, read from the `subsystem:` node of a client. Only the boundary
+// variables are visible to the server. Boundary variable i has value
+// reference i and is named "<member>.<variable>".
+struct SubsystemConfig {
+    struct Member {
+        std::string name;
+        std::string fmu_path;
+    };
+
+    struct Endpoint {
+        size_t member;
+        std::string variable;
+    };
+
+    struct Connection {
+        Endpoint from;
+        Endpoint to;
+    };
+
+    // Boundary variable resolved against its member's model description
+    struct Port {
+        size_t member;
+        cosim::variable_description variable;
+    };
+
+    double step_size = 0.001;  // internal step in seconds
+    std::vector<Member> members;
+    std::vector<Connection> connections;
+    std::vector<Endpoint> boundary;
+
+    // Throws on unknown member names
+    static SubsystemConfig parse(const YAML::Node& node);
+
+    // Looks up a variable by name; throws if the model has none
+    static const cosim::variable_description& find_variable(
+        const cosim::model_description& model, const std::string& name);
+
+    // Resolves the boundary with the members' model descriptions, in member order.
+    // Throws if a boundary variable is missing or is an internally connected input.
+    std::vector<Port> resolve_ports(
+        const std::vector<std::shared_ptr<const cosim::model_description>>& models) const;
+
+    // Model description of the boundary, as the server and the host see it
+    std::shared_ptr<const cosim::model_description> boundary_description(const std::vector<Port>& ports) const;
+};
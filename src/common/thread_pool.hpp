@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "async_log.hpp"
+
+// Work-stealing pool of worker threads. Every worker owns a task queue:
+// it pops its own work newest-first and, when that runs dry, steals the
+// oldest work of the other workers. Tasks submitted from outside the pool
+// are spread round-robin over the queues.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    // Growable ring of tasks guarded by its own lock. Capacity only grows,
+    // so a warmed-up queue does not allocate.
+    struct alignas(64) TaskQueue {
+        std::mutex mutex;
+        std::vector<Task> ring;
+        size_t head = 0;
+        size_t count = 0;
+
+        void push(Task&& task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count == ring.size()) grow();
+            ring[(head + count) & (ring.size() - 1)] = std::move(task);
+            ++count;
+        }
+
+        bool pop_back(Task& task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count == 0) return false;
+            --count;
+            task = std::move(ring[(head + count) & (ring.size() - 1)]);
+            return true;
+        }
+
+        bool pop_front(Task& task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count == 0) return false;
+            task = std::move(ring[head]);
+            head = (head + 1) & (ring.size() - 1);
+            --count;
+            return true;
+        }
+
+        void grow() {
+            std::vector<Task> bigger(std::max<size_t>(16, ring.size() * 2));
+            for (size_t i = 0; i < count; ++i) {
+                bigger[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+            }
+            ring.swap(bigger);
+            head = 0;
+        }
+    };
+
+    // State of one parallel_for, shared by its tasks
+    struct Loop {
+        const std::function<void(size_t)>* fn;
+        std::atomic<size_t> remaining;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        void run(size_t i) {
+            try {
+                (*fn)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_queue_{0};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_cv_;
+    bool stop_ = false;
+
+    static inline thread_local const ThreadPool* current_pool_ = nullptr;
+    static inline thread_local size_t current_index_ = 0;
+
+    // Own queue first, then steal round the others starting at the next worker
+    bool find_task(size_t home, Task& task) {
+        if (queues_[home]->pop_back(task)) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            if (queues_[(home + i) % queues_.size()]->pop_front(task)) {
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void run_task(Task& task) {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            async_log(LogCategory::Step, "Unhandled exception in pool task: {}", e.what());
+        }
+        task = nullptr;
+    }
+
+    void worker_loop(size_t index) {
+        current_pool_ = this;
+        current_index_ = index;
+
+        Task task;
+        for (;;) {
+            if (find_task(index, task)) {
+                run_task(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_cv_.wait(lock, [this] {
+                return stop_ || queued_.load(std::memory_order_relaxed) > 0;
+            });
+            if (stop_ && queued_.load(std::memory_order_relaxed) == 0) return;
+        }
+    }
+
+public:
+    // `threads` workers; 0 sizes the pool to the cores, keeping one for the caller
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) {
+            unsigned hw = std::thread::hardware_concurrency();
+            threads = hw > 1 ? hw - 1 : 1;
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            queues_.push_back(std::make_unique<TaskQueue>());
+        }
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // Queues `task` for asynchronous execution. Workers push onto their own
+    // queue, other threads spread tasks over all queues.
+    void submit(Task task) {
+        size_t queue = (current_pool_ == this)
+            ? current_index_
+            : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        // Counted before it is visible, so a thief's decrement never takes the count below zero
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        queues_[queue]->push(std::move(task));
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        wake_cv_.notify_one();
+    }
+
+    // Runs fn(i) for every i in [0, count) and returns once all calls are
+    // done. The calling thread works through queued tasks while it waits.
+    // The first exception thrown by fn is rethrown here.
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        if (count == 1) {
+            fn(0);
+            return;
+        }
+
+        Loop loop;
+        loop.fn = &fn;
+        loop.remaining.store(count, std::memory_order_relaxed);
+
+        for (size_t i = 1; i < count; ++i) {
+            submit([l = &loop, i] { l->run(i); });
+        }
+        loop.run(0);
+
+        size_t home = (current_pool_ == this) ? current_index_ : 0;
+        Task task;
+        while (loop.remaining.load(std::memory_order_acquire) > 0) {
+            if (find_task(home, task)) {
+                run_task(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        if (loop.error) std::rethrow_exception(loop.error);
+    }
+};
@@ -0,0 +1,212 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kDefaultSpans = size_t{1} << 16;
+
+// Ring of one thread's spans. The owner announces a slot in `reserved`
+// before writing it and publishes it in `head`; a reader that copied a slot
+// the owner was overwriting meanwhile sees that in `reserved` and drops it.
+struct TraceRing {
+    struct Slot {
+        std::atomic<uint64_t> ids{0};  // track << 32 | name
+        std::atomic<int64_t> begin_ns{0};
+        std::atomic<int64_t> end_ns{0};
+    };
+
+    size_t capacity;  // power of two
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint64_t> reserved{0};
+    std::atomic<uint64_t> head{0};
+    alignas(64) uint64_t taken = 0;  // guarded by the registry mutex
+
+    explicit TraceRing(size_t spans)
+        : capacity(spans)
+        , slots(std::make_unique<Slot[]>(spans)) {}
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::string process;  // Empty: the server names it after the client
+    std::atomic<size_t> spans_per_thread{kDefaultSpans};
+    std::atomic<int64_t> clock_offset_ns{0};
+};
+
+// Never destroyed, as threads may record during static destruction
+Registry& registry() {
+    static auto* instance = new Registry();
+    return *instance;
+}
+
+size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+TraceRing& thread_ring() {
+    thread_local std::shared_ptr<TraceRing> ring = [] {
+        auto& reg = registry();
+        auto created = std::make_shared<TraceRing>(round_up_pow2(reg.spans_per_thread.load()));
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(created);
+        return created;
+    }();
+    return *ring;
+}
+
+void write_escaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+        else out << c;
+    }
+}
+
+}  // namespace
+
+void trace_detail::record(uint32_t track, uint32_t name, int64_t begin_ns, int64_t end_ns) {
+    auto& ring = thread_ring();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.reserved.store(head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& slot = ring.slots[head & (ring.capacity - 1)];
+    slot.ids.store(uint64_t{track} << 32 | name, std::memory_order_relaxed);
+    slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void set_tracing(bool enabled, size_t spans_per_thread) {
+    if (spans_per_thread != 0) registry().spans_per_thread.store(spans_per_thread);
+    trace_detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint32_t trace_name(const std::string& name) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto it = reg.ids.find(name);
+    if (it != reg.ids.end()) return it->second;
+    auto id = static_cast<uint32_t>(reg.names.size());
+    reg.names.push_back(name);
+    reg.ids.emplace(name, id);
+    return id;
+}
+
+void set_trace_process(const std::string& name) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.process = name;
+}
+
+std::string trace_process() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.process;
+}
+
+void set_trace_clock_offset(int64_t offset_ns) {
+    registry().clock_offset_ns.store(offset_ns, std::memory_order_relaxed);
+}
+
+TraceSnapshot take_trace() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    int64_t offset = reg.clock_offset_ns.load(std::memory_order_relaxed);
+
+    TraceSnapshot snapshot;
+    snapshot.names = reg.names;
+    for (const auto& ring : reg.rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = std::max(ring->taken, head > ring->capacity ? head - ring->capacity : 0);
+        size_t copied = snapshot.spans.size();
+        for (uint64_t i = first; i < head; ++i) {
+            const auto& slot = ring->slots[i & (ring->capacity - 1)];
+            uint64_t ids = slot.ids.load(std::memory_order_relaxed);
+            snapshot.spans.push_back({static_cast<uint32_t>(ids >> 32), static_cast<uint32_t>(ids),
+                                      slot.begin_ns.load(std::memory_order_relaxed) + offset,
+                                      slot.end_ns.load(std::memory_order_relaxed) + offset});
+        }
+
+        // Slots the owner started overwriting while they were copied are dropped
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t reserved = ring->reserved.load(std::memory_order_relaxed);
+        uint64_t valid = reserved > ring->capacity ? reserved - ring->capacity : 0;
+        if (valid > first) {
+            size_t torn = static_cast<size_t>(std::min(valid, head) - first);
+            snapshot.spans.erase(snapshot.spans.begin() + copied, snapshot.spans.begin() + copied + torn);
+        }
+        ring->taken = head;
+    }
+    return snapshot;
+}
+
+bool write_chrome_trace(const std::string& path, const std::vector<ProcessTrace>& processes) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write trace file " << path << std::endl;
+        return false;
+    }
+
+    // Timestamps start at the earliest span, in microseconds with nanosecond digits
+    int64_t origin = std::numeric_limits<int64_t>::max();
+    for (const auto& process : processes) {
+        for (const auto& span : process.trace.spans) origin = std::min(origin, span.begin_ns);
+    }
+    auto us = [](int64_t ns) { return static_cast<double>(ns) / 1000.0; };
+
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&out, &first] {
+        if (!first) out << ",";
+        out << "\n";
+        first = false;
+    };
+
+    for (size_t pid = 0; pid < processes.size(); ++pid) {
+        const auto& process = processes[pid];
+        const auto& names = process.trace.names;
+        auto name_of = [&names](uint32_t id) { return id < names.size() ? names[id] : std::to_string(id); };
+
+        separator();
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"";
+        write_escaped(out, process.process);
+        out << "\"}}";
+
+        // One thread per track, named once
+        std::vector<uint32_t> tracks;
+        for (const auto& span : process.trace.spans) tracks.push_back(span.track);
+        std::sort(tracks.begin(), tracks.end());
+        tracks.erase(std::unique(tracks.begin(), tracks.end()), tracks.end());
+        for (uint32_t track : tracks) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << track
+                << ",\"args\":{\"name\":\"";
+            write_escaped(out, name_of(track));
+            out << "\"}}";
+        }
+
+        for (const auto& span : process.trace.spans) {
+            separator();
+            out << "{\"name\":\"";
+            write_escaped(out, name_of(span.name));
+            out << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << span.track
+                << ",\"ts\":" << us(span.begin_ns - origin)
+                << ",\"dur\":" << us(std::max<int64_t>(0, span.end_ns - span.begin_ns)) << "}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Opt-in timeline of the step path, exported as a Chrome trace. Spans go
+// into a ring of the recording thread; a full ring overwrites its oldest
+// spans, so it keeps the end of the run. Clients shift their spans to the
+// server's clock by the offset estimated during the Hello/Welcome handshake
+// before handing them over.
+
+// One span as recorded and sent. `track` and `name` index the name table.
+struct TraceSpanRecord {
+    uint32_t track;
+    uint32_t name;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+// Spans taken out of the rings, with the name table they refer to
+struct TraceSnapshot {
+    std::vector<std::string> names;
+    std::vector<TraceSpanRecord> spans;
+};
+
+// The spans of one process on the merged timeline
+struct ProcessTrace {
+    std::string process;
+    TraceSnapshot trace;
+};
+
+namespace trace_detail {
+
+inline std::atomic<bool> enabled{false};
+
+void record(uint32_t track, uint32_t name, int64_t begin_ns, int64_t end_ns);
+
+}  // namespace trace_detail
+
+inline bool tracing_enabled() { return trace_detail::enabled.load(std::memory_order_relaxed); }
+
+// Steady clock reading in nanoseconds, the time base of all spans
+inline int64_t trace_clock_ns(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+inline int64_t trace_clock_now() { return trace_clock_ns(std::chrono::steady_clock::now()); }
+
+// Turns recording on or off. `spans_per_thread`, if not 0, sizes the rings
+// of threads that record their first span afterwards.
+void set_tracing(bool enabled, size_t spans_per_thread = 0);
+
+// Id of `name` in this process's name table; used for tracks and span names
+uint32_t trace_name(const std::string& name);
+
+// Name of this process on the merged timeline; unnamed clients are named by the server
+void set_trace_process(const std::string& name);
+std::string trace_process();
+
+// Server clock minus local clock, added to every span when it is taken
+void set_trace_clock_offset(int64_t offset_ns);
+
+inline void trace_span(uint32_t track, uint32_t name,
+                       std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    if (tracing_enabled()) trace_detail::record(track, name, trace_clock_ns(begin), trace_clock_ns(end));
+}
+
+// Removes the spans recorded so far from the rings of every thread
+TraceSnapshot take_trace();
+
+// Writes the processes as one Chrome trace JSON file, which Perfetto also
+// opens: a process per entry and a thread per track
+bool write_chrome_trace(const std::string& path, const std::vector<ProcessTrace>& processes);
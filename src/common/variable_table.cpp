@@ -0,0 +1,33 @@
+#include "variable_table.hpp"
+#include <set>
+
+std::vector<SignalVariable> signal_variables(const cosim::model_description& model,
+                                             const std::vector<BinaryVariable>& binaries) {
+    std::vector<SignalVariable> variables;
+    variables.reserve(model.variables.size());
+    std::set<cosim::value_reference> components;
+    for (const auto& binary : binaries) {
+        components.insert({binary.lo, binary.hi, binary.size});
+        variables.push_back({binary.name, static_cast<uint32_t>(binary.lo), SimProtocol::ValueType_Binary,
+                             static_cast<SimProtocol::Causality>(binary.causality)});
+    }
+    for (const auto& var : model.variables) {
+        if (var.type == cosim::variable_type::integer && components.count(var.reference)) continue;
+        variables.push_back({var.name, static_cast<uint32_t>(var.reference), value_type(var.type),
+                             static_cast<SimProtocol::Causality>(var.causality)});
+    }
+    return variables;
+}
+
+std::vector<SignalVariable> signal_variables(const cosim::model_description& model) {
+    return signal_variables(model, binary_variables(model));
+}
+
+SimProtocol::ValueType value_type(cosim::variable_type type) {
+    switch (type) {
+        case cosim::variable_type::real: return SimProtocol::ValueType_Real;
+        case cosim::variable_type::boolean: return SimProtocol::ValueType_Boolean;
+        case cosim::variable_type::string: return SimProtocol::ValueType_String;
+        default: return SimProtocol::ValueType_Integer;  // integer and enumeration
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cosim/model_description.hpp>
+#include "simulation_protocol_generated.h"
+#include "osmp.hpp"
+
+// A variable as the wire protocol addresses it
+struct SignalVariable {
+    std::string name;
+    uint32_t reference;
+    SimProtocol::ValueType type;
+    SimProtocol::Causality causality;
+
+    bool is_output() const { return causality == SimProtocol::Causality_Output; }
+    bool is_input() const { return causality == SimProtocol::Causality_Input; }
+};
+
+// Variables of `model` with `binaries` standing in for their integer
+// components: the binary variables first, then the others in model order.
+// Client and server both derive their tables this way, so they agree.
+std::vector<SignalVariable> signal_variables(const cosim::model_description& model,
+                                             const std::vector<BinaryVariable>& binaries);
+
+// As above, with the binary variables found by their OSMP names
+std::vector<SignalVariable> signal_variables(const cosim::model_description& model);
+
+// Protocol type of an FMI variable type
+SimProtocol::ValueType value_type(cosim::variable_type type);
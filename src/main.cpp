@@ -1,12 +1,17 @@
 #include "quicserver/server.hpp"
+#include "quicserver/local_runner.hpp"
+#include "quicserver/plan_compiler.hpp"
 #include "quicclient/client.hpp"
+#include "common/latency.hpp"
+#include "common/signals.hpp"
 #include <iostream>
 #include <thread>
 #include <chrono>
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " [server|client] [config_path]" << std::endl;
+        std::cout << "Usage: " << argv[0] << " [server|client|local] [config_path]" << std::endl;
+        std::cout << "       " << argv[0] << " compile <config.yaml> <run_plan.qplan>" << std::endl;
         return 1;
     }
     
@@ -20,19 +25,59 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        // Simple simulation loop
+        // Simple simulation loop; SIGUSR1 prints the step latencies, SIGHUP reloads
+        // the clients and connections, SIGINT ends the run
         uint64_t current_time_us = 0;
         const uint64_t step_size_us = 1000;  // 1ms steps
-        
-        while (true) {
+        watch_signals();
+
+        while (!stop_requested()) {
             if (!server.step(step_size_us)) {
                 std::cerr << "Simulation step failed" << std::endl;
                 break;
             }
             current_time_us += step_size_us;
+            if (take_report_request()) report_latencies();
+            if (take_reload_request()) server.reconfigure();
             std::this_thread::sleep_for(std::chrono::microseconds(step_size_us));
         }
+        report_latencies();
+        server.write_trace();
         
+    } else if (mode == "compile") {
+        // Resolves the configuration once; server, local and client hosts load the plan instead
+        if (argc < 4) {
+            std::cerr << "Missing run plan path" << std::endl;
+            return 1;
+        }
+        try {
+            compile_run_plan(config_path, argv[3]);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+
+    } else if (mode == "local") {
+        // All FMUs in this process, stepped as fast as they go
+        LocalRunner runner(config_path);
+        if (!runner.init()) {
+            std::cerr << "Failed to initialize local simulation" << std::endl;
+            return 1;
+        }
+
+        // Runs until `server.end_time` or SIGINT; SIGUSR1 prints the step latencies
+        const uint64_t step_size_us = 1000;  // 1ms steps
+        watch_signals();
+        while (!stop_requested() && !runner.finished()) {
+            if (!runner.step(step_size_us)) {
+                std::cerr << "Simulation step failed" << std::endl;
+                report_latencies();
+                return 1;
+            }
+            if (take_report_request()) report_latencies();
+        }
+        report_latencies();
+
     } else if (mode == "client") {
         QuicClient client("/path/to/fmu.fmu");  // Get from config
         if (!client.init()) {
@@ -40,11 +85,13 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        // Client main loop
-        while (true) {
-            // Wait for and handle requests
+        // Client main loop; the step thread serves the requests
+        watch_signals();
+        while (!stop_requested()) {
+            if (take_report_request()) report_latencies();
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
+        report_latencies();
     }
     
     return 0;
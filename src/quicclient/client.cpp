@@ -1,68 +1,332 @@
 #include "client.hpp"
-#include <iostream>
 #include <algorithm>
-#include <flatbuffers/flatbuffers.h>
-#include <cosim/fmi/importer.hpp>
-#include <cosim/algorithm.hpp>
-#include <cosim/time.hpp>
-
-QuicClient::QuicClient(const std::string& fmu_path) 
-    : send_buffer_(1024 * 1024)  // 1MB pre-allocated buffer
-    , receive_buffer_(1024 * 1024) {
-    
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <yaml-cpp/yaml.h>
+#include "common/async_log.hpp"
+#include "common/cpu_affinity.hpp"
+#include "common/fmu_cache.hpp"
+#include "common/phase_timer.hpp"
+#include "common/run_plan.hpp"
+#include "common/subsystem_config.hpp"
+#include "subsystem.hpp"
+
+QuicClient::QuicClient(const std::string& fmu_path, int step_cpu)
+    : step_cpu_(step_cpu) {
+
+    PhaseTimer timer;
     try {
-        // Create FMI importer and load FMU
-        auto importer = cosim::fmi::importer::create();
-        fmu_ = importer->import(cosim::filesystem::path(fmu_path));
-        
-        // Create slave instance
-        slave_ = fmu_->instantiate_slave("instance1");
-
-        // Setup slave with start time and optional stop time
-        slave_->setup(
-            cosim::to_time_point(0.0),  // start time
-            cosim::to_time_point(1.0),  // stop time (optional)
-            std::nullopt              // relative tolerance (optional)
-        );
-
-        // Cache variable information from model description
-        auto model_desc = fmu_->model_description();
-        for (const auto& var : model_desc->variables) {
-            if (var.causality == cosim::variable_causality::input ||
-                var.causality == cosim::variable_causality::output) {
-                VariableCache cache{
-                    static_cast<uint32_t>(var.reference),
-                    var.causality == cosim::variable_causality::output
-                };
-                variable_cache_.push_back(cache);
-            }
+        FmuCache cache;
+        cache.unpacked(fmu_path);
+        timer.mark("unpack");
+
+        auto fmu = cache.import(fmu_path);
+        timer.mark("import");
+
+        auto instance = std::make_unique<FmuInstance>(0, std::make_unique<SlaveUnit>(fmu, "instance0"));
+        timer.mark("instantiate");
+        if (instance->loaded()) {
+            instances_.push_back(std::move(instance));
         }
+        timer.report("Client");
 
     } catch (const std::exception& e) {
         std::cerr << "Failed to load FMU: " << e.what() << std::endl;
     }
+    ready_.reserve(1);
+}
+
+QuicClient::QuicClient(const std::string& config_path, const std::string& host_name) {
+    PhaseTimer timer;
+    try {
+        // A compiled run plan carries the configuration; its FMUs are checked once unpacked
+        std::unique_ptr<RunPlan> plan;
+        YAML::Node config;
+        if (RunPlan::is_plan(config_path)) {
+            plan = std::make_unique<RunPlan>(config_path);
+            config = plan->settings();
+        } else {
+            config = YAML::LoadFile(config_path);
+        }
+
+        YAML::Node host;
+        for (const auto& entry : config["hosts"]) {
+            if (entry["name"].as<std::string>() == host_name) {
+                host.reset(entry);
+                break;
+            }
+        }
+        if (!host) {
+            std::cerr << "No host '" << host_name << "' in " << config_path << std::endl;
+            return;
+        }
+
+        server_host_ = host["server"].as<std::string>(server_host_);
+        server_port_ = host["port"].as<uint16_t>(server_port_);
+        step_cpu_ = host["step_cpu"].as<int>(step_cpu_);
+
+        // Hosted client ids and their FMUs; a sub-system client lists one FMU per member
+        struct Spec {
+            uint32_t client_id;
+            std::vector<std::string> fmu_paths;
+            std::optional<SubsystemConfig> subsystem;
+        };
+        std::vector<Spec> specs;
+        std::vector<std::string> fmu_paths;
+        for (const auto& id_node : host["instances"]) {
+            Spec spec{id_node.as<uint32_t>(), {}, std::nullopt};
+            for (const auto& client : config["clients"]) {
+                if (client["id"].as<uint32_t>() != spec.client_id) continue;
+                if (client["subsystem"]) {
+                    spec.subsystem = SubsystemConfig::parse(client["subsystem"]);
+                    for (const auto& member : spec.subsystem->members) spec.fmu_paths.push_back(member.fmu_path);
+                } else {
+                    spec.fmu_paths.push_back(client["fmu_path"].as<std::string>());
+                }
+                break;
+            }
+            if (spec.fmu_paths.empty()) {
+                std::cerr << "No FMU configured for client " << spec.client_id << std::endl;
+                continue;
+            }
+            for (const auto& path : spec.fmu_paths) {
+                if (std::find(fmu_paths.begin(), fmu_paths.end(), path) == fmu_paths.end()) {
+                    fmu_paths.push_back(path);
+                }
+            }
+            specs.push_back(std::move(spec));
+        }
+
+        // The pool steps the instances and, before that, loads them in parallel
+        if (specs.size() > 1) {
+            pool_ = std::make_unique<ThreadPool>(host["worker_threads"].as<size_t>(0));
+        }
+        auto for_each = [this](size_t count, const std::function<void(size_t)>& fn) {
+            if (pool_) {
+                pool_->parallel_for(count, fn);
+            } else {
+                for (size_t i = 0; i < count; ++i) fn(i);
+            }
+        };
+
+        FmuCache cache(config["fmu_cache"].as<std::string>(""));
+        timer.mark("config");
+
+        // Each distinct FMU is unpacked once
+        for_each(fmu_paths.size(), [&](size_t i) {
+            try {
+                cache.unpacked(fmu_paths[i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to unpack " << fmu_paths[i] << ": " << e.what() << std::endl;
+            }
+        });
+        if (plan) {
+            for (const auto& path : fmu_paths) plan->check_fmu(path, cache.hash(path));
+        }
+        timer.mark("unpack");
+
+        // Every instance gets its own import, so instantiation shares no state
+        std::vector<std::vector<std::shared_ptr<cosim::fmi::fmu>>> fmus(specs.size());
+        for_each(specs.size(), [&](size_t i) {
+            try {
+                for (const auto& path : specs[i].fmu_paths) fmus[i].push_back(cache.import(path));
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to load FMUs of client " << specs[i].client_id << ": " << e.what() << std::endl;
+                fmus[i].clear();
+            }
+        });
+        timer.mark("import");
+
+        std::vector<std::unique_ptr<FmuInstance>> loaded(specs.size());
+        for_each(specs.size(), [&](size_t i) {
+            if (fmus[i].empty()) return;
+            const auto& spec = specs[i];
+            std::string name = "client_" + std::to_string(spec.client_id);
+            try {
+                std::unique_ptr<SimulationUnit> unit;
+                if (spec.subsystem) {
+                    unit = std::make_unique<Subsystem>(*spec.subsystem, fmus[i], name);
+                } else {
+                    unit = std::make_unique<SlaveUnit>(fmus[i].front(), name);
+                }
+                loaded[i] = std::make_unique<FmuInstance>(spec.client_id, std::move(unit));
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to instantiate client " << spec.client_id << ": " << e.what() << std::endl;
+            }
+        });
+        for (auto& instance : loaded) {
+            if (instance && instance->loaded()) instances_.push_back(std::move(instance));
+        }
+        timer.mark("instantiate");
+
+        // A lone instance is stepped on the step thread itself
+        if (instances_.size() <= 1) {
+            pool_.reset();
+        }
+        ready_.reserve(instances_.size());
+        set_trace_process("host " + host_name);
+        timer.report("Host " + host_name);
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading host configuration: " << e.what() << std::endl;
+    }
+}
+
+QuicClient::~QuicClient() {
+    if (step_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            running_.store(false);
+        }
+        wake_cv_.notify_one();
+        step_thread_.join();
+    }
+}
+
+FmuInstance* QuicClient::find_instance(uint32_t instance_id) {
+    if (instances_.size() == 1) return instances_.front().get();
+    for (auto& instance : instances_) {
+        if (instance->id() == instance_id) return instance.get();
+    }
+    return nullptr;
+}
+
+void QuicClient::handle_message(const uint8_t* data, size_t len) {
+    auto msg = flatbuffers::GetRoot<SimProtocol::Message>(data);
+    if (const auto* compressed = msg->message_type_as_CompressedMessage()) {
+        if (!decompress_message(compressed, inflated_)) {
+            async_log(LogCategory::Protocol, "Dropping corrupt compressed message");
+            return;
+        }
+        dispatch(inflated_.data(), inflated_.size());
+    } else {
+        dispatch(data, len);
+    }
+}
+
+void QuicClient::dispatch(const uint8_t* data, size_t len) {
+    auto msg = flatbuffers::GetRoot<SimProtocol::Message>(data);
+    if (const auto* welcome = msg->message_type_as_Welcome()) {
+        apply_welcome_trace(welcome, trace_clock_now());
+        // Requests arrive in the agreed version and are answered in kind; only compression needs setting up
+        uint32_t threshold = has_feature(welcome->features(), SimProtocol::Feature_Compression)
+            ? welcome->compression_threshold() : 0;
+        for (auto& instance : instances_) instance->set_compression_threshold(threshold);
+        if (has_feature(welcome->features(), SimProtocol::Feature_SlotMap)) send_variable_tables();
+        return;
+    }
+    if (const auto* chunk = msg->message_type_as_BlobChunk()) {
+        assembler_.add(chunk);
+        return;
+    }
+    if (const auto* request = msg->message_type_as_TraceRequest()) {
+        send_trace(request->instance_id());
+        return;
+    }
+
+    // Slot maps go through the mailbox too, so they take effect before the requests relying on them
+    const auto* map = msg->message_type_as_SlotMap();
+    if (!map && !is_step_request(msg)) return;
+
+    uint32_t instance_id = map ? map->instance_id() : request_instance_id(msg);
+    FmuInstance* instance = find_instance(instance_id);
+    if (!instance) {
+        async_log(LogCategory::Protocol, "Message for unknown instance {}", instance_id);
+        return;
+    }
+
+    // Hand the request to the step thread; the receive buffer is only valid during this callback
+    if (!instance->post(data, len)) return;
+
+    // Pairs with the fence in step_loop(): either the step thread sees the
+    // request before sleeping, or this thread sees it asleep and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (step_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+}
+
+void QuicClient::send_trace(uint32_t instance_id) {
+    // The first request takes every span of the process; later ones find the rings empty
+    constexpr size_t kSpansPerMessage = 1024;
+    TraceSnapshot trace = take_trace();
+    std::string process = trace_process();
+
+    // send() copies each message, so one builder serves them all
+    flatbuffers::FlatBufferBuilder builder;
+    size_t sent = 0;
+    do {
+        size_t count = std::min(kSpansPerMessage, trace.spans.size() - sent);
+        builder.Clear();
+        build_trace_data(builder, instance_id, process, trace, sent, count, sent + count == trace.spans.size());
+        if (!quic_connection_->send(builder.GetBufferPointer(), builder.GetSize())) {
+            async_log(LogCategory::Protocol, "Failed to send trace of instance {}", instance_id);
+            return;
+        }
+        sent += count;
+    } while (sent < trace.spans.size());
+}
+
+void QuicClient::send_variable_tables() {
+    constexpr size_t kVariablesPerMessage = 512;
+
+    // send() copies each message, so one builder serves them all
+    flatbuffers::FlatBufferBuilder builder;
+    for (const auto& instance : instances_) {
+        const auto& variables = instance->variable_table();
+        size_t sent = 0;
+        do {
+            size_t count = std::min(kVariablesPerMessage, variables.size() - sent);
+            builder.Clear();
+            build_variable_table(builder, instance->id(), variables, sent, count, sent + count == variables.size());
+            if (!quic_connection_->send(builder.GetBufferPointer(), builder.GetSize())) {
+                async_log(LogCategory::Protocol, "Failed to send variable table of instance {}", instance->id());
+                return;
+            }
+            sent += count;
+        } while (sent < variables.size());
+    }
 }
 
 bool QuicClient::init() {
-    if (!slave_) {
+    if (instances_.empty()) {
         std::cerr << "FMU not loaded" << std::endl;
         return false;
     }
 
     try {
-        quic_connection_ = std::make_unique<QuicConnection>(false);
-        if (!quic_connection_->connect("localhost", 8080)) {
-            std::cerr << "Failed to connect to server" << std::endl;
-            return false;
+        // Greet the server with the protocol version and the hosted client ids
+        client_ids_.clear();
+        for (const auto& instance : instances_) {
+            client_ids_.push_back(instance->id());
+            instance->set_blob_assembler(&assembler_);
         }
 
+        quic_connection_ = std::make_unique<QuicConnection>(false);
         quic_connection_->set_message_handler(
             [this](const uint8_t* data, size_t len) {
-                auto msg = flatbuffers::GetRoot<SimProtocol::Message>(data);
-                if (msg->message_type_type() == SimProtocol::MessageType_StepRequest) {
-                    handle_step_request(msg->message_type_as_StepRequest());
-                }
+                handle_message(data, len);
             });
+        quic_connection_->set_connected_handler([this] {
+            // Built only now, as the Hello carries its send time for the clock offset.
+            // send() copies it, so the builder need not outlive the callback.
+            flatbuffers::FlatBufferBuilder hello;
+            build_hello(hello, client_ids_, kSupportedFeatures);
+            if (!quic_connection_->send(hello.GetBufferPointer(), hello.GetSize())) {
+                async_log(LogCategory::Network, "Failed to greet server, falling back to protocol v1");
+            }
+        });
+
+        if (!quic_connection_->connect(server_host_, server_port_)) {
+            std::cerr << "Failed to connect to server" << std::endl;
+            return false;
+        }
+
+        running_.store(true);
+        step_thread_ = std::thread([this] { step_loop(); });
+        pin_thread(step_thread_, step_cpu_);
 
         return true;
     } catch (const std::exception& e) {
@@ -71,87 +335,103 @@ bool QuicClient::init() {
     }
 }
 
-bool QuicClient::handle_step_request(const SimProtocol::StepRequest* request) {
-    if (!request) return false;
-
+bool QuicClient::open_shared_memory() {
     try {
-        // Update input values using get_real_variables/set_real_variables
-        std::vector<uint32_t> input_refs;
-        std::vector<double> input_values;
-        
-        for (const auto* input : *request->inputs()) {
-            if (input->value_type() == SimProtocol::ValueType_Real) {
-                input_refs.push_back(input->value_reference());
-                input_values.push_back(input->real_value());
-            }
-        }
+        shared_memory_ = std::make_unique<boost::interprocess::managed_shared_memory>(
+            boost::interprocess::open_only,
+            "simulation_shared_memory");
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error attaching to shared memory: " << e.what() << std::endl;
+        return false;
+    }
+}
 
-        if (!input_refs.empty()) {
-            slave_->set_real_variables(
-                gsl::make_span(input_refs),
-                gsl::make_span(input_values)
-            );
-        }
-
-        // Do the FMU step
-        const double stepSize = request->timestep_us() / 1e6;  // Convert to seconds
-        slave_->do_step(
-            cosim::to_time_point(0.0),
-            cosim::to_duration(stepSize)   // step size
-        );
-
-        // Build response with updated outputs
-        flatbuffers::FlatBufferBuilder builder;
-        std::vector<flatbuffers::Offset<SimProtocol::Variable>> outputs;
-        
-        // Get updated outputs using get_real_variables
-        std::vector<uint32_t> output_refs;
-        std::vector<double> output_values;
-        
-        for (const auto& cache : variable_cache_) {
-            if (cache.is_output) {
-                output_refs.push_back(cache.reference);
-            }
-        }
+bool QuicClient::init_local(uint32_t client_id) {
+    if (instances_.size() != 1) {
+        std::cerr << "FMU not loaded" << std::endl;
+        return false;
+    }
+    set_trace_process("client " + std::to_string(client_id));
+    return open_shared_memory() && instances_.front()->attach_local(*shared_memory_, client_id);
+}
 
-        if (!output_refs.empty()) {
-            output_values.resize(output_refs.size());
-            slave_->get_real_variables(
-                gsl::make_span(output_refs),
-                gsl::make_span(output_values)
-            );
-
-            for (size_t i = 0; i < output_refs.size(); ++i) {
-                auto var = SimProtocol::CreateVariable(
-                    builder,
-                    builder.CreateString(""),  // name
-                    SimProtocol::ValueType_Real,  // value_type
-                    output_refs[i],             // value_reference (now uint32_t)
-                    output_values[i]            // real_value
-                );
-                outputs.push_back(var);
-            }
+bool QuicClient::init_local() {
+    if (instances_.empty()) {
+        std::cerr << "FMU not loaded" << std::endl;
+        return false;
+    }
+    if (!open_shared_memory()) return false;
+
+    for (auto& instance : instances_) {
+        if (!instance->attach_local(*shared_memory_, instance->id())) return false;
+    }
+    return true;
+}
+
+bool QuicClient::has_request() const {
+    for (const auto& instance : instances_) {
+        if (instance->has_request()) return true;
+    }
+    return false;
+}
+
+bool QuicClient::serve_ready() {
+    ready_.clear();
+    for (auto& instance : instances_) {
+        if (instance->has_request()) ready_.push_back(instance.get());
+    }
+    if (ready_.empty()) return true;
+
+    auto serve = [this](FmuInstance& instance) {
+        bool ok = !quic_connection_ || instance.poll_mailbox(*quic_connection_);
+        return instance.poll_local() && ok;
+    };
+
+    if (!pool_ || ready_.size() == 1) {
+        bool ok = true;
+        for (auto* instance : ready_) {
+            ok = serve(*instance) && ok;
         }
+        return ok;
+    }
 
-        auto response = SimProtocol::CreateStepResponse(
-            builder,
-            builder.CreateVector(outputs));
+    // Instances with pending requests step in parallel
+    std::atomic<bool> ok{true};
+    pool_->parallel_for(ready_.size(), [this, &serve, &ok](size_t i) {
+        if (!serve(*ready_[i])) ok.store(false, std::memory_order_relaxed);
+    });
+    return ok.load(std::memory_order_relaxed);
+}
 
-        auto message = SimProtocol::CreateMessage(
-            builder,
-            SimProtocol::MessageType_StepResponse,
-            response.Union());
+void QuicClient::step_loop() {
+    // Spin briefly before sleeping, so back-to-back steps skip the wake-up latency
+    constexpr int kSpinRounds = 1000;
 
-        builder.Finish(message);
+    while (running_.load(std::memory_order_relaxed)) {
+        if (has_request()) {
+            // Failures are reported per request; the client keeps serving
+            serve_ready();
+            continue;
+        }
 
-        // Send response
-        return quic_connection_->send(
-            builder.GetBufferPointer(), 
-            builder.GetSize()
-        );
+        bool idle = true;
+        for (int i = 0; i < kSpinRounds && idle; ++i) {
+            std::this_thread::yield();
+            idle = !has_request();
+        }
+        if (!idle) continue;
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error during step: " << e.what() << std::endl;
-        return false;
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        step_sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_cv_.wait(lock, [this] {
+            return !running_.load(std::memory_order_relaxed) || has_request();
+        });
+        step_sleeping_.store(false, std::memory_order_relaxed);
     }
-} 
\ No newline at end of file
+}
+
+bool QuicClient::poll_local() {
+    return serve_ready();
+}
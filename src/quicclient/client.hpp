@@ -1,46 +1,100 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
-#include <cosim/execution.hpp>
-#include <cosim/algorithm.hpp>
-#include <cosim/algorithm/fixed_step_algorithm.hpp>
-#include <cosim/fmi/fmu.hpp>
-#include <cosim/fmi/importer.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
 #include "simulation_protocol_generated.h"
 #include "common/network.hpp"
+#include "common/thread_pool.hpp"
+#include "fmu_instance.hpp"
 
+// Client process hosting one or more FMU instances. All instances share one
+// connection to the server; requests and responses carry the instance id,
+// and several instances step in parallel on a work-stealing pool.
+//
+// FMUs never step on MsQuic threads: the message callback only copies the
+// request into the instance's mailbox, and a dedicated step thread answers.
 class QuicClient {
 private:
-    // Pre-allocated buffers
-    std::vector<uint8_t> send_buffer_;
-    std::vector<uint8_t> receive_buffer_;
-    
-    // Cosim FMU instance
-    std::shared_ptr<cosim::fmi::fmu> fmu_;
-    std::shared_ptr<cosim::fmi::slave_instance> slave_;
-    std::shared_ptr<cosim::fixed_step_algorithm> algorithm_;
-    std::unique_ptr<cosim::execution> execution_;
-    
+    std::vector<std::unique_ptr<FmuInstance>> instances_;
+
+    // Server address, from the host configuration
+    std::string server_host_ = "localhost";
+    uint16_t server_port_ = 8080;
+
+    // Ids of the hosted instances, sent in the Hello once connected
+    std::vector<uint32_t> client_ids_;
+
     // Network connection
     std::unique_ptr<QuicConnection> quic_connection_;
 
-    // Cache for variable references and values
-    struct VariableCache {
-        uint32_t reference;
-        bool is_output;
-    };
-    std::vector<VariableCache> variable_cache_;
+    // Decompressed form of the last compressed message, used on the MsQuic thread only
+    std::vector<uint8_t> inflated_;
+
+    // Binary inputs reassembled from chunks, taken by the instances when they step
+    BlobAssembler assembler_;
+
+    // Declared after the connection and instances, so workers stop before they go away
+    std::unique_ptr<ThreadPool> pool_;
+
+    // Step thread serving the mailboxes, optionally pinned to step_cpu_
+    std::thread step_thread_;
+    int step_cpu_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> step_sleeping_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+
+    // Shared-memory transport, used instead of QUIC by local clients
+    std::unique_ptr<boost::interprocess::managed_shared_memory> shared_memory_;
+    std::vector<FmuInstance*> ready_;
+
+    // Instance addressed by a request; a single hosted FMU answers every id
+    FmuInstance* find_instance(uint32_t instance_id);
+
+    void handle_message(const uint8_t* data, size_t len);
+
+    // Handles a plain, uncompressed message
+    void dispatch(const uint8_t* data, size_t len);
+
+    // Answers a TraceRequest with the spans of this process
+    void send_trace(uint32_t instance_id);
+
+    // Sends the variable table of every instance, once the server agreed on slot maps
+    void send_variable_tables();
+
+    bool open_shared_memory();
+
+    bool has_request() const;
+
+    // Steps every instance with a waiting request; false if one of them failed
+    bool serve_ready();
+
+    void step_loop();
 
 public:
-    QuicClient(const std::string& fmu_path);
-    
-    // Initialize FMU and prepare caches
+    // Hosts a single FMU; `step_cpu` pins the step thread, -1 leaves it unpinned
+    QuicClient(const std::string& fmu_path, int step_cpu = -1);
+
+    // Hosts the instances listed for `host_name` under `hosts:` in the configuration
+    QuicClient(const std::string& config_path, const std::string& host_name);
+
+    ~QuicClient();
+
+    // Connect to the server and start the step thread
     bool init();
-    
-    // Handle incoming step request
-    bool handle_step_request(const SimProtocol::StepRequest* request);
-    
-    // Pre-allocate all needed resources
-    void prepare_simulation();
-}; 
\ No newline at end of file
+
+    // Attach to the server's shared-memory rings instead of connecting over QUIC
+    bool init_local(uint32_t client_id);
+
+    // Attach every hosted instance to the rings of its client id
+    bool init_local();
+
+    // Handle all step requests waiting in the local request rings
+    bool poll_local();
+};
\ No newline at end of file
@@ -3,14 +3,308 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <limits>
+#include <new>
+#include <type_traits>
 
 #include "cppfmu_cs.hpp"
+#include "common/async_log.hpp"
+
+// Define CPPFMU_USE_ARENA to serve the FMU's allocations from memory reserved
+// once per instance. Everything allocated during instantiation lives in the
+// instance region until the instance is freed. Everything allocated during a
+// step comes from the step region, which is reset when the step returns, so
+// slaves must not keep such memory past the step. Allocations that do not fit,
+// or happen in any other FMI call, go to the host allocator as before.
+// Allocations from outside any FMI call, such as from a thread of the
+// slave's own, cannot tell the instance and use calloc and free.
+#ifdef CPPFMU_USE_ARENA
+#   ifndef CPPFMU_ARENA_INSTANCE_SIZE
+#       define CPPFMU_ARENA_INSTANCE_SIZE (1024 * 1024)
+#   endif
+#   ifndef CPPFMU_ARENA_STEP_SIZE
+#       define CPPFMU_ARENA_STEP_SIZE (256 * 1024)
+#   endif
+#endif
 
 
 namespace
 {
+#ifdef CPPFMU_USE_ARENA
+    // FMI 2.0 declares the callback members const
+    using AllocateMemory = std::remove_const_t<decltype(cppfmu::FMICallbackFunctions::allocateMemory)>;
+    using FreeMemory = std::remove_const_t<decltype(cppfmu::FMICallbackFunctions::freeMemory)>;
+
+    // Precedes every block handed out, so a free needs no context: arena
+    // blocks have no free function, others name the allocator they came from.
+    struct alignas(std::max_align_t) BlockHeader
+    {
+        FreeMemory free;
+    };
+
+    struct Region
+    {
+        unsigned char* begin;
+        unsigned char* next;
+        unsigned char* end;
+
+        void* Bump(std::size_t size)
+        {
+            const auto available = static_cast<std::size_t>(end - next);
+            if (size > available) return nullptr;
+            auto block = next;
+            next += size;
+            return block;
+        }
+    };
+
+    struct Arena
+    {
+        AllocateMemory hostAllocate;
+        FreeMemory hostFree;
+        Region instance;
+        Region step;
+    };
+
+    // Arena and region of the FMI call running on this thread
+    thread_local Arena* currentArena = nullptr;
+    thread_local Region* currentRegion = nullptr;
+
+    void* CallocFallback(std::size_t nObj, std::size_t size)
+    {
+        return std::calloc(nObj, size);
+    }
+
+    void* ArenaAllocate(std::size_t nObj, std::size_t size)
+    {
+        constexpr auto align = alignof(std::max_align_t);
+        if (size != 0 && nObj > (std::numeric_limits<std::size_t>::max() - 2 * align) / size) {
+            return nullptr;
+        }
+        const auto bytes = sizeof(BlockHeader) + (nObj * size + align - 1) / align * align;
+
+        BlockHeader* header = nullptr;
+        if (currentRegion != nullptr) {
+            if (auto block = currentRegion->Bump(bytes)) {
+                // The host allocator hands out zeroed memory, and so must we
+                std::memset(block, 0, bytes);
+                header = static_cast<BlockHeader*>(block);
+                header->free = nullptr;
+                return header + 1;
+            }
+        }
+
+        // Outside an FMI call there is no arena to ask for the host
+        // allocator, so the C library stands in
+        const auto allocate = currentArena ? currentArena->hostAllocate : &CallocFallback;
+        const auto free = currentArena ? currentArena->hostFree : static_cast<FreeMemory>(&std::free);
+        header = static_cast<BlockHeader*>(allocate(1, bytes));
+        if (header == nullptr) return nullptr;
+        header->free = free;
+        return header + 1;
+    }
+
+    void ArenaFree(void* obj)
+    {
+        if (obj == nullptr) return;
+        const auto header = static_cast<BlockHeader*>(obj) - 1;
+        if (header->free != nullptr) header->free(header);
+    }
+
+    // Reserves both regions of an instance in one host allocation
+    Arena* CreateArena(const cppfmu::FMICallbackFunctions& functions)
+    {
+        constexpr std::size_t instanceSize = CPPFMU_ARENA_INSTANCE_SIZE;
+        constexpr std::size_t stepSize = CPPFMU_ARENA_STEP_SIZE;
+        constexpr auto headerSize = (sizeof(Arena) + alignof(std::max_align_t) - 1)
+            / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        const auto memory = static_cast<unsigned char*>(
+            functions.allocateMemory(1, headerSize + instanceSize + stepSize));
+        if (memory == nullptr) throw std::bad_alloc();
+
+        const auto arena = new (memory) Arena;
+        arena->hostAllocate = functions.allocateMemory;
+        arena->hostFree = functions.freeMemory;
+        const auto instance = memory + headerSize;
+        arena->instance = Region{instance, instance, instance + instanceSize};
+        const auto step = arena->instance.end;
+        arena->step = Region{step, step, step + stepSize};
+        return arena;
+    }
+
+    void DestroyArena(Arena* arena)
+    {
+        const auto hostFree = arena->hostFree;
+        arena->~Arena();
+        hostFree(arena);
+    }
+
+    // The importer's callbacks with allocation routed through the arena,
+    // built anew as the members may be const
+    cppfmu::FMICallbackFunctions ArenaCallbacks(const cppfmu::FMICallbackFunctions& functions)
+    {
+#ifdef CPPFMU_USE_FMI_1_0
+        return {functions.logger, &ArenaAllocate, &ArenaFree, functions.stepFinished};
+#else
+        return {functions.logger, &ArenaAllocate, &ArenaFree, functions.stepFinished,
+            functions.componentEnvironment};
+#endif
+    }
+
+    // Directs the allocations of one FMI call to `region` of `arena`, or
+    // to the host allocator if `region` is null. A step region is reset
+    // when its scope ends.
+    class ArenaScope
+    {
+    public:
+        ArenaScope(Arena* arena, Region* region)
+            : previousArena_{currentArena}
+            , previousRegion_{currentRegion}
+        {
+            currentArena = arena;
+            currentRegion = region;
+        }
+
+        ~ArenaScope()
+        {
+            if (currentArena != nullptr && currentRegion == &currentArena->step) {
+                currentRegion->next = currentRegion->begin;
+            }
+            currentArena = previousArena_;
+            currentRegion = previousRegion_;
+        }
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+    private:
+        Arena* previousArena_;
+        Region* previousRegion_;
+    };
+
+    // Releases the arena of an instance that failed to instantiate
+    struct ArenaGuard
+    {
+        Arena* arena;
+        ~ArenaGuard() { if (arena != nullptr) DestroyArena(arena); }
+    };
+#endif
+
+    using CallbackLogger = std::remove_const_t<decltype(cppfmu::FMICallbackFunctions::logger)>;
+
+    // Log messages of one model instance, those of the slave and of the
+    // wrappers below alike. Handing a message to the importer's logger may
+    // take milliseconds of I/O, so inside an FMI call it is only formatted
+    // into a fixed-size entry; the next FMI call on the instance passes the
+    // entries on, from the caller's thread as FMI requires. Each status has
+    // its own rate limit; messages over it, or arriving at a full queue, are
+    // counted and reported with the next flush.
+    class DeferredLog
+    {
+    public:
+        DeferredLog(void* environment, CallbackLogger logger)
+            : environment_{environment}
+            , logger_{logger}
+        { }
+
+        DeferredLog(const DeferredLog&) = delete;
+        DeferredLog& operator=(const DeferredLog&) = delete;
+
+        // The importer's callbacks with logging directed to Queue(). The
+        // logger then passes the DeferredLog as its component environment.
+        // Built anew, as FMI 2.0 declares the members const.
+        static cppfmu::FMICallbackFunctions Callbacks(const cppfmu::FMICallbackFunctions& functions)
+        {
+#ifdef CPPFMU_USE_FMI_1_0
+            return {&Queue, functions.allocateMemory, functions.freeMemory, functions.stepFinished};
+#else
+            return {&Queue, functions.allocateMemory, functions.freeMemory, functions.stepFinished,
+                functions.componentEnvironment};
+#endif
+        }
+
+        static void Queue(
+            void* environment,
+            cppfmu::FMIString instanceName,
+            cppfmu::FMIStatus status,
+            cppfmu::FMIString category,
+            cppfmu::FMIString message,
+            ...)
+        {
+            const auto log = static_cast<DeferredLog*>(environment);
+            const auto index = static_cast<std::size_t>(status);
+            if (index < statusCount && !log->limits_[index].admit()) return;
+            if (log->count_ == capacity) {
+                ++log->dropped_;
+                return;
+            }
+
+            auto& entry = log->entries_[log->count_++];
+            log->instanceName_ = instanceName;
+            entry.status = status;
+            std::snprintf(entry.category, sizeof(entry.category), "%s", category ? category : "");
+            std::va_list args;
+            va_start(args, message);
+            std::vsnprintf(entry.text, sizeof(entry.text), message ? message : "", args);
+            va_end(args);
+        }
+
+        // Passes the queued messages to the importer's logger
+        void Flush() noexcept
+        {
+            for (std::size_t i = 0; i < count_; ++i) {
+                const auto& entry = entries_[i];
+                logger_(environment_, instanceName_, entry.status, entry.category, "%s", entry.text);
+            }
+            count_ = 0;
+
+            unsigned long long suppressed = 0;
+            for (auto& limit : limits_) {
+                suppressed += limit.suppressed.exchange(0, std::memory_order_relaxed);
+            }
+            if (suppressed != 0) {
+                logger_(environment_, instanceName_, warning, "", "%llu messages suppressed by rate limit",
+                    suppressed);
+            }
+            if (dropped_ != 0) {
+                logger_(environment_, instanceName_, warning, "", "%llu messages dropped, log queue full",
+                    dropped_);
+                dropped_ = 0;
+            }
+        }
+
+    private:
+        static constexpr std::size_t capacity = 32;
+        static constexpr std::size_t statusCount = 6;  // OK, warning, discard, error, fatal, pending
+#ifdef CPPFMU_USE_FMI_1_0
+        static constexpr auto warning = fmiWarning;
+#else
+        static constexpr auto warning = fmi2Warning;
+#endif
+
+        struct Entry
+        {
+            cppfmu::FMIStatus status;
+            char category[32];
+            char text[256];
+        };
+
+        void* environment_;
+        CallbackLogger logger_;
+        cppfmu::FMIString instanceName_ = "";
+        Entry entries_[capacity];
+        std::size_t count_ = 0;
+        unsigned long long dropped_ = 0;
+        LogRateLimit limits_[statusCount];
+    };
+
     // A struct that holds all the data for one model instance.
     struct Component
     {
@@ -19,12 +313,14 @@ namespace
             cppfmu::FMICallbackFunctions callbackFunctions,
             cppfmu::FMIBoolean loggingOn)
             : memory{callbackFunctions}
-            , loggerSettings{std::make_shared<cppfmu::Logger::Settings>(memory)}
+            , loggerSettings{std::allocate_shared<cppfmu::Logger::Settings>(
+                cppfmu::Allocator<cppfmu::Logger::Settings>{memory}, memory)}
 #ifdef CPPFMU_USE_FMI_1_0
-            , logger{this, cppfmu::CopyString(memory, instanceName), callbackFunctions, loggerSettings}
+            , log{this, callbackFunctions.logger}
 #else
-            , logger{callbackFunctions.componentEnvironment, cppfmu::CopyString(memory, instanceName), callbackFunctions, loggerSettings}
+            , log{callbackFunctions.componentEnvironment, callbackFunctions.logger}
 #endif
+            , logger{&log, cppfmu::CopyString(memory, instanceName), DeferredLog::Callbacks(callbackFunctions), loggerSettings}
             , lastSuccessfulTime{std::numeric_limits<cppfmu::FMIReal>::quiet_NaN()}
         {
             loggerSettings->debugLoggingEnabled = (loggingOn == cppfmu::FMITrue);
@@ -33,12 +329,58 @@ namespace
         // General
         cppfmu::Memory memory;
         std::shared_ptr<cppfmu::Logger::Settings> loggerSettings;
+        DeferredLog log;
         cppfmu::Logger logger;
 
         // Co-simulation
         cppfmu::UniquePtr<cppfmu::SlaveInstance> slave;
         cppfmu::FMIReal lastSuccessfulTime;
+
+#ifdef CPPFMU_USE_ARENA
+        Arena* arena = nullptr;
+#endif
+    };
+
+    // Opened first by every FMI call on an existing component: hands the
+    // messages queued since the previous call to the importer's logger and,
+    // in arena mode, directs the call's allocations to the host allocator.
+    // Instantiation and stepping open a scope of their own for their region.
+    struct CallScope
+    {
+        explicit CallScope(void* c)
+            : component{static_cast<Component*>(c)}
+#ifdef CPPFMU_USE_ARENA
+            , arena{component->arena, nullptr}
+#endif
+        {
+            component->log.Flush();
+        }
+
+        Component* const component;
+#ifdef CPPFMU_USE_ARENA
+        ArenaScope arena;
+#endif
     };
+
+    // Destroys a component and everything it allocated
+    void FreeComponent(Component* component)
+    {
+        // Whatever the slave logs on its way out is still passed on
+        component->log.Flush();
+        component->slave.reset();
+        component->log.Flush();
+
+        // The Component object was allocated using cppfmu::AllocateUnique(),
+        // which uses cppfmu::New() internally, so we use cppfmu::Delete() to
+        // release it again.
+#ifdef CPPFMU_USE_ARENA
+        const auto arena = component->arena;
+        cppfmu::Delete(component->memory, component);
+        DestroyArena(arena);
+#else
+        cppfmu::Delete(component->memory, component);
+#endif
+    }
 }
 
 
@@ -69,9 +411,16 @@ fmiComponent fmiInstantiateSlave(
     fmiBoolean loggingOn)
 {
     try {
-        auto component = cppfmu::AllocateUnique<Component>(cppfmu::Memory{functions},
+#ifdef CPPFMU_USE_ARENA
+        ArenaGuard guard{CreateArena(functions)};
+        ArenaScope scope{guard.arena, &guard.arena->instance};
+        const auto callbacks = ArenaCallbacks(functions);
+#else
+        const auto& callbacks = functions;
+#endif
+        auto component = cppfmu::AllocateUnique<Component>(cppfmu::Memory{callbacks},
             instanceName,
-            functions,
+            callbacks,
             loggingOn);
         component->slave = CppfmuInstantiateSlave(
             instanceName,
@@ -83,6 +432,11 @@ fmiComponent fmiInstantiateSlave(
             interactive,
             component->memory,
             component->logger);
+#ifdef CPPFMU_USE_ARENA
+        component->arena = guard.arena;
+        guard.arena = nullptr;
+#endif
+        component->log.Flush();
         return component.release();
     } catch (const cppfmu::FatalError& e) {
         functions.logger(nullptr, instanceName, fmiFatal, "", e.what());
@@ -96,11 +450,7 @@ fmiComponent fmiInstantiateSlave(
 
 void fmiFreeSlaveInstance(fmiComponent c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
-    // The Component object was allocated using cppfmu::AllocateUnique(),
-    // which uses cppfmu::New() internally, so we use cppfmu::Delete() to
-    // release it again.
-    cppfmu::Delete(component->memory, component);
+    FreeComponent(reinterpret_cast<Component*>(c));
 }
 
 
@@ -110,7 +460,8 @@ fmiStatus fmiInitializeSlave(
     fmiBoolean   stopTimeDefined,
     fmiReal      tStop)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetupExperiment(
             fmiFalse,
@@ -133,7 +484,8 @@ fmiStatus fmiInitializeSlave(
 
 fmiStatus fmiResetSlave(fmiComponent c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->Reset();
         return fmiOK;
@@ -149,7 +501,8 @@ fmiStatus fmiResetSlave(fmiComponent c)
 
 fmiStatus fmiTerminateSlave(fmiComponent c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->Terminate();
         return fmiOK;
@@ -167,7 +520,7 @@ fmiStatus fmiSetDebugLogging(
     fmiComponent c,
     fmiBoolean loggingOn)
 {
-    reinterpret_cast<Component*>(c)->loggerSettings->debugLoggingEnabled = (loggingOn == fmiTrue);
+    CallScope{c}.component->loggerSettings->debugLoggingEnabled = (loggingOn == fmiTrue);
     return fmiOK;
 }
 
@@ -178,7 +531,8 @@ fmiStatus fmiGetReal(
     size_t nvr,
     fmiReal value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetReal(vr, nvr, value);
         return fmiOK;
@@ -197,7 +551,8 @@ fmiStatus fmiGetInteger(
     size_t nvr,
     fmiInteger value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetInteger(vr, nvr, value);
         return fmiOK;
@@ -216,7 +571,8 @@ fmiStatus fmiGetBoolean(
     size_t nvr,
     fmiBoolean value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetBoolean(vr, nvr, value);
         return fmiOK;
@@ -235,7 +591,8 @@ fmiStatus fmiGetString(
     size_t nvr,
     fmiString value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetString(vr, nvr, value);
         return fmiOK;
@@ -255,7 +612,8 @@ fmiStatus fmiSetReal(
     size_t nvr,
     const fmiReal value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetReal(vr, nvr, value);
         return fmiOK;
@@ -274,7 +632,8 @@ fmiStatus fmiSetInteger(
     size_t nvr,
     const fmiInteger value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetInteger(vr, nvr, value);
         return fmiOK;
@@ -289,7 +648,8 @@ fmiStatus fmiSetInteger(
 
 fmiStatus fmiSetBoolean (fmiComponent c, const fmiValueReference vr[], size_t nvr, const fmiBoolean value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetBoolean(vr, nvr, value);
         return fmiOK;
@@ -304,7 +664,8 @@ fmiStatus fmiSetBoolean (fmiComponent c, const fmiValueReference vr[], size_t nv
 
 fmiStatus fmiSetString  (fmiComponent c, const fmiValueReference vr[], size_t nvr, const fmiString  value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetString(vr, nvr, value);
         return fmiOK;
@@ -325,7 +686,7 @@ fmiStatus fmiSetRealInputDerivatives(
     const  fmiInteger /*order*/[],
     const  fmiReal /*value*/[])
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiSetRealInputDerivatives");
@@ -340,7 +701,7 @@ fmiStatus fmiGetRealOutputDerivatives(
     const   fmiInteger /*order*/[],
     fmiReal /*value*/[])
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiGetRealOutputDerivatives");
@@ -351,7 +712,7 @@ fmiStatus fmiGetRealOutputDerivatives(
 
 fmiStatus fmiCancelStep(fmiComponent c)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiCancelStep");
@@ -365,7 +726,12 @@ fmiStatus fmiDoStep(
     fmiReal      communicationStepSize,
     fmiBoolean   newStep)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
+#ifdef CPPFMU_USE_ARENA
+    // Step temporaries are bump-allocated and dropped together on return
+    ArenaScope scope{component->arena, &component->arena->step};
+#endif
     try {
         double endTime = currentCommunicationPoint;
         const auto ok = component->slave->DoStep(
@@ -396,7 +762,7 @@ fmiStatus fmiGetStatus(
     const fmiStatusKind /*s*/,
     fmiStatus* /*value*/)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiGetStatus");
@@ -410,7 +776,8 @@ fmiStatus fmiGetRealStatus(
     const fmiStatusKind s,
     fmiReal* value)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     if (s == fmiLastSuccessfulTime) {
         *value = component->lastSuccessfulTime;
         return fmiOK;
@@ -429,7 +796,7 @@ fmiStatus fmiGetIntegerStatus(
     const fmiStatusKind /*s*/,
     fmiInteger* /*value*/)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiGetIntegerStatus");
@@ -443,7 +810,7 @@ fmiStatus fmiGetBooleanStatus(
     const fmiStatusKind /*s*/,
     fmiBoolean* /*value*/)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiGetBooleanStatus");
@@ -456,7 +823,7 @@ fmiStatus fmiGetStringStatus(
     const fmiStatusKind /*s*/,
     fmiString*  /*value*/)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmiError,
         "cppfmu",
         "FMI function not supported: fmiGetStringStatus");
@@ -496,9 +863,16 @@ fmi2Component fmi2Instantiate(
         if (fmuType != fmi2CoSimulation) {
             throw std::logic_error("Unsupported FMU instance type requested (only co-simulation is supported)");
         }
-        auto component = cppfmu::AllocateUnique<Component>(cppfmu::Memory{*functions},
+#ifdef CPPFMU_USE_ARENA
+        ArenaGuard guard{CreateArena(*functions)};
+        ArenaScope scope{guard.arena, &guard.arena->instance};
+        const auto callbacks = ArenaCallbacks(*functions);
+#else
+        const auto& callbacks = *functions;
+#endif
+        auto component = cppfmu::AllocateUnique<Component>(cppfmu::Memory{callbacks},
             instanceName,
-            *functions,
+            callbacks,
             loggingOn);
         component->slave = CppfmuInstantiateSlave(
             instanceName,
@@ -510,6 +884,11 @@ fmi2Component fmi2Instantiate(
             cppfmu::FMIFalse,
             component->memory,
             component->logger);
+#ifdef CPPFMU_USE_ARENA
+        component->arena = guard.arena;
+        guard.arena = nullptr;
+#endif
+        component->log.Flush();
         return component.release();
     } catch (const cppfmu::FatalError& e) {
         functions->logger(nullptr, instanceName, fmi2Fatal, "", e.what());
@@ -523,11 +902,7 @@ fmi2Component fmi2Instantiate(
 
 void fmi2FreeInstance(fmi2Component c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
-    // The Component object was allocated using cppfmu::AllocateUnique(),
-    // which uses cppfmu::New() internally, so we use cppfmu::Delete() to
-    // release it again.
-    cppfmu::Delete(component->memory, component);
+    FreeComponent(reinterpret_cast<Component*>(c));
 }
 
 
@@ -537,7 +912,8 @@ fmi2Status fmi2SetDebugLogging(
     size_t nCategories,
     const fmi2String categories[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
 
     std::vector<cppfmu::String, cppfmu::Allocator<cppfmu::String>> newCategories(
             cppfmu::Allocator<cppfmu::String>(component->memory));
@@ -559,7 +935,8 @@ fmi2Status fmi2SetupExperiment(
     fmi2Boolean   stopTimeDefined,
     fmi2Real      stopTime)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetupExperiment(
             toleranceDefined,
@@ -580,7 +957,8 @@ fmi2Status fmi2SetupExperiment(
 
 fmi2Status fmi2EnterInitializationMode(fmi2Component c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->EnterInitializationMode();
         return fmi2OK;
@@ -596,7 +974,8 @@ fmi2Status fmi2EnterInitializationMode(fmi2Component c)
 
 fmi2Status fmi2ExitInitializationMode(fmi2Component c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->ExitInitializationMode();
         return fmi2OK;
@@ -612,7 +991,8 @@ fmi2Status fmi2ExitInitializationMode(fmi2Component c)
 
 fmi2Status fmi2Terminate(fmi2Component c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->Terminate();
         return fmi2OK;
@@ -628,7 +1008,8 @@ fmi2Status fmi2Terminate(fmi2Component c)
 
 fmi2Status fmi2Reset(fmi2Component c)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->Reset();
         return fmi2OK;
@@ -648,7 +1029,8 @@ fmi2Status fmi2GetReal(
     size_t nvr,
     fmi2Real value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetReal(vr, nvr, value);
         return fmi2OK;
@@ -667,7 +1049,8 @@ fmi2Status fmi2GetInteger(
     size_t nvr,
     fmi2Integer value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetInteger(vr, nvr, value);
         return fmi2OK;
@@ -686,7 +1069,8 @@ fmi2Status fmi2GetBoolean(
     size_t nvr,
     fmi2Boolean value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetBoolean(vr, nvr, value);
         return fmi2OK;
@@ -705,7 +1089,8 @@ fmi2Status fmi2GetString(
     size_t nvr,
     fmi2String value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->GetString(vr, nvr, value);
         return fmi2OK;
@@ -725,7 +1110,8 @@ fmi2Status fmi2SetReal(
     size_t nvr,
     const fmi2Real value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetReal(vr, nvr, value);
         return fmi2OK;
@@ -744,7 +1130,8 @@ fmi2Status fmi2SetInteger(
     size_t nvr,
     const fmi2Integer value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetInteger(vr, nvr, value);
         return fmi2OK;
@@ -763,7 +1150,8 @@ fmi2Status fmi2SetBoolean(
     size_t nvr,
     const fmi2Boolean value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetBoolean(vr, nvr, value);
         return fmi2OK;
@@ -782,7 +1170,8 @@ fmi2Status fmi2SetString(
     size_t nvr,
     const fmi2String value[])
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     try {
         component->slave->SetString(vr, nvr, value);
         return fmi2OK;
@@ -800,7 +1189,7 @@ fmi2Status fmi2GetFMUstate(
     fmi2Component c,
     fmi2FMUstate*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetFMUstate");
@@ -811,7 +1200,7 @@ fmi2Status fmi2SetFMUstate(
     fmi2Component c,
     fmi2FMUstate)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2SetFMUstate");
@@ -822,7 +1211,7 @@ fmi2Status fmi2FreeFMUstate(
     fmi2Component c,
     fmi2FMUstate*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2FreeFMUstate");
@@ -834,7 +1223,7 @@ fmi2Status fmi2SerializedFMUstateSize(
     fmi2FMUstate,
     size_t*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2SerializedFMUstateSize");
@@ -847,7 +1236,7 @@ fmi2Status fmi2SerializeFMUstate(
     fmi2Byte[],
     size_t)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2SerializeFMUstate");
@@ -860,7 +1249,7 @@ fmi2Status fmi2DeSerializeFMUstate(
     size_t,
     fmi2FMUstate*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2DeSerializeFMUstate");
@@ -877,7 +1266,7 @@ fmi2Status fmi2GetDirectionalDerivative(
     const fmi2Real[],
     fmi2Real[])
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetDirectionalDerivative");
@@ -891,7 +1280,7 @@ fmi2Status fmi2SetRealInputDerivatives(
     const fmi2Integer[],
     const fmi2Real[])
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2SetRealInputDerivatives");
@@ -905,7 +1294,7 @@ fmi2Status fmi2GetRealOutputDerivatives(
     const fmi2Integer[],
     fmi2Real[])
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmiGetRealOutputDerivatives");
@@ -918,7 +1307,12 @@ fmi2Status fmi2DoStep(
     fmi2Real communicationStepSize,
     fmi2Boolean /*noSetFMUStatePriorToCurrentPoint*/)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
+#ifdef CPPFMU_USE_ARENA
+    // Step temporaries are bump-allocated and dropped together on return
+    ArenaScope scope{component->arena, &component->arena->step};
+#endif
     try {
         double endTime = currentCommunicationPoint;
         const auto ok = component->slave->DoStep(
@@ -945,7 +1339,7 @@ fmi2Status fmi2DoStep(
 
 fmi2Status fmi2CancelStep(fmi2Component c)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2CancelStep");
@@ -959,7 +1353,7 @@ fmi2Status fmi2GetStatus(
     const fmi2StatusKind,
     fmi2Status*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetStatus");
@@ -971,7 +1365,8 @@ fmi2Status fmi2GetRealStatus(
     const fmi2StatusKind s,
     fmi2Real* value)
 {
-    const auto component = reinterpret_cast<Component*>(c);
+    const CallScope call{c};
+    const auto component = call.component;
     if (s == fmi2LastSuccessfulTime) {
         *value = component->lastSuccessfulTime;
         return fmi2OK;
@@ -989,7 +1384,7 @@ fmi2Status fmi2GetIntegerStatus(
     const fmi2StatusKind,
     fmi2Integer*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetIntegerStatus");
@@ -1001,7 +1396,7 @@ fmi2Status fmi2GetBooleanStatus(
     const fmi2StatusKind,
     fmi2Boolean*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetBooleanStatus");
@@ -1013,7 +1408,7 @@ fmi2Status fmi2GetStringStatus(
     const fmi2StatusKind,
     fmi2String*)
 {
-    reinterpret_cast<Component*>(c)->logger.Log(
+    CallScope{c}.component->logger.Log(
         fmi2Error,
         "cppfmu",
         "FMI function not supported: fmi2GetStringStatus");
@@ -0,0 +1,704 @@
+#include "fmu_instance.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include "common/async_log.hpp"
+
+namespace {
+
+// Region the server published under `name`, or nullptr
+void* find_region(boost::interprocess::managed_shared_memory& segment, const std::string& name) {
+    using boost::interprocess::managed_shared_memory;
+    auto handle = segment.find<managed_shared_memory::handle_t>(name.c_str()).first;
+    return handle ? segment.get_address_from_handle(*handle) : nullptr;
+}
+
+// Values at `positions` of `values`, in that order
+template <typename T, typename Source>
+flatbuffers::Offset<flatbuffers::Vector<T>> gather(flatbuffers::FlatBufferBuilder& builder,
+                                                   const std::vector<uint32_t>& positions, const Source* values) {
+    T* data = nullptr;
+    auto vector = builder.CreateUninitializedVector(positions.size(), &data);
+    for (size_t i = 0; i < positions.size(); ++i) data[i] = static_cast<T>(values[positions[i]]);
+    return vector;
+}
+
+}  // namespace
+
+FmuInstance::FmuInstance(uint32_t instance_id, std::unique_ptr<SimulationUnit> unit, size_t buffer_size)
+    : instance_id_(instance_id)
+    , unit_(std::move(unit))
+    , send_pool_(4, buffer_size)
+    , mailbox_(4, static_cast<uint32_t>(buffer_size))
+    , current_time_(cosim::to_time_point(0.0))
+    , latencies_("client " + std::to_string(instance_id),
+                 {"receive", "set_inputs", "do_step", "get_outputs", "build", "send"}) {
+
+    try {
+        unit_->setup(current_time_);
+
+        // Binary variables stand in for their integer components
+        variable_cache_ = signal_variables(*unit_->model_description(), unit_->binary_variables());
+        prepare_simulation();
+
+    } catch (const std::exception& e) {
+        unit_.reset();
+        std::cerr << "Failed to set up instance " << instance_id_ << ": " << e.what() << std::endl;
+    }
+}
+
+bool FmuInstance::attach_local(boost::interprocess::managed_shared_memory& segment, uint32_t client_id) {
+    std::string suffix = std::to_string(client_id);
+    void* requests = find_region(segment, "request_ring_" + suffix);
+    void* responses = find_region(segment, "response_ring_" + suffix);
+    if (!requests || !responses) {
+        std::cerr << "No shared-memory rings for client " << client_id << std::endl;
+        return false;
+    }
+
+    request_ring_ = std::make_unique<SharedMessageRing>(requests);
+    response_writer_ = std::make_unique<SharedMessageWriter>(SharedMessageRing(responses));
+
+    // The server only creates a blob store for clients with binary outputs
+    segment_ = &segment;
+    store_id_ = client_id;
+    if (void* store = find_region(segment, "blob_store_" + suffix)) {
+        blob_store_ = std::make_unique<SharedBlobStore>(store);
+        if (!blob_store_->valid()) blob_store_.reset();
+    }
+    if (void* pool = find_region(segment, "simulation_string_pool")) {
+        string_pool_ = std::make_unique<SharedStringPool>(pool);
+        if (!string_pool_->valid()) string_pool_.reset();
+    }
+
+    // Announce the protocol version; the server keeps sending v1 until it reads this.
+    // Compression buys nothing in shared memory, so only the slot map is offered.
+    auto* builder = response_writer_->begin();
+    if (!builder) {
+        std::cerr << "Response ring of client " << client_id << " full" << std::endl;
+        return false;
+    }
+    build_hello(*builder, {client_id}, SimProtocol::Feature_SlotMap);
+    response_writer_->commit();
+    return true;
+}
+
+bool FmuInstance::poll_local() {
+    if (!request_ring_) return true;
+
+    // Requests are read in place from the segment; the slot is released once answered
+    while (const auto* msg = request_ring_->front()) {
+        bool ok = true;
+        if (is_step_request(msg)) {
+            // Build the response in place in the response ring
+            auto* builder = response_writer_->begin();
+            if (!builder) {
+                async_log(LogCategory::Step, "Response ring full");
+                ok = false;
+            } else {
+                try {
+                    step(msg, *builder);
+                    auto start = PhaseLatencies::now();
+                    response_writer_->commit();
+                    latencies_.lap(kSend, start);
+                } catch (const std::exception& e) {
+                    response_writer_->abort();
+                    async_log(LogCategory::Step, "Error during step: {}", e.what());
+                    ok = false;
+                }
+            }
+        } else if (const auto* welcome = msg->message_type_as_Welcome()) {
+            apply_welcome_trace(welcome, trace_clock_now());
+            if (has_feature(welcome->features(), SimProtocol::Feature_SlotMap)) ok = send_local_variable_table();
+        } else if (const auto* map = msg->message_type_as_SlotMap()) {
+            apply_slot_map(map);
+        } else if (const auto* request = msg->message_type_as_TraceRequest()) {
+            ok = send_local_trace(request->instance_id());
+        }
+        request_ring_->pop();
+        if (!ok) return false;
+    }
+    return true;
+}
+
+flatbuffers::FlatBufferBuilder* FmuInstance::wait_for_response_slot() {
+    // The server drains the ring with every step
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    flatbuffers::FlatBufferBuilder* builder;
+    while (!(builder = response_writer_->begin())) {
+        if (std::chrono::steady_clock::now() > deadline) return nullptr;
+        std::this_thread::yield();
+    }
+    return builder;
+}
+
+bool FmuInstance::send_local_variable_table() {
+    // Names vary in length, so a message takes variables until half a slot is estimated full
+    size_t budget = response_writer_->slot_size() / 2;
+    size_t sent = 0;
+    do {
+        size_t count = 0;
+        size_t bytes = 0;
+        while (sent + count < variable_cache_.size() &&
+               (count == 0 || bytes + variable_cache_[sent + count].name.size() + 48 < budget)) {
+            bytes += variable_cache_[sent + count].name.size() + 48;
+            ++count;
+        }
+
+        auto* builder = wait_for_response_slot();
+        if (!builder) {
+            async_log(LogCategory::Protocol, "Response ring full, dropping variable table of instance {}", instance_id_);
+            return false;
+        }
+        try {
+            build_variable_table(*builder, instance_id_, variable_cache_, sent, count,
+                                 sent + count == variable_cache_.size());
+            response_writer_->commit();
+        } catch (const std::exception& e) {
+            response_writer_->abort();
+            async_log(LogCategory::Protocol, "Variable table does not fit the response ring: {}", e.what());
+            return false;
+        }
+        sent += count;
+    } while (sent < variable_cache_.size());
+    return true;
+}
+
+void FmuInstance::apply_slot_map(const SimProtocol::SlotMap* map) {
+    auto append = [](SlotMapRefs& target, const SimProtocol::SignalVector* refs) {
+        if (!refs) return;
+        auto add = [](std::vector<uint32_t>& to, const flatbuffers::Vector<uint32_t>* from) {
+            if (!from) return;
+            for (uint32_t i = 0; i < from->size(); ++i) to.push_back(from->Get(i));
+        };
+        add(target[SimProtocol::ValueType_Real], refs->real_refs());
+        add(target[SimProtocol::ValueType_Integer], refs->integer_refs());
+        add(target[SimProtocol::ValueType_Boolean], refs->boolean_refs());
+    };
+    if (map->epoch() != receiving_epoch_) {
+        receiving_epoch_ = map->epoch();
+        for (auto& refs : map_inputs_) refs.clear();
+        for (auto& refs : map_outputs_) refs.clear();
+        positional_ = false;
+    }
+    append(map_inputs_, map->inputs());
+    append(map_outputs_, map->outputs());
+    if (!map->last()) return;
+
+    // Outputs are read from the unit in full; the map picks the connected ones out of those arrays
+    const std::vector<cosim::value_reference>* outputs[] = {
+        &reals_.output_refs, &integers_.output_refs, &booleans_.output_refs};
+    for (size_t type = 0; type < map_outputs_.size(); ++type) {
+        auto& positions = output_positions_[type];
+        positions.clear();
+        for (uint32_t ref : map_outputs_[type]) {
+            auto it = std::find(outputs[type]->begin(), outputs[type]->end(), ref);
+            if (it == outputs[type]->end()) {
+                async_log(LogCategory::Protocol, "Slot map names unknown output {} of instance {}", ref, instance_id_);
+                return;
+            }
+            positions.push_back(static_cast<uint32_t>(it - outputs[type]->begin()));
+        }
+    }
+    map_epoch_ = receiving_epoch_;
+    positional_ = true;
+}
+
+bool FmuInstance::send_local_trace(uint32_t instance_id) {
+    // The first request takes every span of the process; later ones find the rings empty
+    TraceSnapshot trace = take_trace();
+    std::string process = trace_process();
+
+    // Half a slot of spans per message leaves room for the name table
+    size_t per_message = std::max<size_t>(16, response_writer_->slot_size() / 2 / sizeof(SimProtocol::TraceSpan));
+    size_t sent = 0;
+    do {
+        auto* builder = wait_for_response_slot();
+        if (!builder) {
+            async_log(LogCategory::Protocol, "Response ring full, dropping trace of instance {}", instance_id);
+            return false;
+        }
+
+        size_t count = std::min(per_message, trace.spans.size() - sent);
+        try {
+            build_trace_data(*builder, instance_id, process, trace, sent, count, sent + count == trace.spans.size());
+            response_writer_->commit();
+        } catch (const std::exception& e) {
+            response_writer_->abort();
+            async_log(LogCategory::Protocol, "Trace does not fit the response ring: {}", e.what());
+            return false;
+        }
+        sent += count;
+    } while (sent < trace.spans.size());
+    return true;
+}
+
+bool FmuInstance::handle_step_request(const SimProtocol::Message* msg, QuicConnection& connection) {
+    if (!is_step_request(msg)) return false;
+
+    auto* builder = send_pool_.begin();
+    if (!builder) {
+        async_log(LogCategory::Step, "All send buffers of instance {} in flight", instance_id_);
+        return false;
+    }
+
+    try {
+        pending_blobs_.clear();
+        step(msg, *builder);
+
+        // Binary outputs travel ahead of the response that refers to them
+        auto start = PhaseLatencies::now();
+        for (const auto& pending : pending_blobs_) {
+            if (!blob_sender_.send(connection, pending.id, pending.value)) {
+                send_pool_.abort();
+                return false;
+            }
+        }
+        bool sent = send_pool_.send(connection, compressor_);
+        latencies_.lap(kSend, start);
+        return sent;
+
+    } catch (const std::exception& e) {
+        send_pool_.abort();
+        async_log(LogCategory::Step, "Error during step: {}", e.what());
+        return false;
+    }
+}
+
+bool FmuInstance::handle_step_request(const SimProtocol::Message* msg, flatbuffers::FlatBufferBuilder& builder) {
+    if (!is_step_request(msg)) return false;
+
+    try {
+        pending_blobs_.clear();
+        builder.Clear();
+        step(msg, builder);
+        return true;
+
+    } catch (const std::exception& e) {
+        async_log(LogCategory::Step, "Error during step: {}", e.what());
+        return false;
+    }
+}
+
+bool FmuInstance::post(const uint8_t* data, size_t len) {
+    if (!mailbox_.push(data, len)) {
+        async_log(LogCategory::Step, "Mailbox of instance {} full, request dropped", instance_id_);
+        return false;
+    }
+    return true;
+}
+
+bool FmuInstance::poll_mailbox(QuicConnection& connection) {
+    while (const auto* msg = mailbox_.front()) {
+        bool ok = true;
+        if (is_step_request(msg)) {
+            latencies_.record(kReceive, mailbox_.front_received_at(), PhaseLatencies::now());
+            ok = handle_step_request(msg, connection);
+        } else if (const auto* map = msg->message_type_as_SlotMap()) {
+            apply_slot_map(map);
+        }
+        mailbox_.pop();
+        if (!ok) return false;
+    }
+    return true;
+}
+
+void FmuInstance::prepare_simulation() {
+    // Partition variables by type so each step makes one batched call per type
+    for (const auto& cache : variable_cache_) {
+        if (!cache.is_input() && !cache.is_output()) continue;
+        auto& refs = [&]() -> std::vector<cosim::value_reference>& {
+            switch (cache.type) {
+                case SimProtocol::ValueType_Real:
+                    return cache.is_output() ? reals_.output_refs : reals_.input_refs;
+                case SimProtocol::ValueType_Boolean:
+                    return cache.is_output() ? booleans_.output_refs : booleans_.input_refs;
+                case SimProtocol::ValueType_String:
+                    return cache.is_output() ? strings_.output_refs : strings_.input_refs;
+                case SimProtocol::ValueType_Binary:
+                    return cache.is_output() ? binaries_.output_refs : binaries_.input_refs;
+                default:
+                    return cache.is_output() ? integers_.output_refs : integers_.input_refs;
+            }
+        }();
+        refs.push_back(cache.reference);
+    }
+
+    reals_.allocate();
+    integers_.allocate();
+    booleans_.allocate();
+    strings_.allocate();
+    binaries_.allocate();
+    held_blobs_.reserve(binaries_.input_refs.size());
+    pending_blobs_.reserve(binaries_.output_refs.size());
+    sent_strings_ = std::make_unique<std::string[]>(strings_.output_refs.size());
+
+    // String values are assigned in place; reserve so values up to kStringCapacity never reallocate
+    for (size_t i = 0; i < strings_.input_refs.size(); ++i) strings_.input_values[i].reserve(kStringCapacity);
+    for (size_t i = 0; i < strings_.output_refs.size(); ++i) {
+        strings_.output_values[i].reserve(kStringCapacity);
+        sent_strings_[i].reserve(kStringCapacity);
+    }
+    string_refs_.reserve(strings_.output_refs.size());
+    string_offsets_.reserve(strings_.output_refs.size());
+
+    output_offsets_.reserve(reals_.output_refs.size() + integers_.output_refs.size() +
+                            booleans_.output_refs.size() + strings_.output_refs.size());
+}
+
+void FmuInstance::push_string_input(cosim::value_reference ref, std::string_view value) {
+    if (strings_.input_count == strings_.input_refs.size()) return;
+
+    // Assign in place so the string keeps its capacity across steps
+    strings_.input_refs[strings_.input_count] = ref;
+    strings_.input_values[strings_.input_count].assign(value.data(), value.size());
+    ++strings_.input_count;
+}
+
+void FmuInstance::push_string_input(cosim::value_reference ref, const flatbuffers::String* value) {
+    push_string_input(ref, value ? std::string_view(value->c_str(), value->size()) : std::string_view());
+}
+
+bool FmuInstance::take_changed_string(size_t index) {
+    // Strings are the only outputs with a variable-size payload; send them only on change
+    const auto& value = strings_.output_values[index];
+    if (value == sent_strings_[index]) return false;
+    sent_strings_[index].assign(value);
+    return true;
+}
+
+void FmuInstance::advance(uint64_t timestep_us) {
+    auto start = PhaseLatencies::now();
+    const auto step_size = cosim::to_duration(timestep_us / 1e6);
+    if (!unit_->do_step(current_time_, step_size)) {
+        throw std::runtime_error("Step failed for instance " + std::to_string(instance_id_));
+    }
+    current_time_ += step_size;
+    start = latencies_.lap(kDoStep, start);
+
+    if (!reals_.output_refs.empty()) {
+        unit_->get_real_variables(reals_.output_refs_span(), reals_.output_values_span());
+    }
+    if (!integers_.output_refs.empty()) {
+        unit_->get_integer_variables(integers_.output_refs_span(), integers_.output_values_span());
+    }
+    if (!booleans_.output_refs.empty()) {
+        unit_->get_boolean_variables(booleans_.output_refs_span(), booleans_.output_values_span());
+    }
+    if (!strings_.output_refs.empty()) {
+        unit_->get_string_variables(strings_.output_refs_span(), strings_.output_values_span());
+    }
+    if (!binaries_.output_refs.empty()) {
+        unit_->get_binary_variables(binaries_.output_refs_span(), binaries_.output_values_span());
+    }
+    latencies_.lap(kGetOutputs, start);
+}
+
+void FmuInstance::step(const SimProtocol::Message* msg, flatbuffers::FlatBufferBuilder& builder) {
+    // The previous step is done with its binary inputs
+    held_blobs_.clear();
+
+    if (const auto* request = msg->message_type_as_StepRequestV2()) {
+        step(request, builder);
+    } else if (const auto* request = msg->message_type_as_StepRequest()) {
+        step(request, builder);
+    }
+}
+
+void FmuInstance::step(const SimProtocol::StepRequest* request, flatbuffers::FlatBufferBuilder& builder) {
+    auto start = PhaseLatencies::now();
+
+    // Scatter inputs into the per-type arrays
+    reals_.input_count = 0;
+    integers_.input_count = 0;
+    booleans_.input_count = 0;
+    strings_.input_count = 0;
+    if (const auto* inputs = request->inputs()) {
+        for (const auto* input : *inputs) {
+            switch (input->value_type()) {
+                case SimProtocol::ValueType_Real:
+                    reals_.push_input(input->value_reference(), input->real_value());
+                    break;
+                case SimProtocol::ValueType_Integer:
+                    integers_.push_input(input->value_reference(), input->integer_value());
+                    break;
+                case SimProtocol::ValueType_Boolean:
+                    booleans_.push_input(input->value_reference(), input->boolean_value());
+                    break;
+                case SimProtocol::ValueType_String:
+                    push_string_input(input->value_reference(), input->string_value());
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // One batched call per type
+    if (reals_.input_count > 0) {
+        unit_->set_real_variables(reals_.input_refs_span(), reals_.input_values_span());
+    }
+    if (integers_.input_count > 0) {
+        unit_->set_integer_variables(integers_.input_refs_span(), integers_.input_values_span());
+    }
+    if (booleans_.input_count > 0) {
+        unit_->set_boolean_variables(booleans_.input_refs_span(), booleans_.input_values_span());
+    }
+    if (strings_.input_count > 0) {
+        unit_->set_string_variables(strings_.input_refs_span(), strings_.input_values_span());
+    }
+    latencies_.lap(kSetInputs, start);
+
+    advance(request->timestep_us());
+
+    // Outputs are written grouped by type, so each type forms a contiguous run
+    start = PhaseLatencies::now();
+    output_offsets_.clear();
+    for (size_t i = 0; i < reals_.output_refs.size(); ++i) {
+        output_offsets_.push_back(SimProtocol::CreateVariable(
+            builder,
+            0,                            // name omitted, outputs are identified by reference
+            SimProtocol::ValueType_Real,  // value_type
+            reals_.output_refs[i],        // value_reference
+            reals_.output_values[i]       // real_value
+        ));
+    }
+    for (size_t i = 0; i < integers_.output_refs.size(); ++i) {
+        output_offsets_.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_Integer, integers_.output_refs[i],
+            0.0, integers_.output_values[i]));
+    }
+    for (size_t i = 0; i < booleans_.output_refs.size(); ++i) {
+        output_offsets_.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_Boolean, booleans_.output_refs[i],
+            0.0, 0, booleans_.output_values[i]));
+    }
+    for (size_t i = 0; i < strings_.output_refs.size(); ++i) {
+        if (!take_changed_string(i)) continue;
+        auto string_value = builder.CreateString(strings_.output_values[i]);
+        output_offsets_.push_back(SimProtocol::CreateVariable(
+            builder, 0, SimProtocol::ValueType_String, strings_.output_refs[i],
+            0.0, 0, false, string_value));
+    }
+
+    auto response = SimProtocol::CreateStepResponse(
+        builder,
+        builder.CreateVector(output_offsets_.data(), output_offsets_.size()),
+        request->instance_id());
+
+    auto message = SimProtocol::CreateMessage(
+        builder,
+        SimProtocol::MessageType_StepResponse,
+        response.Union());
+
+    builder.Finish(message);
+    latencies_.lap(kBuild, start);
+}
+
+void FmuInstance::apply_inputs(const SimProtocol::SignalVector* inputs) {
+    if (!inputs) return;
+
+    // Reference and value vectors of a type must pair up
+    auto count = [](const flatbuffers::Vector<uint32_t>* refs, size_t values) -> size_t {
+        size_t n = refs ? refs->size() : 0;
+        if (n != values) throw std::runtime_error("Reference and value counts differ in step request");
+        return n;
+    };
+
+    // Real, integer and boolean values without references follow the slot map
+    auto refs_of = [this, &count](SimProtocol::ValueType type, const flatbuffers::Vector<uint32_t>* refs,
+                                  size_t values) -> const uint32_t* {
+        if (refs || values == 0) return count(refs, values) > 0 ? refs->data() : nullptr;
+        if (!positional_ || map_inputs_[type].size() != values) {
+            throw std::runtime_error("Step request does not match the slot map");
+        }
+        return map_inputs_[type].data();
+    };
+
+    // Reals and integers are handed to the FMU straight from the receive buffer
+    size_t reals = inputs->real_values() ? inputs->real_values()->size() : 0;
+    if (const uint32_t* refs = refs_of(SimProtocol::ValueType_Real, inputs->real_refs(), reals)) {
+        unit_->set_real_variables({refs, reals}, {inputs->real_values()->data(), reals});
+    }
+    size_t integers = inputs->integer_values() ? inputs->integer_values()->size() : 0;
+    if (const uint32_t* refs = refs_of(SimProtocol::ValueType_Integer, inputs->integer_refs(), integers)) {
+        unit_->set_integer_variables({refs, integers}, {inputs->integer_values()->data(), integers});
+    }
+
+    booleans_.input_count = 0;
+    size_t booleans = inputs->boolean_values() ? inputs->boolean_values()->size() : 0;
+    if (const uint32_t* refs = refs_of(SimProtocol::ValueType_Boolean, inputs->boolean_refs(), booleans)) {
+        for (size_t i = 0; i < booleans; ++i) booleans_.push_input(refs[i], inputs->boolean_values()->Get(i) != 0);
+    }
+    if (booleans_.input_count > 0) {
+        unit_->set_boolean_variables(booleans_.input_refs_span(), booleans_.input_values_span());
+    }
+
+    strings_.input_count = 0;
+    if (const auto* offsets = inputs->string_offsets()) {
+        // A local client's strings stay in the server's pool until this request is answered
+        size_t strings = string_pool_ ? count(inputs->string_refs(), offsets->size()) : 0;
+        for (size_t i = 0; i < strings; ++i) {
+            push_string_input(inputs->string_refs()->Get(i), string_pool_->view(offsets->Get(i)));
+        }
+    } else {
+        size_t strings = count(inputs->string_refs(), inputs->string_values() ? inputs->string_values()->size() : 0);
+        for (size_t i = 0; i < strings; ++i) {
+            push_string_input(inputs->string_refs()->Get(i), inputs->string_values()->Get(i));
+        }
+    }
+    if (strings_.input_count > 0) {
+        unit_->set_string_variables(strings_.input_refs_span(), strings_.input_values_span());
+    }
+
+    binaries_.input_count = 0;
+    size_t binaries = count(inputs->binary_refs(), inputs->binary_values() ? inputs->binary_values()->size() : 0);
+    for (size_t i = 0; i < binaries; ++i) {
+        binaries_.push_input(inputs->binary_refs()->Get(i), resolve_blob(*inputs->binary_values()->Get(i)));
+    }
+    if (binaries_.input_count > 0) {
+        unit_->set_binary_variables(binaries_.input_refs_span(), binaries_.input_values_span());
+    }
+}
+
+BinaryView FmuInstance::resolve_blob(const SimProtocol::BlobRef& ref) {
+    if (ref.blob_id() != 0) {
+        auto blob = assembler_ ? assembler_->take(ref.blob_id()) : nullptr;
+        if (!blob) throw std::runtime_error("Blob " + std::to_string(ref.blob_id()) + " has not arrived");
+        held_blobs_.push_back(blob);
+        return {blob->data(), blob->size()};
+    }
+
+    // Nothing produced yet
+    if (ref.offset() == 0) return {};
+
+    auto* store = peer_store(ref.store());
+    BinaryView value = store ? store->view(ref.offset(), ref.size()) : BinaryView{};
+    if (!value.data) {
+        throw std::runtime_error("No value at offset " + std::to_string(ref.offset()) +
+                                 " of blob store " + std::to_string(ref.store()));
+    }
+    return value;
+}
+
+SharedBlobStore* FmuInstance::peer_store(uint32_t store_id) {
+    auto it = peer_stores_.find(store_id);
+    if (it != peer_stores_.end()) return &it->second;
+    if (!segment_) return nullptr;
+
+    void* region = find_region(*segment_, "blob_store_" + std::to_string(store_id));
+    if (!region) return nullptr;
+    SharedBlobStore store(region);
+    if (!store.valid()) return nullptr;
+    return &peer_stores_.emplace(store_id, store).first->second;
+}
+
+SimProtocol::BlobRef FmuInstance::share_blob(BinaryView value) {
+    auto size = static_cast<uint32_t>(value.size);
+    if (blob_store_) {
+        uint32_t offset = blob_store_->write(value);
+        if (offset == SharedBlobStore::kNoSlot) {
+            throw std::runtime_error("Binary output of " + std::to_string(value.size) +
+                                     " bytes exceeds the blob slot size");
+        }
+        return SimProtocol::BlobRef(0, store_id_, offset, size);
+    }
+
+    // Ids are unique per instance; 0 means "not a blob"
+    if (++blob_count_ == 0) blob_count_ = 1;
+    uint64_t id = static_cast<uint64_t>(instance_id_) << 32 | blob_count_;
+    pending_blobs_.push_back({id, value});
+    return SimProtocol::BlobRef(id, 0, 0, size);
+}
+
+flatbuffers::Offset<SimProtocol::SignalVector> FmuInstance::write_outputs(flatbuffers::FlatBufferBuilder& builder,
+                                                                           bool with_binaries) {
+    // Fixed-size outputs are copied as whole arrays; with the slot map only
+    // the connected ones are sent, by position
+    using RefVector = flatbuffers::Offset<flatbuffers::Vector<uint32_t>>;
+    RefVector real_refs, integer_refs, boolean_refs;
+    flatbuffers::Offset<flatbuffers::Vector<double>> real_values;
+    flatbuffers::Offset<flatbuffers::Vector<int>> integer_values;
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> boolean_values;
+    if (positional_) {
+        real_values = gather<double>(builder, output_positions_[SimProtocol::ValueType_Real], reals_.output_values.get());
+        integer_values = gather<int>(builder, output_positions_[SimProtocol::ValueType_Integer],
+                                     integers_.output_values.get());
+        boolean_values = gather<uint8_t>(builder, output_positions_[SimProtocol::ValueType_Boolean],
+                                         booleans_.output_values.get());
+    } else {
+        real_refs = builder.CreateVector(reals_.output_refs);
+        real_values = builder.CreateVector(reals_.output_values.get(), reals_.output_refs.size());
+        integer_refs = builder.CreateVector(integers_.output_refs);
+        integer_values = builder.CreateVector(integers_.output_values.get(), integers_.output_refs.size());
+        boolean_refs = builder.CreateVector(booleans_.output_refs);
+        uint8_t* boolean_data = nullptr;
+        boolean_values = builder.CreateUninitializedVector(booleans_.output_refs.size(), &boolean_data);
+        for (size_t i = 0; i < booleans_.output_refs.size(); ++i) {
+            boolean_data[i] = booleans_.output_values[i] ? 1 : 0;
+        }
+    }
+
+    string_refs_.clear();
+    string_offsets_.clear();
+    for (size_t i = 0; i < strings_.output_refs.size(); ++i) {
+        if (!take_changed_string(i)) continue;
+        string_refs_.push_back(strings_.output_refs[i]);
+        string_offsets_.push_back(builder.CreateString(strings_.output_values[i]));
+    }
+    auto string_refs = builder.CreateVector(string_refs_);
+    auto string_values = builder.CreateVector(string_offsets_);
+
+    // Binary outputs need a blob store (local) or a connection to send them on (QUIC)
+    size_t binaries = with_binaries && (blob_store_ || !request_ring_) ? binaries_.output_refs.size() : 0;
+    auto binary_refs = builder.CreateVector(binaries_.output_refs.data(), binaries);
+    SimProtocol::BlobRef* blob_refs = nullptr;
+    auto binary_values = builder.CreateUninitializedVectorOfStructs(binaries, &blob_refs);
+    for (size_t i = 0; i < binaries; ++i) {
+        blob_refs[i] = share_blob(binaries_.output_values[i]);
+    }
+
+    return SimProtocol::CreateSignalVector(
+        builder,
+        real_refs, real_values,
+        integer_refs, integer_values,
+        boolean_refs, boolean_values,
+        string_refs, string_values,
+        binary_refs, binary_values);
+}
+
+void FmuInstance::step(const SimProtocol::StepRequestV2* request, flatbuffers::FlatBufferBuilder& builder) {
+    auto start = PhaseLatencies::now();
+    apply_inputs(request->inputs());
+    latencies_.lap(kSetInputs, start);
+    advance(request->timestep_us());
+
+    // A batched request runs its remaining steps back-to-back, without a round trip each
+    step_outputs_.clear();
+    if (const auto* trajectory = request->trajectory()) {
+        for (const auto* entry : *trajectory) {
+            // Binary values of intermediate steps are not kept by the FMU, so only the last step's are sent
+            if (request->all_outputs()) step_outputs_.push_back(write_outputs(builder, false));
+            start = PhaseLatencies::now();
+            apply_inputs(entry->inputs());
+            latencies_.lap(kSetInputs, start);
+            advance(entry->timestep_us());
+        }
+    }
+
+    start = PhaseLatencies::now();
+    auto outputs = write_outputs(builder);
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SimProtocol::SignalVector>>> step_outputs;
+    if (!step_outputs_.empty()) step_outputs = builder.CreateVector(step_outputs_);
+
+    auto response = SimProtocol::CreateStepResponseV2(builder, request->instance_id(), outputs, step_outputs,
+                                                      positional_ ? map_epoch_ : 0);
+    builder.Finish(SimProtocol::CreateMessage(
+        builder,
+        SimProtocol::MessageType_StepResponseV2,
+        response.Union()));
+    latencies_.lap(kBuild, start);
+}
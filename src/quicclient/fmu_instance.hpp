@@ -0,0 +1,232 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cosim/time.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include "simulation_protocol_generated.h"
+#include "common/blob_store.hpp"
+#include "common/blob_transfer.hpp"
+#include "common/latency.hpp"
+#include "common/network.hpp"
+#include "common/protocol.hpp"
+#include "common/send_pool.hpp"
+#include "common/shm_transport.hpp"
+#include "common/string_pool.hpp"
+#include "common/variable_table.hpp"
+#include "simulation_unit.hpp"
+
+// One FMU slave or sub-system hosted by a client process, with everything
+// its step path touches: variable arrays, response buffers and, for local
+// clients, its own shared-memory rings. Instances share nothing, so a host
+// steps them in parallel.
+class FmuInstance {
+private:
+    uint32_t instance_id_;
+
+    // The FMU or sub-system stepped by this instance
+    std::unique_ptr<SimulationUnit> unit_;
+
+    // Responses are built in place in pooled buffers and sent without copying
+    SendPool send_pool_;
+    MessageCompressor compressor_;
+
+    // Requests handed over from the MsQuic callback, which only lends its
+    // receive buffer for the duration of the callback
+    MessageMailbox mailbox_;
+
+    // Shared-memory transport, used instead of QUIC by local clients
+    std::unique_ptr<SharedMessageRing> request_ring_;
+    std::unique_ptr<SharedMessageWriter> response_writer_;
+
+    // Variable table of the unit, sent to the server once when it agrees on a slot map
+    std::vector<SignalVariable> variable_cache_;
+
+    // Slot map from the server: the references of the real, integer and
+    // boolean inputs in request order, those of the connected outputs in
+    // response order and their positions in the output arrays. Set once the
+    // map is complete, values travel without references. A reconfigured
+    // server sends a new map under the next routing epoch; responses name the
+    // epoch of the map their values follow.
+    SlotMapRefs map_inputs_;
+    SlotMapRefs map_outputs_;
+    std::array<std::vector<uint32_t>, 3> output_positions_;
+    bool positional_ = false;
+    uint32_t map_epoch_ = 0;
+    uint32_t receiving_epoch_ = 0;
+
+    // Step-path arrays of one variable type, sized once in prepare_simulation().
+    // Inputs are gathered into a prefix of input_refs/input_values each step.
+    template <typename T>
+    struct TypedVariables {
+        std::vector<cosim::value_reference> input_refs;
+        std::unique_ptr<T[]> input_values;
+        size_t input_count = 0;
+        std::vector<cosim::value_reference> output_refs;
+        std::unique_ptr<T[]> output_values;
+
+        void allocate() {
+            input_values = std::make_unique<T[]>(input_refs.size());
+            output_values = std::make_unique<T[]>(output_refs.size());
+        }
+
+        // Queues an input for this step; extra entries beyond the input count are ignored
+        void push_input(cosim::value_reference ref, const T& value) {
+            if (input_count == input_refs.size()) return;
+            input_refs[input_count] = ref;
+            input_values[input_count] = value;
+            ++input_count;
+        }
+
+        gsl::span<const cosim::value_reference> input_refs_span() const { return {input_refs.data(), input_count}; }
+        gsl::span<const T> input_values_span() const { return {input_values.get(), input_count}; }
+        gsl::span<const cosim::value_reference> output_refs_span() const { return {output_refs.data(), output_refs.size()}; }
+        gsl::span<T> output_values_span() { return {output_values.get(), output_refs.size()}; }
+    };
+    TypedVariables<double> reals_;
+    TypedVariables<int> integers_;
+    TypedVariables<bool> booleans_;
+    TypedVariables<std::string> strings_;
+    TypedVariables<BinaryView> binaries_;
+
+    // String outputs as last sent; unchanged strings are left out of the response
+    std::unique_ptr<std::string[]> sent_strings_;
+
+    // Capacity reserved for every string input and output; longer values allocate when they first arrive
+    static constexpr size_t kStringCapacity = 1024;
+
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>> output_offsets_;
+
+    // Changed string outputs of a v2 response
+    std::vector<cosim::value_reference> string_refs_;
+    std::vector<flatbuffers::Offset<flatbuffers::String>> string_offsets_;
+
+    // Outputs of the intermediate steps of a batched request
+    std::vector<flatbuffers::Offset<SimProtocol::SignalVector>> step_outputs_;
+
+    // Binary inputs from QUIC arrive as chunks ahead of the request; the
+    // blobs are held until the next step, as the FMU reads them in place
+    BlobAssembler* assembler_ = nullptr;
+    std::vector<std::shared_ptr<const Blob>> held_blobs_;
+
+    // Binary outputs of a QUIC response, copied chunk by chunk out of the
+    // FMU's memory into pooled buffers and sent ahead of it
+    struct PendingBlob {
+        uint64_t id;
+        BinaryView value;
+    };
+    std::vector<PendingBlob> pending_blobs_;
+    BlobSender blob_sender_;
+    uint32_t blob_count_ = 0;
+
+    // Shared blob stores of a local client: its own, written with its binary
+    // outputs, and those of its peers, read in place
+    boost::interprocess::managed_shared_memory* segment_ = nullptr;
+    uint32_t store_id_ = 0;
+    std::unique_ptr<SharedBlobStore> blob_store_;
+    std::map<uint32_t, SharedBlobStore> peer_stores_;
+
+    // The server's string pool, from which a local client reads its string inputs by offset
+    std::unique_ptr<SharedStringPool> string_pool_;
+
+    cosim::time_point current_time_;
+
+    // Step path phases, timed per instance
+    enum Phase : size_t { kReceive, kSetInputs, kDoStep, kGetOutputs, kBuild, kSend };
+    PhaseLatencies latencies_;
+
+    // Pre-allocate all needed resources
+    void prepare_simulation();
+
+    // Applies the inputs, steps the FMU and serializes the outputs into
+    // `builder`, answering in the protocol version of the request
+    void step(const SimProtocol::Message* msg, flatbuffers::FlatBufferBuilder& builder);
+    void step(const SimProtocol::StepRequest* request, flatbuffers::FlatBufferBuilder& builder);
+    void step(const SimProtocol::StepRequestV2* request, flatbuffers::FlatBufferBuilder& builder);
+
+    // Steps the unit and reads all outputs into the per-type arrays
+    void advance(uint64_t timestep_us);
+
+    // Hands the inputs of a v2 request to the unit
+    void apply_inputs(const SimProtocol::SignalVector* inputs);
+
+    // Serializes the current outputs as a SignalVector; binary outputs only if `with_binaries`
+    flatbuffers::Offset<SimProtocol::SignalVector> write_outputs(flatbuffers::FlatBufferBuilder& builder,
+                                                                 bool with_binaries = true);
+
+    // Bytes of a binary input, from a received blob or a peer's blob store
+    BinaryView resolve_blob(const SimProtocol::BlobRef& ref);
+
+    // Publishes a binary output to the own blob store, or queues it for sending
+    SimProtocol::BlobRef share_blob(BinaryView value);
+
+    SharedBlobStore* peer_store(uint32_t store_id);
+
+    // Copies a string input into the next slot of strings_
+    void push_string_input(cosim::value_reference ref, std::string_view value);
+    void push_string_input(cosim::value_reference ref, const flatbuffers::String* value);
+
+    // True if string output `index` changed since it was last sent; marks it as sent
+    bool take_changed_string(size_t index);
+
+    // Answers a TraceRequest over the local response ring with the spans of this process
+    bool send_local_trace(uint32_t instance_id);
+
+    // Sends the variable table over the local response ring
+    bool send_local_variable_table();
+
+    // Next free slot of the local response ring, or nullptr if the server
+    // has not drained it within a few seconds
+    flatbuffers::FlatBufferBuilder* wait_for_response_slot();
+
+    // Adds a SlotMap message to the map; the last one makes values positional.
+    // The first message of a new epoch drops the map held until then.
+    void apply_slot_map(const SimProtocol::SlotMap* map);
+
+public:
+    FmuInstance(uint32_t instance_id, std::unique_ptr<SimulationUnit> unit, size_t buffer_size = 256 * 1024);
+
+    FmuInstance(const FmuInstance&) = delete;
+    FmuInstance& operator=(const FmuInstance&) = delete;
+
+    uint32_t id() const { return instance_id_; }
+    bool loaded() const { return unit_ != nullptr; }
+
+    // Every variable of the unit as the protocol addresses it
+    const std::vector<SignalVariable>& variable_table() const { return variable_cache_; }
+
+    // Compress QUIC responses above `threshold` bytes; 0 turns compression off
+    void set_compression_threshold(uint32_t threshold) { compressor_.set_threshold(threshold); }
+
+    // Source of the blobs that binary inputs over QUIC refer to
+    void set_blob_assembler(BlobAssembler* assembler) { assembler_ = assembler; }
+
+    // Attach to the rings the server created for client `client_id`
+    bool attach_local(boost::interprocess::managed_shared_memory& segment, uint32_t client_id);
+
+    // True when a request is waiting in the mailbox or the local request ring
+    bool has_request() const {
+        return mailbox_.front() != nullptr || (request_ring_ && request_ring_->front() != nullptr);
+    }
+
+    // Handle all step requests waiting in the local request ring
+    bool poll_local();
+
+    // Handle a step request of either version and send the response over `connection`
+    bool handle_step_request(const SimProtocol::Message* msg, QuicConnection& connection);
+
+    // Handle a step request of either version, leaving the response in
+    // `builder` instead of sending it. Binary outputs are not kept.
+    bool handle_step_request(const SimProtocol::Message* msg, flatbuffers::FlatBufferBuilder& builder);
+
+    // Copies a received message into the mailbox. Called from the MsQuic
+    // callback only; fails if the step thread lags a full mailbox behind.
+    bool post(const uint8_t* data, size_t len);
+
+    // Handle all requests and slot maps waiting in the mailbox, answering over `connection`
+    bool poll_mailbox(QuicConnection& connection);
+};
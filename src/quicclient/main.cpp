@@ -1,30 +1,104 @@
 #include "client.hpp"
+#include "replay.hpp"
+#include "common/latency.hpp"
+#include "common/signals.hpp"
 #include <iostream>
 #include <string>
 #include <thread>
 #include <chrono>
+#include <memory>
+
+static bool is_config_file(const std::string& path) {
+    auto ends_with = [&path](const std::string& suffix) {
+        return path.size() >= suffix.size() &&
+               path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return ends_with(".yaml") || ends_with(".yml");
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <path_to_fmu>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <path_to_fmu> [local_client_id]" << std::endl;
+        std::cerr << "       " << argv[0] << " <config.yaml> <host_name> [local]" << std::endl;
+        std::cerr << "       " << argv[0]
+                  << " --replay <config.yaml> <client_id> <results.qsr> [--steps=N] [--compare[=tolerance]]"
+                  << std::endl;
         return 1;
     }
 
-    std::string fmu_path = argv[1];
+    std::string path = argv[1];
     
     try {
-        QuicClient client(fmu_path);
+        // Replays recorded inputs into one FMU, without server or network
+        if (path == "--replay") {
+            if (argc < 5) {
+                std::cerr << "Missing configuration, client id or result file" << std::endl;
+                return 1;
+            }
+            ReplayOptions options;
+            options.config_path = argv[2];
+            options.client_id = static_cast<uint32_t>(std::stoul(argv[3]));
+            options.record_path = argv[4];
+            for (int i = 5; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg.rfind("--steps=", 0) == 0) {
+                    options.max_steps = std::stoull(arg.substr(8));
+                } else if (arg == "--compare") {
+                    options.compare = true;
+                } else if (arg.rfind("--compare=", 0) == 0) {
+                    options.compare = true;
+                    options.tolerance = std::stod(arg.substr(10));
+                } else {
+                    std::cerr << "Unknown option " << arg << std::endl;
+                    return 1;
+                }
+            }
+            return run_replay(options);
+        }
+
+        // SIGUSR1 prints the step latencies, SIGINT ends the run
+        watch_signals();
+
+        // A configuration file hosts all instances listed for the named host
+        bool host_mode = is_config_file(path);
+        if (host_mode && argc < 3) {
+            std::cerr << "Missing host name" << std::endl;
+            return 1;
+        }
+        auto client = host_mode
+            ? std::make_unique<QuicClient>(path, std::string(argv[2]))
+            : std::make_unique<QuicClient>(path);
+
+        // A client id, or `local` for a host, selects the shared-memory transport
+        bool local = host_mode ? (argc > 3 && std::string(argv[3]) == "local") : argc > 2;
+        if (local) {
+            bool attached = host_mode
+                ? client->init_local()
+                : client->init_local(static_cast<uint32_t>(std::stoul(argv[2])));
+            if (!attached) {
+                std::cerr << "Failed to attach local client" << std::endl;
+                return 1;
+            }
+
+            while (!stop_requested() && client->poll_local()) {
+                if (take_report_request()) report_latencies();
+                std::this_thread::yield();
+            }
+            report_latencies();
+            return stop_requested() ? 0 : 1;
+        }
         
-        if (!client.init()) {
+        if (!client->init()) {
             std::cerr << "Failed to initialize client" << std::endl;
             return 1;
         }
 
-        // Main client loop
-        while (true) {
-            // Process messages and handle simulation steps
+        // Main client loop; the step thread serves the requests
+        while (!stop_requested()) {
+            if (take_report_request()) report_latencies();
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
+        report_latencies();
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
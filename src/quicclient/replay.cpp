@@ -0,0 +1,223 @@
+#include "replay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "common/fmu_cache.hpp"
+#include "common/latency.hpp"
+#include "common/record_reader.hpp"
+#include "common/variable_table.hpp"
+#include "fmu_instance.hpp"
+
+namespace {
+
+// A recorded column with all its samples
+struct Trajectory {
+    std::string name;
+    uint32_t reference = 0;
+    SimProtocol::ValueType type = SimProtocol::ValueType_Real;
+    uint32_t every = 1;
+    std::vector<double> reals;
+    std::vector<int32_t> integers;
+    std::vector<uint8_t> booleans;
+    int index = -1;  // Of the output in the response, found on the first step
+
+    void load(const RecordReader& reader, size_t column) {
+        const auto& info = reader.columns()[column];
+        every = info.every;
+        type = static_cast<SimProtocol::ValueType>(info.type);
+        if (type == SimProtocol::ValueType_Real) reals = reader.read<double>(column);
+        else if (type == SimProtocol::ValueType_Integer) integers = reader.read<int32_t>(column);
+        else booleans = reader.read<uint8_t>(column);
+    }
+
+    // Sample held at `row`
+    size_t held(uint64_t row) const { return static_cast<size_t>(row / every); }
+};
+
+int find_ref(const flatbuffers::Vector<uint32_t>* refs, uint32_t reference) {
+    if (!refs) return -1;
+    for (uint32_t i = 0; i < refs->size(); ++i) {
+        if (refs->Get(i) == reference) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+}  // namespace
+
+int run_replay(const ReplayOptions& options) {
+    YAML::Node config = YAML::LoadFile(options.config_path);
+    YAML::Node client;
+    for (const auto& entry : config["clients"]) {
+        if (entry["id"].as<uint32_t>() == options.client_id) client.reset(entry);
+    }
+    if (!client) throw std::runtime_error("No client " + std::to_string(options.client_id) + " in " + options.config_path);
+    if (client["subsystem"]) throw std::runtime_error("Replay of sub-system clients is not supported");
+    std::string fmu_path = client["fmu_path"].as<std::string>();
+
+    FmuCache cache(config["fmu_cache"].as<std::string>(""));
+    cache.unpacked(fmu_path);
+    auto model = cache.model_description(fmu_path);
+    FmuInstance instance(options.client_id,
+                         std::make_unique<SlaveUnit>(cache.import(fmu_path), "replay" + std::to_string(options.client_id)));
+
+    RecordReader reader(options.record_path);
+    if (reader.row_count() < 2) throw std::runtime_error(options.record_path + " holds fewer than two steps");
+
+    // Inputs follow the recorded outputs they are connected to
+    std::vector<Trajectory> inputs;
+    for (const auto& conn : config["connections"]) {
+        if (conn["to"]["client"].as<uint32_t>() != options.client_id) continue;
+        std::string variable = conn["to"]["variable"].as<std::string>();
+        std::string source = conn["from"]["client"].as<std::string>() + "." + conn["from"]["variable"].as<std::string>();
+        int column = reader.find(source);
+        if (column < 0) {
+            std::cerr << "Input " << variable << " keeps its start value, " << source << " was not recorded" << std::endl;
+            continue;
+        }
+        auto it = std::find_if(model->variables.begin(), model->variables.end(),
+                               [&](const cosim::variable_description& var) { return var.name == variable; });
+        if (it == model->variables.end()) throw std::runtime_error("No variable " + variable + " in " + fmu_path);
+        if (value_type(it->type) != static_cast<SimProtocol::ValueType>(reader.columns()[column].type)) {
+            throw std::runtime_error("Input " + variable + " and recorded " + source + " differ in type");
+        }
+        Trajectory input;
+        input.name = variable;
+        input.reference = it->reference;
+        input.load(reader, static_cast<size_t>(column));
+        inputs.push_back(std::move(input));
+    }
+
+    // Recorded outputs of this client, for the comparison
+    std::vector<Trajectory> outputs;
+    if (options.compare) {
+        for (size_t c = 0; c < reader.columns().size(); ++c) {
+            const auto& info = reader.columns()[c];
+            if (info.client_id != options.client_id) continue;
+            Trajectory output;
+            output.name = info.name;
+            output.reference = info.reference;
+            output.load(reader, c);
+            outputs.push_back(std::move(output));
+        }
+        if (outputs.empty()) std::cerr << "No outputs of client " << options.client_id << " were recorded" << std::endl;
+    }
+
+    std::vector<int64_t> times;
+    for (uint64_t chunk = 0; chunk < reader.chunk_count(); ++chunk) {
+        auto view = reader.times(chunk);
+        times.insert(times.end(), view.begin(), view.end());
+    }
+    uint64_t steps = times.size() - 1;
+    if (options.max_steps > 0) steps = std::min(steps, options.max_steps);
+
+    // Requests are built up front, so the timed loop runs only the step path.
+    // Step k applies the inputs of row k and advances to the time of row k+1.
+    std::vector<uint8_t> requests;
+    std::vector<size_t> offsets;
+    {
+        flatbuffers::FlatBufferBuilder builder(4096);
+        std::vector<uint32_t> real_refs, integer_refs, boolean_refs;
+        std::vector<double> real_values;
+        std::vector<int32_t> integer_values;
+        std::vector<uint8_t> boolean_values;
+        for (uint64_t row = 0; row < steps; ++row) {
+            real_refs.clear(); integer_refs.clear(); boolean_refs.clear();
+            real_values.clear(); integer_values.clear(); boolean_values.clear();
+            for (const auto& input : inputs) {
+                size_t sample = input.held(row);
+                if (input.type == SimProtocol::ValueType_Real) {
+                    real_refs.push_back(input.reference);
+                    real_values.push_back(input.reals[sample]);
+                } else if (input.type == SimProtocol::ValueType_Integer) {
+                    integer_refs.push_back(input.reference);
+                    integer_values.push_back(input.integers[sample]);
+                } else {
+                    boolean_refs.push_back(input.reference);
+                    boolean_values.push_back(input.booleans[sample]);
+                }
+            }
+
+            builder.Clear();
+            auto signals = SimProtocol::CreateSignalVector(
+                builder, builder.CreateVector(real_refs), builder.CreateVector(real_values),
+                builder.CreateVector(integer_refs), builder.CreateVector(integer_values),
+                builder.CreateVector(boolean_refs), builder.CreateVector(boolean_values));
+            auto timestep = static_cast<uint64_t>(std::max<int64_t>(0, times[row + 1] - times[row]));
+            auto request = SimProtocol::CreateStepRequestV2(builder, timestep, options.client_id, signals);
+            builder.Finish(SimProtocol::CreateMessage(builder, SimProtocol::MessageType_StepRequestV2, request.Union()));
+
+            // Finished buffers are a multiple of 8 bytes long, so each one stays aligned
+            offsets.push_back(requests.size());
+            requests.insert(requests.end(), builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+        }
+    }
+
+    std::cout << "Replaying " << steps << " steps of client " << options.client_id << " with " << inputs.size()
+              << " recorded inputs" << std::endl;
+
+    flatbuffers::FlatBufferBuilder response(256 * 1024);
+    std::chrono::steady_clock::duration stepping{};
+    uint64_t done = 0;
+    uint64_t checked = 0;
+    uint64_t mismatches = 0;
+    for (; done < steps; ++done) {
+        const auto* msg = SimProtocol::GetMessage(requests.data() + offsets[done]);
+        auto start = std::chrono::steady_clock::now();
+        bool stepped = instance.handle_step_request(msg, response);
+        stepping += std::chrono::steady_clock::now() - start;
+        if (!stepped) {
+            std::cerr << "Step " << done << " failed" << std::endl;
+            break;
+        }
+        if (outputs.empty()) continue;
+
+        // The response holds the outputs the recording shows one row later
+        const auto* values = SimProtocol::GetMessage(response.GetBufferPointer())
+                                 ->message_type_as_StepResponseV2()->outputs();
+        uint64_t row = done + 1;
+        for (auto& output : outputs) {
+            if (row % output.every != 0 || !values) continue;
+            size_t sample = output.held(row);
+            double expected = 0, actual = 0;
+            bool match = true;
+            if (output.type == SimProtocol::ValueType_Real) {
+                if (output.index < 0) output.index = find_ref(values->real_refs(), output.reference);
+                if (output.index < 0) continue;
+                expected = output.reals[sample];
+                actual = values->real_values()->Get(static_cast<uint32_t>(output.index));
+                match = std::abs(actual - expected) <= options.tolerance * std::max(1.0, std::abs(expected));
+            } else if (output.type == SimProtocol::ValueType_Integer) {
+                if (output.index < 0) output.index = find_ref(values->integer_refs(), output.reference);
+                if (output.index < 0) continue;
+                expected = output.integers[sample];
+                actual = values->integer_values()->Get(static_cast<uint32_t>(output.index));
+                match = actual == expected;
+            } else {
+                if (output.index < 0) output.index = find_ref(values->boolean_refs(), output.reference);
+                if (output.index < 0) continue;
+                expected = output.booleans[sample];
+                actual = values->boolean_values()->Get(static_cast<uint32_t>(output.index));
+                match = actual == expected;
+            }
+            ++checked;
+            if (!match && ++mismatches <= 10) {
+                std::cerr << "Mismatch at t=" << times[row] << " us: " << output.name << " is " << actual
+                          << ", recorded " << expected << std::endl;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(stepping).count();
+    std::cout << "Replayed " << done << " steps in " << seconds << " s: "
+              << (seconds > 0 ? static_cast<double>(done) / seconds : 0.0) << " steps/s" << std::endl;
+    if (options.compare) {
+        std::cout << mismatches << " of " << checked << " recorded output samples differ" << std::endl;
+    }
+    report_latencies(std::cout);
+    return done == steps && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Replays the inputs one client received in a recorded run into a single
+// instance of its FMU, without server or network, to measure the FMU alone.
+// Inputs are read from the recorder columns of the outputs connected to
+// them; a decimated column holds its last sample in between.
+struct ReplayOptions {
+    std::string config_path;
+    uint32_t client_id = 0;
+    std::string record_path;
+    uint64_t max_steps = 0;    // 0 replays every recorded step
+    bool compare = false;      // Check the outputs against the recording
+    double tolerance = 1e-9;   // Relative, for real outputs
+};
+
+// Returns the process exit code: 0, or 1 on errors and output mismatches
+int run_replay(const ReplayOptions& options);
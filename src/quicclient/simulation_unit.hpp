@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gsl/span>
+#include <cosim/fmi/fmu.hpp>
+#include <cosim/model_description.hpp>
+#include <cosim/time.hpp>
+#include "common/blob.hpp"
+#include "common/osmp.hpp"
+
+// What an FmuInstance steps: a single FMU slave or a whole sub-system of
+// FMUs. The model description lists the variables exposed to the server,
+// addressed by their value references.
+class SimulationUnit {
+public:
+    virtual ~SimulationUnit() = default;
+
+    virtual std::shared_ptr<const cosim::model_description> model_description() const = 0;
+
+    // Prepares the unit for stepping from `start`
+    virtual void setup(cosim::time_point start) = 0;
+
+    // Advances from `current` by `step`; false if the step did not complete
+    virtual bool do_step(cosim::time_point current, cosim::duration step) = 0;
+
+    virtual void set_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const double> values) = 0;
+    virtual void set_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const int> values) = 0;
+    virtual void set_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const bool> values) = 0;
+    virtual void set_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const std::string> values) = 0;
+
+    virtual void get_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<double> values) = 0;
+    virtual void get_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<int> values) = 0;
+    virtual void get_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<bool> values) = 0;
+    virtual void get_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<std::string> values) = 0;
+
+    // Binary variables, addressed by the reference of their lo component.
+    // Units without any keep these defaults.
+    virtual std::vector<BinaryVariable> binary_variables() const { return {}; }
+    virtual void set_binary_variables(gsl::span<const cosim::value_reference>, gsl::span<const BinaryView>) {
+        throw std::runtime_error("Unit has no binary variables");
+    }
+    // The views stay valid until the unit is called again
+    virtual void get_binary_variables(gsl::span<const cosim::value_reference>, gsl::span<BinaryView>) {
+        throw std::runtime_error("Unit has no binary variables");
+    }
+};
+
+// One FMU slave, driven directly
+class SlaveUnit : public SimulationUnit {
+private:
+    std::shared_ptr<cosim::fmi::fmu> fmu_;
+    std::shared_ptr<cosim::fmi::slave_instance> slave_;
+
+    // OSMP binary variables by lo reference, and scratch for their integer components
+    std::map<cosim::value_reference, BinaryVariable> binaries_;
+    std::vector<cosim::value_reference> component_refs_;
+    std::vector<int> component_values_;
+
+    const BinaryVariable& binary(cosim::value_reference ref) const {
+        auto it = binaries_.find(ref);
+        if (it == binaries_.end()) throw std::runtime_error("No binary variable " + std::to_string(ref));
+        return it->second;
+    }
+
+    void gather_components(gsl::span<const cosim::value_reference> refs) {
+        component_refs_.clear();
+        for (auto ref : refs) {
+            const auto& var = binary(ref);
+            component_refs_.push_back(var.lo);
+            component_refs_.push_back(var.hi);
+            component_refs_.push_back(var.size);
+        }
+        component_values_.resize(component_refs_.size());
+    }
+
+public:
+    SlaveUnit(std::shared_ptr<cosim::fmi::fmu> fmu, const std::string& instance_name)
+        : fmu_(std::move(fmu))
+        , slave_(fmu_->instantiate_slave(instance_name)) {
+        for (auto& var : ::binary_variables(*fmu_->model_description())) {
+            binaries_.emplace(var.lo, std::move(var));
+        }
+    }
+
+    std::shared_ptr<const cosim::model_description> model_description() const override {
+        return fmu_->model_description();
+    }
+
+    void setup(cosim::time_point start) override {
+        slave_->setup(start, std::nullopt, std::nullopt);
+        slave_->start_simulation();
+    }
+
+    bool do_step(cosim::time_point current, cosim::duration step) override {
+        return slave_->do_step(current, step) == cosim::step_result::complete;
+    }
+
+    void set_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const double> values) override {
+        slave_->set_real_variables(refs, values);
+    }
+    void set_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const int> values) override {
+        slave_->set_integer_variables(refs, values);
+    }
+    void set_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const bool> values) override {
+        slave_->set_boolean_variables(refs, values);
+    }
+    void set_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const std::string> values) override {
+        slave_->set_string_variables(refs, values);
+    }
+
+    void get_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<double> values) override {
+        slave_->get_real_variables(refs, values);
+    }
+    void get_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<int> values) override {
+        slave_->get_integer_variables(refs, values);
+    }
+    void get_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<bool> values) override {
+        slave_->get_boolean_variables(refs, values);
+    }
+    void get_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<std::string> values) override {
+        slave_->get_string_variables(refs, values);
+    }
+
+    std::vector<BinaryVariable> binary_variables() const override {
+        std::vector<BinaryVariable> variables;
+        for (const auto& entry : binaries_) variables.push_back(entry.second);
+        return variables;
+    }
+
+    // The FMU reads each value through the pointer during the next step
+    void set_binary_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const BinaryView> values) override {
+        gather_components(refs);
+        for (size_t i = 0; i < static_cast<size_t>(refs.size()); ++i) {
+            auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(values[i].data));
+            component_values_[3 * i] = static_cast<int>(static_cast<uint32_t>(address));
+            component_values_[3 * i + 1] = static_cast<int>(static_cast<uint32_t>(address >> 32));
+            component_values_[3 * i + 2] = static_cast<int>(values[i].size);
+        }
+        slave_->set_integer_variables(component_refs_, component_values_);
+    }
+
+    void get_binary_variables(gsl::span<const cosim::value_reference> refs, gsl::span<BinaryView> values) override {
+        gather_components(refs);
+        slave_->get_integer_variables(component_refs_, component_values_);
+        for (size_t i = 0; i < static_cast<size_t>(refs.size()); ++i) {
+            uint64_t address = static_cast<uint32_t>(component_values_[3 * i]) |
+                               static_cast<uint64_t>(static_cast<uint32_t>(component_values_[3 * i + 1])) << 32;
+            values[i].data = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(address));
+            values[i].size = static_cast<size_t>(static_cast<uint32_t>(component_values_[3 * i + 2]));
+        }
+    }
+};
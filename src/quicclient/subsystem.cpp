@@ -0,0 +1,118 @@
+#include "subsystem.hpp"
+#include <stdexcept>
+
+Subsystem::Subsystem(const SubsystemConfig& config,
+                     const std::vector<std::shared_ptr<cosim::fmi::fmu>>& fmus,
+                     const std::string& instance_name)
+    : algorithm_(std::make_shared<cosim::fixed_step_algorithm>(cosim::to_duration(config.step_size)))
+    , overrides_(std::make_shared<cosim::override_manipulator>())
+    , observer_(std::make_shared<cosim::last_value_observer>()) {
+
+    std::vector<std::shared_ptr<const cosim::model_description>> models;
+    for (size_t i = 0; i < config.members.size(); ++i) {
+        std::string name = instance_name + "." + config.members[i].name;
+        slaves_.emplace_back(name, fmus[i]->instantiate_slave(name));
+        models.push_back(fmus[i]->model_description());
+    }
+
+    // Members are added to the execution in this order, so member i is simulator i
+    for (const auto& conn : config.connections) {
+        const auto& from = SubsystemConfig::find_variable(*models[conn.from.member], conn.from.variable);
+        const auto& to = SubsystemConfig::find_variable(*models[conn.to.member], conn.to.variable);
+        connections_.emplace_back(
+            cosim::variable_id{static_cast<cosim::simulator_index>(conn.from.member), from.type, from.reference},
+            cosim::variable_id{static_cast<cosim::simulator_index>(conn.to.member), to.type, to.reference});
+    }
+
+    auto ports = config.resolve_ports(models);
+    for (const auto& port : ports) {
+        ports_.push_back({static_cast<cosim::simulator_index>(port.member), port.variable.reference});
+    }
+    description_ = config.boundary_description(ports);
+}
+
+void Subsystem::setup(cosim::time_point start) {
+    execution_ = std::make_unique<cosim::execution>(start, algorithm_);
+    for (size_t i = 0; i < slaves_.size(); ++i) {
+        auto index = execution_->add_slave(slaves_[i].second, slaves_[i].first);
+        if (index != static_cast<cosim::simulator_index>(i)) {
+            throw std::logic_error("Unexpected simulator index for " + slaves_[i].first);
+        }
+    }
+    execution_->add_manipulator(overrides_);
+    execution_->add_observer(observer_);
+    for (const auto& conn : connections_) {
+        execution_->connect_variables(conn.first, conn.second);
+    }
+}
+
+bool Subsystem::do_step(cosim::time_point current, cosim::duration step) {
+    // Internal steps until the group reaches the end of the server's step. A
+    // server step that is not a multiple of the internal step ends on the
+    // first internal step past it.
+    const auto target = current + step;
+    while (execution_->current_time() < target) {
+        execution_->step();
+    }
+    return true;
+}
+
+void Subsystem::set_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const double> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        overrides_->override_real_variable(p.simulator, p.reference, values[i]);
+    }
+}
+
+void Subsystem::set_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const int> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        overrides_->override_integer_variable(p.simulator, p.reference, values[i]);
+    }
+}
+
+void Subsystem::set_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const bool> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        overrides_->override_boolean_variable(p.simulator, p.reference, values[i]);
+    }
+}
+
+void Subsystem::set_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const std::string> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        overrides_->override_string_variable(p.simulator, p.reference, values[i]);
+    }
+}
+
+void Subsystem::get_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<double> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        observer_->get_real(p.simulator, gsl::span<const cosim::value_reference>(&p.reference, 1),
+                            gsl::span<double>(&values[i], 1));
+    }
+}
+
+void Subsystem::get_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<int> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        observer_->get_integer(p.simulator, gsl::span<const cosim::value_reference>(&p.reference, 1),
+                               gsl::span<int>(&values[i], 1));
+    }
+}
+
+void Subsystem::get_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<bool> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        observer_->get_boolean(p.simulator, gsl::span<const cosim::value_reference>(&p.reference, 1),
+                               gsl::span<bool>(&values[i], 1));
+    }
+}
+
+void Subsystem::get_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<std::string> values) {
+    for (size_t i = 0; i < refs.size(); ++i) {
+        const auto& p = port(refs[i]);
+        observer_->get_string(p.simulator, gsl::span<const cosim::value_reference>(&p.reference, 1),
+                              gsl::span<std::string>(&values[i], 1));
+    }
+}
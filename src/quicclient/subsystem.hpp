@@ -0,0 +1,59 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cosim/algorithm/fixed_step_algorithm.hpp>
+#include <cosim/execution.hpp>
+#include <cosim/fmi/fmu.hpp>
+#include <cosim/manipulator/override_manipulator.hpp>
+#include <cosim/observer/last_value_observer.hpp>
+#include "common/subsystem_config.hpp"
+#include "simulation_unit.hpp"
+
+// A group of FMUs run by a libcosim execution with the fixed-step
+// algorithm. Internal connections are resolved by libcosim every internal
+// step; only the boundary ports are set and read from outside, through an
+// override manipulator and a last-value observer.
+class Subsystem : public SimulationUnit {
+private:
+    struct Port {
+        cosim::simulator_index simulator;
+        cosim::value_reference reference;
+    };
+
+    std::vector<Port> ports_;  // indexed by boundary value reference
+    std::shared_ptr<const cosim::model_description> description_;
+
+    // Members in simulator-index order and the internal connections between them
+    std::vector<std::pair<std::string, std::shared_ptr<cosim::fmi::slave_instance>>> slaves_;
+    std::vector<std::pair<cosim::variable_id, cosim::variable_id>> connections_;
+
+    std::shared_ptr<cosim::fixed_step_algorithm> algorithm_;
+    std::shared_ptr<cosim::override_manipulator> overrides_;
+    std::shared_ptr<cosim::last_value_observer> observer_;
+    std::unique_ptr<cosim::execution> execution_;
+
+    const Port& port(cosim::value_reference ref) const { return ports_.at(ref); }
+
+public:
+    // `fmus` holds the imported FMU of every member, in member order
+    Subsystem(const SubsystemConfig& config,
+              const std::vector<std::shared_ptr<cosim::fmi::fmu>>& fmus,
+              const std::string& instance_name);
+
+    std::shared_ptr<const cosim::model_description> model_description() const override { return description_; }
+
+    void setup(cosim::time_point start) override;
+    bool do_step(cosim::time_point current, cosim::duration step) override;
+
+    void set_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const double> values) override;
+    void set_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const int> values) override;
+    void set_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const bool> values) override;
+    void set_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<const std::string> values) override;
+
+    void get_real_variables(gsl::span<const cosim::value_reference> refs, gsl::span<double> values) override;
+    void get_integer_variables(gsl::span<const cosim::value_reference> refs, gsl::span<int> values) override;
+    void get_boolean_variables(gsl::span<const cosim::value_reference> refs, gsl::span<bool> values) override;
+    void get_string_variables(gsl::span<const cosim::value_reference> refs, gsl::span<std::string> values) override;
+};
@@ -0,0 +1,105 @@
+#include "input_profile.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "common/record_reader.hpp"
+
+namespace {
+
+// Client and reference of the output that writes `slot`, or false if none does
+bool source_of(const RoutingTable& routing, SimProtocol::ValueType type, uint32_t slot,
+               uint32_t& client_id, uint32_t& reference) {
+    for (const auto& entry : routing.all_routes()) {
+        for (const auto& binding : entry.second.outputs[type]) {
+            if (binding.slot != slot) continue;
+            client_id = entry.first;
+            reference = binding.reference;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+InputProfile::InputProfile(const std::string& path, uint32_t client_id, const RoutingTable& routing) {
+    RecordReader reader(path);
+    for (uint64_t chunk = 0; chunk < reader.chunk_count(); ++chunk) {
+        auto view = reader.times(chunk);
+        times_.insert(times_.end(), view.begin(), view.end());
+    }
+    if (times_.empty()) throw std::runtime_error(path + " holds no recorded steps");
+
+    const auto* routes = routing.routes(client_id);
+    if (!routes) return;
+    for (auto type : {SimProtocol::ValueType_Real, SimProtocol::ValueType_Integer, SimProtocol::ValueType_Boolean}) {
+        for (const auto& binding : routes->inputs[type]) {
+            uint32_t source = 0;
+            uint32_t reference = 0;
+            if (!source_of(routing, type, binding.slot, source, reference)) continue;
+
+            const auto& columns = reader.columns();
+            auto column = std::find_if(columns.begin(), columns.end(), [&](const RecordReader::Column& c) {
+                return c.client_id == source && c.reference == reference &&
+                       static_cast<SimProtocol::ValueType>(c.type) == type;
+            });
+            if (column == columns.end()) continue;
+
+            size_t index = static_cast<size_t>(column - columns.begin());
+            Input input{binding.reference, type, std::max<uint32_t>(1, column->every), {}, {}, {}};
+            if (type == SimProtocol::ValueType_Real) input.reals = reader.read<double>(index);
+            else if (type == SimProtocol::ValueType_Integer) input.integers = reader.read<int32_t>(index);
+            else input.booleans = reader.read<uint8_t>(index);
+            inputs_.push_back(std::move(input));
+        }
+    }
+
+    real_refs_.reserve(inputs_.size());
+    integer_refs_.reserve(inputs_.size());
+    boolean_refs_.reserve(inputs_.size());
+    real_values_.reserve(inputs_.size());
+    integer_values_.reserve(inputs_.size());
+    boolean_values_.reserve(inputs_.size());
+}
+
+size_t InputProfile::row_at(uint64_t time_us) const {
+    auto it = std::upper_bound(times_.begin(), times_.end(), static_cast<int64_t>(time_us));
+    return it == times_.begin() ? 0 : static_cast<size_t>(it - times_.begin() - 1);
+}
+
+flatbuffers::Offset<SimProtocol::SignalVector> InputProfile::inputs_at(flatbuffers::FlatBufferBuilder& builder,
+                                                                       uint64_t time_us) {
+    real_refs_.clear();
+    integer_refs_.clear();
+    boolean_refs_.clear();
+    real_values_.clear();
+    integer_values_.clear();
+    boolean_values_.clear();
+
+    const size_t row = row_at(time_us);
+    for (const auto& input : inputs_) {
+        // A shorter column, as of a file still being written, holds its last sample
+        auto sample = [&input, row](size_t count) { return std::min(row / input.every, count - 1); };
+        if (input.type == SimProtocol::ValueType_Real) {
+            if (input.reals.empty()) continue;
+            real_refs_.push_back(input.reference);
+            real_values_.push_back(input.reals[sample(input.reals.size())]);
+        } else if (input.type == SimProtocol::ValueType_Integer) {
+            if (input.integers.empty()) continue;
+            integer_refs_.push_back(input.reference);
+            integer_values_.push_back(input.integers[sample(input.integers.size())]);
+        } else {
+            if (input.booleans.empty()) continue;
+            boolean_refs_.push_back(input.reference);
+            boolean_values_.push_back(input.booleans[sample(input.booleans.size())]);
+        }
+    }
+
+    auto real_refs = builder.CreateVector(real_refs_);
+    auto real_values = builder.CreateVector(real_values_);
+    auto integer_refs = builder.CreateVector(integer_refs_);
+    auto integer_values = builder.CreateVector(integer_values_);
+    auto boolean_refs = builder.CreateVector(boolean_refs_);
+    auto boolean_values = builder.CreateVector(boolean_values_);
+    return SimProtocol::CreateSignalVector(builder, real_refs, real_values, integer_refs, integer_values,
+                                           boolean_refs, boolean_values);
+}
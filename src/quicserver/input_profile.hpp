@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "simulation_protocol_generated.h"
+#include "routing.hpp"
+
+// Future inputs of a batched client, read from the result file of an earlier
+// run. A connected real, integer or boolean input follows the recorded
+// column of the output it is connected to; inputs whose source was not
+// recorded hold over the batch. A decimated column holds its last sample in
+// between, and past the last row every input holds its last value.
+class InputProfile {
+private:
+    struct Input {
+        uint32_t reference;
+        SimProtocol::ValueType type;
+        uint32_t every;
+        std::vector<double> reals;
+        std::vector<int32_t> integers;
+        std::vector<uint8_t> booleans;
+    };
+
+    std::vector<int64_t> times_;  // Simulated time of every recorded row
+    std::vector<Input> inputs_;   // Reals, then integers, then booleans
+
+    // Per-request values, reused across requests
+    std::vector<uint32_t> real_refs_, integer_refs_, boolean_refs_;
+    std::vector<double> real_values_;
+    std::vector<int32_t> integer_values_;
+    std::vector<uint8_t> boolean_values_;
+
+    // Last row recorded at or before `time_us`
+    size_t row_at(uint64_t time_us) const;
+
+public:
+    // Loads the columns feeding the inputs of `client_id` under `routing`.
+    // Throws std::runtime_error if the file is not a result file.
+    InputProfile(const std::string& path, uint32_t client_id, const RoutingTable& routing);
+
+    // Number of inputs the recording covers
+    size_t size() const { return inputs_.size(); }
+
+    // The covered inputs as they were at simulated time `time_us`, with references
+    flatbuffers::Offset<SimProtocol::SignalVector> inputs_at(flatbuffers::FlatBufferBuilder& builder, uint64_t time_us);
+};
@@ -0,0 +1,225 @@
+#include "local_runner.hpp"
+#include <yaml-cpp/yaml.h>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "common/async_log.hpp"
+#include "common/fmu_cache.hpp"
+#include "common/phase_timer.hpp"
+#include "plan_compiler.hpp"
+
+LocalRunner::LocalRunner(const std::string& config_path)
+    : current_time_(cosim::to_time_point(0.0)) {
+
+    PhaseTimer timer;
+    try {
+        // Load configuration, or the run plan compiled from it
+        std::unique_ptr<RunPlan> plan;
+        YAML::Node config;
+        if (RunPlan::is_plan(config_path)) {
+            plan = std::make_unique<RunPlan>(config_path);
+            config = plan->settings();
+        } else {
+            config = YAML::LoadFile(config_path);
+        }
+
+        pool_ = std::make_unique<ThreadPool>(
+            config["server"]["worker_threads"].as<size_t>(0));
+        end_time_us_ = static_cast<uint64_t>(config["server"]["end_time"].as<double>(0.0) * 1e6);
+        FmuCache cache(config["fmu_cache"].as<std::string>(""));
+
+        // One slave instance per configured client, local or remote alike
+        std::vector<std::string> fmu_paths;
+        std::vector<std::string> distinct_paths;
+        for (const auto& client : config["clients"]) {
+            Instance instance;
+            instance.client_id = client["id"].as<uint32_t>();
+            if (client["subsystem"]) {
+                throw std::runtime_error("client " + std::to_string(instance.client_id) +
+                                         " is a sub-system, which runs only in a client host");
+            }
+            fmu_paths.push_back(client["fmu_path"].as<std::string>());
+            if (std::find(distinct_paths.begin(), distinct_paths.end(), fmu_paths.back()) == distinct_paths.end()) {
+                distinct_paths.push_back(fmu_paths.back());
+            }
+            instances_.push_back(std::move(instance));
+        }
+        timer.mark("config");
+
+        // Each distinct FMU is unpacked once; every instance imports and
+        // instantiates its own copy, so these phases run fully in parallel
+        pool_->parallel_for(distinct_paths.size(), [&](size_t i) {
+            cache.unpacked(distinct_paths[i]);
+        });
+        if (plan) {
+            for (const auto& path : distinct_paths) plan->check_fmu(path, cache.hash(path));
+        }
+        timer.mark("unpack");
+
+        pool_->parallel_for(instances_.size(), [&](size_t i) {
+            instances_[i].fmu = cache.import(fmu_paths[i]);
+        });
+        timer.mark("import");
+
+        pool_->parallel_for(instances_.size(), [this](size_t i) {
+            auto& instance = instances_[i];
+            instance.slave = instance.fmu->instantiate_slave(
+                "client_" + std::to_string(instance.client_id));
+        });
+        timer.mark("instantiate");
+
+        for (const auto& instance : instances_) {
+            catalog_.add(instance.client_id, instance.fmu->model_description());
+        }
+
+        if (plan) {
+            load_plan_routes(*plan, routing_);
+            routed_ = true;
+        } else {
+            connections_ = signal_connections(config["connections"]);
+        }
+        timer.report("Local simulation");
+
+    } catch (const std::exception& e) {
+        instances_.clear();
+        std::cerr << "Error loading local simulation: " << e.what() << std::endl;
+    }
+}
+
+bool LocalRunner::init() {
+    if (instances_.empty()) {
+        std::cerr << "No FMUs loaded" << std::endl;
+        return false;
+    }
+
+    auto resolve = [this](uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) {
+        return catalog_.resolve(client_id, name, info);
+    };
+
+    if (!routed_ && !routing_.build(connections_, resolve)) {
+        return false;
+    }
+    if (routing_.slot_count(SimProtocol::ValueType_Binary) > 0) {
+        std::cerr << "Binary connections need the client-server mode" << std::endl;
+        return false;
+    }
+
+    try {
+        for (auto& instance : instances_) {
+            if (const auto* routes = routing_.routes(instance.client_id)) {
+                instance.real_inputs.bind(routes->inputs[SimProtocol::ValueType_Real]);
+                instance.real_outputs.bind(routes->outputs[SimProtocol::ValueType_Real]);
+                instance.integer_inputs.bind(routes->inputs[SimProtocol::ValueType_Integer]);
+                instance.integer_outputs.bind(routes->outputs[SimProtocol::ValueType_Integer]);
+                instance.boolean_inputs.bind(routes->inputs[SimProtocol::ValueType_Boolean]);
+                instance.boolean_outputs.bind(routes->outputs[SimProtocol::ValueType_Boolean]);
+                instance.string_inputs.bind(routes->inputs[SimProtocol::ValueType_String]);
+                instance.string_outputs.bind(routes->outputs[SimProtocol::ValueType_String]);
+            }
+        }
+
+        // FMUs initialize independently of each other
+        pool_->parallel_for(instances_.size(), [this](size_t i) {
+            auto& slave = *instances_[i].slave;
+            slave.setup(current_time_, std::nullopt, std::nullopt);
+            slave.start_simulation();
+            write_outputs(instances_[i]);
+        });
+
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing local simulation: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void LocalRunner::read_inputs(Instance& instance) {
+    auto& slave = *instance.slave;
+
+    auto& reals = instance.real_inputs;
+    if (!reals.refs.empty()) {
+        const double* slots = routing_.real_slots();
+        for (size_t i = 0; i < reals.refs.size(); ++i) reals.values[i] = slots[reals.slots[i]];
+        slave.set_real_variables(reals.ref_span(), reals.value_span());
+    }
+
+    auto& integers = instance.integer_inputs;
+    if (!integers.refs.empty()) {
+        const int32_t* slots = routing_.integer_slots();
+        for (size_t i = 0; i < integers.refs.size(); ++i) integers.values[i] = slots[integers.slots[i]];
+        slave.set_integer_variables(integers.ref_span(), integers.value_span());
+    }
+
+    auto& booleans = instance.boolean_inputs;
+    if (!booleans.refs.empty()) {
+        const uint8_t* slots = routing_.boolean_slots();
+        for (size_t i = 0; i < booleans.refs.size(); ++i) booleans.values[i] = slots[booleans.slots[i]] != 0;
+        slave.set_boolean_variables(booleans.ref_span(), booleans.value_span());
+    }
+
+    auto& strings = instance.string_inputs;
+    if (!strings.refs.empty()) {
+        const std::string* slots = routing_.string_slots();
+        for (size_t i = 0; i < strings.refs.size(); ++i) strings.values[i] = slots[strings.slots[i]];
+        slave.set_string_variables(strings.ref_span(), strings.value_span());
+    }
+}
+
+void LocalRunner::write_outputs(Instance& instance) {
+    const auto& slave = *instance.slave;
+
+    auto& reals = instance.real_outputs;
+    if (!reals.refs.empty()) {
+        slave.get_real_variables(reals.ref_span(), reals.value_span());
+        double* slots = routing_.real_slots();
+        for (size_t i = 0; i < reals.refs.size(); ++i) slots[reals.slots[i]] = reals.values[i];
+    }
+
+    auto& integers = instance.integer_outputs;
+    if (!integers.refs.empty()) {
+        slave.get_integer_variables(integers.ref_span(), integers.value_span());
+        int32_t* slots = routing_.integer_slots();
+        for (size_t i = 0; i < integers.refs.size(); ++i) slots[integers.slots[i]] = integers.values[i];
+    }
+
+    auto& booleans = instance.boolean_outputs;
+    if (!booleans.refs.empty()) {
+        slave.get_boolean_variables(booleans.ref_span(), booleans.value_span());
+        uint8_t* slots = routing_.boolean_slots();
+        for (size_t i = 0; i < booleans.refs.size(); ++i) slots[booleans.slots[i]] = booleans.values[i] ? 1 : 0;
+    }
+
+    auto& strings = instance.string_outputs;
+    if (!strings.refs.empty()) {
+        slave.get_string_variables(strings.ref_span(), strings.value_span());
+        std::string* slots = routing_.string_slots();
+        for (size_t i = 0; i < strings.refs.size(); ++i) slots[strings.slots[i]] = strings.values[i];
+    }
+}
+
+bool LocalRunner::step(uint64_t timestep_us) {
+    const auto step_size = cosim::to_duration(timestep_us / 1e6);
+
+    try {
+        // Every FMU reads the outputs of the previous step before any slot is
+        // overwritten, so the two phases run as separate parallel loops.
+        pool_->parallel_for(instances_.size(), [&](size_t i) {
+            auto& instance = instances_[i];
+            read_inputs(instance);
+            if (instance.slave->do_step(current_time_, step_size) != cosim::step_result::complete) {
+                throw std::runtime_error("Step failed for client " + std::to_string(instance.client_id));
+            }
+        });
+
+        pool_->parallel_for(instances_.size(), [this](size_t i) {
+            write_outputs(instances_[i]);
+        });
+
+        current_time_ += step_size;
+        elapsed_us_ += timestep_us;
+        return true;
+    } catch (const std::exception& e) {
+        async_log(LogCategory::Step, "Error during local step: {}", e.what());
+        return false;
+    }
+}
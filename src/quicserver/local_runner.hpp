@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cosim/fmi/fmu.hpp>
+#include <cosim/time.hpp>
+#include "common/thread_pool.hpp"
+#include "model_catalog.hpp"
+#include "routing.hpp"
+
+// Single-process execution: every FMU listed under `clients:` is loaded into
+// this process as its own slave instance and stepped on a worker pool.
+// Signals move by direct reads and writes of the routing table, with no IPC
+// and no serialization.
+class LocalRunner {
+private:
+    // Value references and values of one type for one direction
+    template <typename T>
+    struct Port {
+        std::vector<cosim::value_reference> refs;
+        std::vector<uint32_t> slots;
+        std::unique_ptr<T[]> values;
+
+        void bind(const std::vector<RoutingTable::Binding>& bindings) {
+            for (const auto& binding : bindings) {
+                refs.push_back(binding.reference);
+                slots.push_back(binding.slot);
+            }
+            values = std::make_unique<T[]>(refs.size());
+        }
+
+        gsl::span<const cosim::value_reference> ref_span() const { return {refs.data(), refs.size()}; }
+        gsl::span<T> value_span() { return {values.get(), refs.size()}; }
+    };
+
+    struct Instance {
+        uint32_t client_id;
+        std::shared_ptr<cosim::fmi::fmu> fmu;
+        std::shared_ptr<cosim::fmi::slave_instance> slave;
+
+        Port<double> real_inputs, real_outputs;
+        Port<int> integer_inputs, integer_outputs;
+        Port<bool> boolean_inputs, boolean_outputs;
+        Port<std::string> string_inputs, string_outputs;
+    };
+
+    std::vector<Instance> instances_;
+    std::vector<RoutingTable::SignalConnection> connections_;
+    bool routed_ = false;  // Routes taken from a run plan, nothing left to resolve
+    ModelCatalog catalog_;
+    RoutingTable routing_;
+    std::unique_ptr<ThreadPool> pool_;
+    cosim::time_point current_time_;
+    uint64_t end_time_us_ = 0;
+    uint64_t elapsed_us_ = 0;
+
+    void read_inputs(Instance& instance);
+    void write_outputs(Instance& instance);
+
+public:
+    LocalRunner(const std::string& config_path);
+
+    // Instantiate all FMUs and resolve the connections
+    bool init();
+
+    // Single step of simulation for all FMUs
+    bool step(uint64_t timestep_us);
+
+    // True once the simulated time has reached `server.end_time`; never if it is 0
+    bool finished() const { return end_time_us_ != 0 && elapsed_us_ >= end_time_us_; }
+};
@@ -1,4 +1,7 @@
 #include "server.hpp"
+#include "plan_compiler.hpp"
+#include "common/latency.hpp"
+#include "common/signals.hpp"
 #include <iostream>
 #include <string>
 #include <thread>
@@ -6,13 +9,23 @@
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <config_path>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <config.yaml|run_plan.qplan>" << std::endl;
+        std::cerr << "       " << argv[0] << " --compile <config.yaml> <run_plan.qplan>" << std::endl;
         return 1;
     }
 
     std::string config_path = argv[1];
     
     try {
+        if (config_path == "--compile") {
+            if (argc < 4) {
+                std::cerr << "Missing configuration or run plan path" << std::endl;
+                return 1;
+            }
+            compile_run_plan(argv[2], argv[3]);
+            return 0;
+        }
+
         QuicServer server(config_path);
         
         if (!server.init()) {
@@ -20,18 +33,24 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        // Simple simulation loop
+        // Simple simulation loop; SIGUSR1 prints the step latencies, SIGHUP reloads
+        // the clients and connections, SIGINT ends the run
         uint64_t current_time_us = 0;
         const uint64_t step_size_us = 1000;  // 1ms steps
-        
-        while (true) {
+        watch_signals();
+
+        while (!stop_requested()) {
             if (!server.step(step_size_us)) {
                 std::cerr << "Simulation step failed" << std::endl;
                 break;
             }
             current_time_us += step_size_us;
+            if (take_report_request()) report_latencies();
+            if (take_reload_request()) server.reconfigure();
             std::this_thread::sleep_for(std::chrono::microseconds(step_size_us));
         }
+        report_latencies();
+        server.write_trace();
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,61 @@
+#include "model_catalog.hpp"
+
+void ModelCatalog::add(uint32_t client_id, const std::shared_ptr<const cosim::model_description>& model) {
+    tables_[client_id] = signal_variables(*model);
+    index(client_id);
+}
+
+void ModelCatalog::add(uint32_t client_id, std::vector<SignalVariable> variables) {
+    tables_[client_id] = std::move(variables);
+    index(client_id);
+}
+
+void ModelCatalog::index(uint32_t client_id) {
+    const auto& variables = tables_[client_id];
+    auto& names = names_[client_id];
+    names.clear();
+    names.reserve(variables.size());
+    // A name listed twice resolves to its first variable
+    for (size_t i = 0; i < variables.size(); ++i) names.emplace(variables[i].name, i);
+}
+
+bool ModelCatalog::resolve(uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) const {
+    auto names = names_.find(client_id);
+    if (names == names_.end()) return false;
+    auto entry = names->second.find(name);
+    if (entry == names->second.end()) return false;
+
+    const auto& var = tables_.at(client_id)[entry->second];
+    info.reference = var.reference;
+    info.type = var.type;
+    info.is_output = var.is_output();
+    return true;
+}
+
+std::string ModelCatalog::variable_name(uint32_t client_id, SimProtocol::ValueType type, uint32_t reference) const {
+    auto it = tables_.find(client_id);
+    if (it == tables_.end()) return {};
+    for (const auto& var : it->second) {
+        if (var.reference == reference && var.type == type) return var.name;
+    }
+    return {};
+}
+
+std::string ModelCatalog::mismatch(uint32_t client_id, const std::vector<SignalVariable>& variables) const {
+    auto it = tables_.find(client_id);
+    if (it == tables_.end()) return variables.empty() ? std::string() : variables.front().name;
+
+    // The order may differ, as binary variables are listed by name on one side and by reference on the other
+    std::map<std::string, const SignalVariable*> known;
+    for (const auto& var : it->second) known.emplace(var.name, &var);
+    for (const auto& var : variables) {
+        auto entry = known.find(var.name);
+        if (entry == known.end()) return var.name;
+        const auto& other = *entry->second;
+        if (other.reference != var.reference || other.type != var.type || other.causality != var.causality) {
+            return var.name;
+        }
+        known.erase(entry);
+    }
+    return known.empty() ? std::string() : known.begin()->first;
+}
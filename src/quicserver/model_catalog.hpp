@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cosim/model_description.hpp>
+#include "common/variable_table.hpp"
+#include "routing.hpp"
+
+// Variable tables of the configured clients, used to resolve the variable
+// names in `connections:` to value references and types. A table comes from
+// the model description the server reads, or from the client itself.
+class ModelCatalog {
+private:
+    std::map<uint32_t, std::vector<SignalVariable>> tables_;
+    // Position in the client's table of each variable name, for resolve()
+    std::map<uint32_t, std::unordered_map<std::string, size_t>> names_;
+
+    void index(uint32_t client_id);
+
+public:
+    void add(uint32_t client_id, const std::shared_ptr<const cosim::model_description>& model);
+    void add(uint32_t client_id, std::vector<SignalVariable> variables);
+
+    bool contains(uint32_t client_id) const { return tables_.count(client_id) != 0; }
+
+    // Registered table of a client, or nullptr
+    const std::vector<SignalVariable>* table(uint32_t client_id) const {
+        auto it = tables_.find(client_id);
+        return it != tables_.end() ? &it->second : nullptr;
+    }
+
+    // RoutingTable::Resolver over the registered tables
+    bool resolve(uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) const;
+
+    // Name of a client variable of `type` with `reference`, or an empty string
+    std::string variable_name(uint32_t client_id, SimProtocol::ValueType type, uint32_t reference) const;
+
+    // Name of the first variable in which `variables` and the registered
+    // table of the client differ, or an empty string if they agree
+    std::string mismatch(uint32_t client_id, const std::vector<SignalVariable>& variables) const;
+};
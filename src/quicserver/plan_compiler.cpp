@@ -0,0 +1,227 @@
+#include "plan_compiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <cosim/fs_portability.hpp>
+#include "common/phase_timer.hpp"
+#include "common/subsystem_config.hpp"
+#include "common/thread_pool.hpp"
+#include "model_catalog.hpp"
+
+namespace {
+
+using BindingVector = std::vector<RunPlanFormat::PlanBinding>;
+
+// Bindings of all types in one array, with the count of each type
+void flatten(const std::array<std::vector<RoutingTable::Binding>, RoutingTable::kTypeCount>& bindings,
+             BindingVector& flat, std::vector<uint32_t>& counts) {
+    for (const auto& typed : bindings) {
+        counts.push_back(static_cast<uint32_t>(typed.size()));
+        for (const auto& binding : typed) flat.emplace_back(binding.reference, binding.slot);
+    }
+}
+
+// Splits a flattened array back by type, checking every slot against the store size
+void unflatten(const flatbuffers::Vector<const RunPlanFormat::PlanBinding*>* flat,
+               const flatbuffers::Vector<uint32_t>* counts, const std::array<uint32_t, RoutingTable::kTypeCount>& slots,
+               std::array<std::vector<RoutingTable::Binding>, RoutingTable::kTypeCount>& bindings) {
+    if (!flat || !counts || counts->size() == 0) return;
+    if (counts->size() != RoutingTable::kTypeCount) throw std::runtime_error("Run plan has bindings of unknown types");
+    flatbuffers::uoffset_t next = 0;
+    for (size_t type = 0; type < RoutingTable::kTypeCount; ++type) {
+        uint32_t count = counts->Get(static_cast<flatbuffers::uoffset_t>(type));
+        if (count > flat->size() - next) throw std::runtime_error("Run plan has truncated bindings");
+        bindings[type].reserve(count);
+        for (uint32_t i = 0; i < count; ++i, ++next) {
+            const auto* binding = flat->Get(next);
+            if (binding->slot() >= slots[type]) throw std::runtime_error("Run plan binds a slot out of range");
+            bindings[type].push_back({binding->reference(), binding->slot()});
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<std::shared_ptr<const cosim::model_description>> client_models(const YAML::Node& clients,
+                                                                           FmuCache& cache) {
+    // The YAML is read up front; only the cache lookups run on the pool
+    struct Source {
+        uint32_t client_id;
+        std::string fmu_path;
+        std::optional<SubsystemConfig> subsystem;
+    };
+    std::vector<Source> sources;
+    for (const auto& client : clients) {
+        Source source{client["id"].as<uint32_t>(), {}, std::nullopt};
+        if (client["subsystem"]) {
+            source.subsystem = SubsystemConfig::parse(client["subsystem"]);
+        } else {
+            source.fmu_path = client["fmu_path"].as<std::string>();
+        }
+        sources.push_back(std::move(source));
+    }
+
+    // Cold caches import the FMUs, so look them up in parallel
+    std::vector<std::shared_ptr<const cosim::model_description>> models(sources.size());
+    ThreadPool pool;
+    pool.parallel_for(sources.size(), [&](size_t i) {
+        const auto& source = sources[i];
+        try {
+            if (source.subsystem) {
+                std::vector<std::shared_ptr<const cosim::model_description>> members;
+                for (const auto& member : source.subsystem->members) {
+                    members.push_back(cache.model_description(member.fmu_path));
+                }
+                models[i] = source.subsystem->boundary_description(source.subsystem->resolve_ports(members));
+            } else {
+                models[i] = cache.model_description(source.fmu_path);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "No model description for client " << source.client_id << ": " << e.what() << std::endl;
+        }
+    });
+    return models;
+}
+
+std::vector<RoutingTable::SignalConnection> signal_connections(const YAML::Node& connections) {
+    std::vector<RoutingTable::SignalConnection> result;
+    result.reserve(connections.size());
+    for (const auto& conn : connections) {
+        result.push_back({
+            conn["from"]["client"].as<uint32_t>(),
+            conn["from"]["variable"].as<std::string>(),
+            conn["to"]["client"].as<uint32_t>(),
+            conn["to"]["variable"].as<std::string>()
+        });
+    }
+    return result;
+}
+
+void compile_run_plan(const std::string& config_path, const std::string& plan_path) {
+    PhaseTimer timer;
+    YAML::Node config = YAML::LoadFile(config_path);
+    FmuCache cache(config["fmu_cache"].as<std::string>(""));
+
+    std::vector<uint32_t> client_ids;
+    std::vector<std::string> fmu_paths;
+    auto add_fmu = [&fmu_paths](const std::string& path) {
+        if (std::find(fmu_paths.begin(), fmu_paths.end(), path) == fmu_paths.end()) fmu_paths.push_back(path);
+    };
+    for (const auto& client : config["clients"]) {
+        client_ids.push_back(client["id"].as<uint32_t>());
+        if (client["subsystem"]) {
+            for (const auto& member : SubsystemConfig::parse(client["subsystem"]).members) add_fmu(member.fmu_path);
+        } else {
+            add_fmu(client["fmu_path"].as<std::string>());
+        }
+    }
+    timer.mark("config");
+
+    auto models = client_models(config["clients"], cache);
+    ModelCatalog catalog;
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (!models[i]) throw std::runtime_error("No variable table for client " + std::to_string(client_ids[i]));
+        catalog.add(client_ids[i], models[i]);
+    }
+    timer.mark("model descriptions");
+
+    auto connections = signal_connections(config["connections"]);
+    RoutingTable routing;
+    bool resolved = routing.build(connections,
+        [&catalog](uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) {
+            return catalog.resolve(client_id, name, info);
+        });
+    if (!resolved) throw std::runtime_error("The connections of " + config_path + " do not resolve");
+    timer.mark("routing");
+
+    flatbuffers::FlatBufferBuilder builder(1024 * 1024);
+    auto source = [&builder](const std::string& path, const std::string& hash) {
+        return RunPlanFormat::CreateSourceFile(builder, builder.CreateString(path),
+                                               static_cast<uint64_t>(cosim::filesystem::file_size(path)),
+                                               builder.CreateString(hash));
+    };
+    auto config_source = source(config_path, FmuCache::content_hash(config_path));
+    std::vector<flatbuffers::Offset<RunPlanFormat::SourceFile>> fmus;
+    for (const auto& path : fmu_paths) fmus.push_back(source(path, cache.hash(path)));
+
+    std::vector<flatbuffers::Offset<RunPlanFormat::ClientPlan>> clients;
+    BindingVector outputs, inputs;
+    std::vector<uint32_t> output_counts, input_counts;
+    for (size_t i = 0; i < client_ids.size(); ++i) {
+        outputs.clear();
+        inputs.clear();
+        output_counts.clear();
+        input_counts.clear();
+        if (const auto* routes = routing.routes(client_ids[i])) {
+            flatten(routes->outputs, outputs, output_counts);
+            flatten(routes->inputs, inputs, input_counts);
+        }
+        auto model = FmuCache::build_table(builder, *models[i]);
+        clients.push_back(RunPlanFormat::CreateClientPlan(
+            builder, client_ids[i], model,
+            builder.CreateVectorOfStructs(outputs), builder.CreateVector(output_counts),
+            builder.CreateVectorOfStructs(inputs), builder.CreateVector(input_counts)));
+    }
+
+    // Everything but the connections stays YAML; it is small and read as before
+    YAML::Node settings = YAML::Clone(config);
+    settings.remove("connections");
+    YAML::Emitter emitter;
+    emitter << settings;
+
+    std::vector<uint32_t> slot_counts;
+    for (size_t type = 0; type < RoutingTable::kTypeCount; ++type) {
+        slot_counts.push_back(static_cast<uint32_t>(routing.slot_count(static_cast<SimProtocol::ValueType>(type))));
+    }
+
+    builder.Finish(RunPlanFormat::CreateRunPlan(
+        builder, RunPlan::kFormatVersion, config_source, builder.CreateVector(fmus),
+        builder.CreateString(emitter.c_str()), builder.CreateVector(clients), builder.CreateVector(slot_counts)),
+        RunPlanFormat::RunPlanIdentifier());
+
+    // Written aside and renamed, so a starting server never maps a partial plan
+    std::string scratch = plan_path + ".tmp";
+    {
+        std::ofstream out(scratch, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                  static_cast<std::streamsize>(builder.GetSize()));
+        if (!out) throw std::runtime_error("Cannot write " + scratch);
+    }
+    cosim::filesystem::rename(scratch, plan_path);
+    timer.mark("write");
+    timer.report("Run plan");
+
+    std::cout << "Compiled " << config_path << " into " << plan_path << ": " << client_ids.size() << " clients, "
+              << connections.size() << " connections, " << fmu_paths.size() << " FMUs" << std::endl;
+}
+
+std::vector<std::shared_ptr<const cosim::model_description>> plan_models(const RunPlan& plan) {
+    std::vector<std::shared_ptr<const cosim::model_description>> models;
+    for (size_t i = 0; i < plan.plan().clients()->size(); ++i) models.push_back(plan.model(i));
+    return models;
+}
+
+void load_plan_routes(const RunPlan& plan, RoutingTable& routing) {
+    std::array<uint32_t, RoutingTable::kTypeCount> slots{};
+    if (const auto* counts = plan.plan().slot_counts()) {
+        if (counts->size() != RoutingTable::kTypeCount) throw std::runtime_error("Run plan has slots of unknown types");
+        for (size_t type = 0; type < slots.size(); ++type) slots[type] = counts->Get(static_cast<flatbuffers::uoffset_t>(type));
+    }
+
+    std::map<uint32_t, RoutingTable::ClientRoutes> routes;
+    for (const auto* client : *plan.plan().clients()) {
+        RoutingTable::ClientRoutes client_routes;
+        unflatten(client->outputs(), client->output_counts(), slots, client_routes.outputs);
+        unflatten(client->inputs(), client->input_counts(), slots, client_routes.inputs);
+
+        // As after build(), only clients taking part in a connection have routes
+        bool connected = false;
+        for (size_t type = 0; type < RoutingTable::kTypeCount; ++type) {
+            connected = connected || !client_routes.outputs[type].empty() || !client_routes.inputs[type].empty();
+        }
+        if (connected) routes.emplace(client->client_id(), std::move(client_routes));
+    }
+    routing.assign(std::move(routes), slots);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include <cosim/model_description.hpp>
+#include "common/fmu_cache.hpp"
+#include "common/run_plan.hpp"
+#include "routing.hpp"
+
+// Variable table of every `clients:` entry in order, the boundary table for
+// a sub-system. Entries whose table cannot be read are reported and left null.
+std::vector<std::shared_ptr<const cosim::model_description>> client_models(const YAML::Node& clients,
+                                                                           FmuCache& cache);
+
+// The `connections:` entries of a configuration
+std::vector<RoutingTable::SignalConnection> signal_connections(const YAML::Node& connections);
+
+// Compiles the configuration at `config_path` into a run plan at `plan_path`.
+// Throws std::runtime_error if a variable table is missing or a connection
+// does not resolve.
+void compile_run_plan(const std::string& config_path, const std::string& plan_path);
+
+// Variable tables of the plan's clients, in configuration order
+std::vector<std::shared_ptr<const cosim::model_description>> plan_models(const RunPlan& plan);
+
+// Loads the routes of the plan into `routing`; throws if they are inconsistent
+void load_plan_routes(const RunPlan& plan, RoutingTable& routing);
@@ -0,0 +1,262 @@
+#include "recorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cosim/fs_portability.hpp>
+
+namespace {
+
+static_assert(static_cast<int>(record_format::Real) == SimProtocol::ValueType_Real &&
+              static_cast<int>(record_format::Integer) == SimProtocol::ValueType_Integer &&
+              static_cast<int>(record_format::Boolean) == SimProtocol::ValueType_Boolean,
+              "column types follow SimProtocol::ValueType");
+
+size_t align8(size_t size) { return (size + 7) & ~size_t{7}; }
+
+// True if the slots are one ascending run
+bool is_run(const std::vector<uint32_t>& slots) {
+    for (size_t i = 1; i < slots.size(); ++i) {
+        if (slots[i] != slots[0] + i) return false;
+    }
+    return true;
+}
+
+template <typename T>
+void gather(uint8_t* row, const T* slots, const std::vector<uint32_t>& indices, bool contiguous) {
+    if (indices.empty()) return;
+    if (contiguous) {
+        std::memcpy(row, slots + indices.front(), indices.size() * sizeof(T));
+        return;
+    }
+    auto* values = reinterpret_cast<T*>(row);
+    for (size_t i = 0; i < indices.size(); ++i) values[i] = slots[indices[i]];
+}
+
+}  // namespace
+
+Recorder::Recorder(const std::string& path, std::vector<Column> columns, uint32_t chunk_rows, size_t queue_bytes)
+    : path_(path)
+    , columns_(std::move(columns))
+    , chunk_rows_(std::max<uint32_t>(1, chunk_rows)) {
+    // Columns follow the row layout, one type after the other
+    std::stable_sort(columns_.begin(), columns_.end(),
+                     [](const Column& a, const Column& b) { return a.type < b.type; });
+    for (const auto& column : columns_) {
+        if (column.type == SimProtocol::ValueType_Real) real_slots_.push_back(column.slot);
+        else if (column.type == SimProtocol::ValueType_Integer) integer_slots_.push_back(column.slot);
+        else if (column.type == SimProtocol::ValueType_Boolean) boolean_slots_.push_back(column.slot);
+        else throw std::runtime_error("Column " + column.name + " is neither real, integer nor boolean");
+    }
+    contiguous_[0] = is_run(real_slots_);
+    contiguous_[1] = is_run(integer_slots_);
+    contiguous_[2] = is_run(boolean_slots_);
+
+    integer_offset_ = sizeof(int64_t) + real_slots_.size() * sizeof(double);
+    boolean_offset_ = integer_offset_ + integer_slots_.size() * sizeof(int32_t);
+    row_bytes_ = align8(boolean_offset_ + boolean_slots_.size());
+    for (size_t i = 0; i < real_slots_.size(); ++i) row_offsets_.push_back(sizeof(int64_t) + i * sizeof(double));
+    for (size_t i = 0; i < integer_slots_.size(); ++i) row_offsets_.push_back(integer_offset_ + i * sizeof(int32_t));
+    for (size_t i = 0; i < boolean_slots_.size(); ++i) row_offsets_.push_back(boolean_offset_ + i);
+
+    // Narrow rows travel 64 to a block; wide ones fewer, down to one per block
+    constexpr size_t kBlockBytes = 1024 * 1024;
+    rows_per_block_ = static_cast<uint32_t>(std::clamp<size_t>(kBlockBytes / row_bytes_, 1, 64));
+    size_t block_bytes = rows_per_block_ * row_bytes_;
+    block_count_ = std::clamp<size_t>(queue_bytes / block_bytes, 2, 65536 / rows_per_block_ + 2);
+    blocks_ = std::make_unique<uint8_t[]>(block_count_ * block_bytes);
+    block_rows_ = std::make_unique<uint32_t[]>(block_count_);
+
+    create_file();
+    writer_ = std::thread([this] { write_loop(); });
+}
+
+Recorder::~Recorder() {
+    // Hand over the last, partly filled block
+    if (current_rows_ > 0) {
+        uint64_t produced = produced_.load(std::memory_order_relaxed);
+        if (produced - consumed_.load(std::memory_order_acquire) < block_count_) {
+            block_rows_[produced % block_count_] = current_rows_;
+            produced_.store(produced + 1, std::memory_order_release);
+        } else {
+            dropped_.fetch_add(current_rows_, std::memory_order_relaxed);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        running_.store(false);
+    }
+    wake_cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+
+    if (uint64_t dropped = dropped_.load()) {
+        std::cerr << "Recorder dropped " << dropped << " rows, the writer fell behind" << std::endl;
+    }
+    std::cout << "Recorded " << rows_written_ << " rows of " << columns_.size() << " signals to " << path_
+              << std::endl;
+}
+
+void Recorder::create_file() {
+    using namespace record_format;
+
+    std::string names;
+    infos_.resize(columns_.size());
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        const auto& column = columns_[i];
+        auto& info = infos_[i];
+        info = ColumnInfo{};
+        info.name_offset = names.size();
+        info.name_size = static_cast<uint32_t>(column.name.size());
+        info.every = std::max<uint32_t>(1, column.every);
+        info.client_id = column.client_id;
+        info.reference = column.reference;
+        info.type = static_cast<uint8_t>(column.type);
+        names += column.name;
+    }
+    offsets_ = column_offsets(infos_.data(), infos_.size(), chunk_rows_, chunk_bytes_);
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.column_count = static_cast<uint32_t>(infos_.size());
+    header.chunk_rows = chunk_rows_;
+    header.names_offset = sizeof(FileHeader) + infos_.size() * sizeof(ColumnInfo);
+    header.names_size = names.size();
+    header.first_chunk = align(header.names_offset + names.size());
+    header.chunk_bytes = chunk_bytes_;
+    first_chunk_ = header.first_chunk;
+
+    {
+        std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot create " + path_);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(infos_.data()),
+                  static_cast<std::streamsize>(infos_.size() * sizeof(ColumnInfo)));
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+        if (!out) throw std::runtime_error("Cannot write " + path_);
+    }
+    cosim::filesystem::resize_file(path_, first_chunk_);
+
+    using namespace boost::interprocess;
+    file_ = file_mapping(path_.c_str(), read_write);
+    header_region_ = mapped_region(file_, read_write, 0, sizeof(FileHeader));
+}
+
+std::vector<uint32_t> Recorder::slots_in(const RoutingTable& routing) const {
+    std::vector<uint32_t> slots;
+    slots.reserve(columns_.size());
+    for (const auto& column : columns_) {
+        const auto* routes = routing.routes(column.client_id);
+        const auto* binding = routes ? RoutingTable::find_output(*routes, column.type, column.reference) : nullptr;
+        if (!binding) throw std::runtime_error("Recorded signal " + column.name + " has no slot");
+        slots.push_back(binding->slot);
+    }
+    return slots;
+}
+
+void Recorder::set_slots(const std::vector<uint32_t>& slots) {
+    if (slots.size() != columns_.size()) throw std::runtime_error("Slot count differs from the recorded columns");
+    real_slots_.assign(slots.begin(), slots.begin() + real_slots_.size());
+    integer_slots_.assign(slots.begin() + real_slots_.size(),
+                          slots.begin() + real_slots_.size() + integer_slots_.size());
+    boolean_slots_.assign(slots.end() - boolean_slots_.size(), slots.end());
+    contiguous_[0] = is_run(real_slots_);
+    contiguous_[1] = is_run(integer_slots_);
+    contiguous_[2] = is_run(boolean_slots_);
+}
+
+void Recorder::record(uint64_t time_us, RoutingTable& routing) {
+    uint64_t produced = produced_.load(std::memory_order_relaxed);
+    if (current_rows_ == 0 && produced - consumed_.load(std::memory_order_acquire) >= block_count_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint8_t* row = block(produced) + current_rows_ * row_bytes_;
+    std::memcpy(row, &time_us, sizeof(int64_t));
+    gather(row + sizeof(int64_t), routing.real_slots(), real_slots_, contiguous_[0]);
+    gather(row + integer_offset_, routing.integer_slots(), integer_slots_, contiguous_[1]);
+    gather(row + boolean_offset_, routing.boolean_slots(), boolean_slots_, contiguous_[2]);
+
+    if (++current_rows_ == rows_per_block_) {
+        block_rows_[produced % block_count_] = current_rows_;
+        produced_.store(produced + 1, std::memory_order_release);
+        current_rows_ = 0;
+    }
+}
+
+void Recorder::write_loop() {
+    try {
+        for (;;) {
+            // Read the flag first: blocks published before it was cleared are still drained
+            bool running = running_.load(std::memory_order_acquire);
+            uint64_t consumed = consumed_.load(std::memory_order_relaxed);
+            uint64_t produced = produced_.load(std::memory_order_acquire);
+            for (; consumed < produced; ++consumed) {
+                write_block(block(consumed), block_rows_[consumed % block_count_]);
+                consumed_.store(consumed + 1, std::memory_order_release);
+            }
+            if (!running) break;
+
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(5));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Recorder stopped writing " << path_ << ": " << e.what() << std::endl;
+        // Keep releasing blocks so that the step thread only counts them as dropped
+        while (running_.load(std::memory_order_acquire)) {
+            uint64_t produced = produced_.load(std::memory_order_acquire);
+            dropped_.fetch_add((produced - consumed_.load(std::memory_order_relaxed)) * rows_per_block_,
+                               std::memory_order_relaxed);
+            consumed_.store(produced, std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    chunk_region_ = boost::interprocess::mapped_region();
+    header_region_.flush();
+}
+
+void Recorder::map_chunk(uint64_t chunk) {
+    using namespace boost::interprocess;
+    chunk_region_ = mapped_region();
+    uint64_t offset = first_chunk_ + chunk * chunk_bytes_;
+    cosim::filesystem::resize_file(path_, offset + chunk_bytes_);
+    chunk_region_ = mapped_region(file_, read_write, static_cast<offset_t>(offset), chunk_bytes_);
+    mapped_chunk_ = chunk;
+}
+
+void Recorder::write_block(const uint8_t* rows, uint32_t count) {
+    using namespace record_format;
+    uint32_t done = 0;
+    while (done < count) {
+        uint64_t first_row = rows_written_;
+        uint64_t chunk = first_row / chunk_rows_;
+        if (chunk != mapped_chunk_) map_chunk(chunk);
+        uint64_t chunk_start = chunk * chunk_rows_;
+        auto n = static_cast<uint32_t>(std::min<uint64_t>(count - done, chunk_start + chunk_rows_ - first_row));
+        const uint8_t* segment = rows + size_t{done} * row_bytes_;
+        auto* base = static_cast<uint8_t*>(chunk_region_.get_address());
+
+        auto* times = reinterpret_cast<int64_t*>(base) + (first_row - chunk_start);
+        for (uint32_t i = 0; i < n; ++i) std::memcpy(&times[i], segment + size_t{i} * row_bytes_, sizeof(int64_t));
+
+        // Column by column, so each column's pages are written in one go
+        for (size_t c = 0; c < infos_.size(); ++c) {
+            uint32_t every = infos_[c].every;
+            size_t size = value_size(infos_[c].type);
+            uint8_t* column = base + offsets_[c];
+            uint64_t chunk_first_sample = sample_index(chunk_start, every);
+            for (uint64_t sample = sample_index(first_row, every); sample * every < first_row + n; ++sample) {
+                uint64_t row = sample * every;
+                std::memcpy(column + (sample - chunk_first_sample) * size,
+                            segment + (row - first_row) * row_bytes_ + row_offsets_[c], size);
+            }
+        }
+
+        done += n;
+        rows_written_ += n;
+    }
+    static_cast<FileHeader*>(header_region_.get_address())->row_count = rows_written_;
+}
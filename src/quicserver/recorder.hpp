@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "common/record_format.hpp"
+#include "routing.hpp"
+
+// Records selected slots of the signal store into a columnar result file
+// (layout in common/record_format.hpp). The step thread copies one row of
+// values per step into a lock-free queue of row blocks and moves on; a
+// background thread transposes the blocks into the columns of memory-mapped
+// chunks. A full queue drops rows rather than stall the step loop, and the
+// number dropped is reported when recording ends.
+class Recorder {
+public:
+    struct Column {
+        std::string name;
+        uint32_t client_id;
+        uint32_t reference;
+        SimProtocol::ValueType type;  // Real, Integer or Boolean
+        uint32_t slot;
+        uint32_t every;  // Decimation
+    };
+
+private:
+    std::string path_;
+    std::vector<Column> columns_;  // Reals, then integers, then booleans
+    std::vector<record_format::ColumnInfo> infos_;
+    std::vector<uint64_t> offsets_;
+    uint32_t chunk_rows_;
+    uint64_t first_chunk_ = 0;
+    uint64_t chunk_bytes_ = 0;
+
+    // Row: int64 time, doubles, int32s, then booleans, padded to 8 bytes.
+    // Slots of a type that form one run are copied with a single memcpy.
+    std::vector<uint32_t> real_slots_;
+    std::vector<uint32_t> integer_slots_;
+    std::vector<uint32_t> boolean_slots_;
+    bool contiguous_[3] = {};
+    size_t integer_offset_ = 0;
+    size_t boolean_offset_ = 0;
+    size_t row_bytes_ = 0;
+    std::vector<size_t> row_offsets_;  // Of each column's value within a row
+
+    // Queue of row blocks: the step thread fills block produced_ % count and
+    // publishes it, the writer drains up to produced_ and releases them.
+    // Blocks hold up to 64 rows of at most 1 MB together.
+    uint32_t rows_per_block_ = 1;
+    size_t block_count_ = 2;
+    std::unique_ptr<uint8_t[]> blocks_;
+    std::unique_ptr<uint32_t[]> block_rows_;
+    alignas(64) std::atomic<uint64_t> produced_{0};
+    uint32_t current_rows_ = 0;
+    alignas(64) std::atomic<uint64_t> consumed_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Writer thread state
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region header_region_;
+    boost::interprocess::mapped_region chunk_region_;
+    uint64_t mapped_chunk_ = UINT64_MAX;
+    uint64_t rows_written_ = 0;
+
+    std::thread writer_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> running_{true};
+
+    uint8_t* block(uint64_t index) { return blocks_.get() + (index % block_count_) * rows_per_block_ * row_bytes_; }
+
+    // Creates the file with its header, column table and name table
+    void create_file();
+
+    void write_loop();
+
+    // Transposes one block into the chunk columns
+    void write_block(const uint8_t* rows, uint32_t count);
+
+    // Maps chunk `chunk`, growing the file to hold it
+    void map_chunk(uint64_t chunk);
+
+public:
+    // `queue_bytes` bounds the rows buffered for the writer. Throws
+    // std::runtime_error if the file cannot be created.
+    Recorder(const std::string& path, std::vector<Column> columns, uint32_t chunk_rows, size_t queue_bytes);
+
+    // Writes the rows still queued and completes the file
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    size_t column_count() const { return columns_.size(); }
+    const std::vector<Column>& columns() const { return columns_; }
+
+    // Slot of every column in `routing`, in column order. Throws
+    // std::runtime_error if the output of a column has no slot there.
+    std::vector<uint32_t> slots_in(const RoutingTable& routing) const;
+
+    // Reads the columns from `slots`, as returned by slots_in(), from the
+    // next row on; step thread only
+    void set_slots(const std::vector<uint32_t>& slots);
+
+    // Queues the current slot values at `time_us`; step thread only, with
+    // the slots protected from concurrent stores. Never blocks.
+    void record(uint64_t time_us, RoutingTable& routing);
+};
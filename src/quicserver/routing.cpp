@@ -0,0 +1,304 @@
+#include "routing.hpp"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include "common/async_log.hpp"
+
+namespace {
+
+// Writes the connected outputs of one type of a v2 response into their slots
+template <typename T, typename Slot>
+void store_outputs(const RoutingTable::ClientRoutes& routes, SimProtocol::ValueType type,
+                   const flatbuffers::Vector<uint32_t>* refs, const flatbuffers::Vector<T>* values, Slot* slots,
+                   bool positional) {
+    if (!values) return;
+
+    // Without references the values follow the output bindings, as in the client's slot map
+    if (!refs) {
+        if (!positional) return;
+        const auto& bindings = routes.outputs[type];
+        if (values->size() != bindings.size()) return;
+        for (size_t i = 0; i < bindings.size(); ++i) slots[bindings[i].slot] = values->Get(i);
+        return;
+    }
+
+    size_t count = std::min<size_t>(refs->size(), values->size());
+    for (size_t i = 0; i < count; ++i) {
+        if (const auto* binding = RoutingTable::find_output(routes, type, refs->Get(i))) {
+            slots[binding->slot] = values->Get(i);
+        }
+    }
+}
+
+}  // namespace
+
+RoutingTable::RoutingTable(RoutingTable&& other) noexcept {
+    *this = std::move(other);
+}
+
+RoutingTable& RoutingTable::operator=(RoutingTable&& other) noexcept {
+    if (this == &other) return *this;
+    if (string_pool_) {
+        for (auto& offset : string_offsets_) string_pool_->release(offset);
+    }
+    routes_ = std::move(other.routes_);
+    real_slots_ = std::move(other.real_slots_);
+    integer_slots_ = std::move(other.integer_slots_);
+    boolean_slots_ = std::move(other.boolean_slots_);
+    string_slots_ = std::move(other.string_slots_);
+    binary_slots_ = std::move(other.binary_slots_);
+    string_pool_ = other.string_pool_;
+    string_offsets_ = std::move(other.string_offsets_);
+    other.string_offsets_.clear();
+    return *this;
+}
+
+RoutingTable::~RoutingTable() {
+    if (string_pool_) {
+        for (auto& offset : string_offsets_) string_pool_->release(offset);
+    }
+}
+
+uint32_t RoutingTable::add_slot(SimProtocol::ValueType type) {
+    switch (type) {
+        case SimProtocol::ValueType_Real:
+            real_slots_.push_back(0.0);
+            return static_cast<uint32_t>(real_slots_.size() - 1);
+        case SimProtocol::ValueType_Integer:
+            integer_slots_.push_back(0);
+            return static_cast<uint32_t>(integer_slots_.size() - 1);
+        case SimProtocol::ValueType_Boolean:
+            boolean_slots_.push_back(0);
+            return static_cast<uint32_t>(boolean_slots_.size() - 1);
+        case SimProtocol::ValueType_Binary:
+            binary_slots_.emplace_back();
+            return static_cast<uint32_t>(binary_slots_.size() - 1);
+        case SimProtocol::ValueType_String:
+        default:
+            string_slots_.emplace_back();
+            if (string_pool_) string_offsets_.push_back(SharedStringPool::kNullOffset);
+            return static_cast<uint32_t>(string_slots_.size() - 1);
+    }
+}
+
+bool RoutingTable::build(const std::vector<SignalConnection>& connections, const Resolver& resolve) {
+    routes_.clear();
+    real_slots_.clear();
+    integer_slots_.clear();
+    boolean_slots_.clear();
+    string_slots_.clear();
+    binary_slots_.clear();
+    if (string_pool_) {
+        for (auto& offset : string_offsets_) string_pool_->release(offset);
+    }
+    string_offsets_.clear();
+
+    // An output feeding several inputs is stored once
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> output_slots;
+
+    for (const auto& conn : connections) {
+        VariableInfo from{};
+        VariableInfo to{};
+        if (!resolve(conn.from_client, conn.from_variable, from) || !from.is_output) {
+            std::cerr << "Unknown output '" << conn.from_variable
+                      << "' of client " << conn.from_client << std::endl;
+            return false;
+        }
+        if (!resolve(conn.to_client, conn.to_variable, to) || to.is_output) {
+            std::cerr << "Unknown input '" << conn.to_variable
+                      << "' of client " << conn.to_client << std::endl;
+            return false;
+        }
+        if (from.type != to.type) {
+            std::cerr << "Type mismatch connecting " << conn.from_client << "." << conn.from_variable
+                      << " to " << conn.to_client << "." << conn.to_variable << std::endl;
+            return false;
+        }
+
+        auto key = std::make_pair(conn.from_client, from.reference);
+        auto it = output_slots.find(key);
+        if (it == output_slots.end()) {
+            uint32_t slot = add_slot(from.type);
+            it = output_slots.emplace(key, slot).first;
+            routes_[conn.from_client].outputs[from.type].push_back({from.reference, slot});
+        }
+        routes_[conn.to_client].inputs[to.type].push_back({to.reference, it->second});
+    }
+
+    // Outputs are looked up by reference when responses arrive
+    for (auto& entry : routes_) {
+        for (auto& outputs : entry.second.outputs) {
+            std::sort(outputs.begin(), outputs.end(), [](const Binding& a, const Binding& b) {
+                return a.reference < b.reference;
+            });
+        }
+    }
+
+    return true;
+}
+
+void RoutingTable::assign(std::map<uint32_t, ClientRoutes> routes, const std::array<uint32_t, kTypeCount>& slot_counts) {
+    routes_ = std::move(routes);
+    real_slots_.assign(slot_counts[SimProtocol::ValueType_Real], 0.0);
+    integer_slots_.assign(slot_counts[SimProtocol::ValueType_Integer], 0);
+    boolean_slots_.assign(slot_counts[SimProtocol::ValueType_Boolean], 0);
+    string_slots_.assign(slot_counts[SimProtocol::ValueType_String], std::string());
+    binary_slots_.assign(slot_counts[SimProtocol::ValueType_Binary], BinaryValue());
+    if (string_pool_) {
+        for (auto& offset : string_offsets_) string_pool_->release(offset);
+        string_offsets_.assign(slot_counts[SimProtocol::ValueType_String], SharedStringPool::kNullOffset);
+    }
+}
+
+uint32_t RoutingTable::add_output(uint32_t client_id, SimProtocol::ValueType type, uint32_t reference) {
+    auto& outputs = routes_[client_id].outputs[type];
+    auto it = std::lower_bound(outputs.begin(), outputs.end(), reference,
+        [](const Binding& binding, uint32_t ref) { return binding.reference < ref; });
+    if (it != outputs.end() && it->reference == reference) return it->slot;
+    uint32_t slot = add_slot(type);
+    outputs.insert(it, {reference, slot});
+    return slot;
+}
+
+std::vector<RoutingTable::SlotMove> RoutingTable::carried_from(const RoutingTable& previous) const {
+    std::vector<SlotMove> moves;
+    for (const auto& entry : routes_) {
+        const auto* old_routes = previous.routes(entry.first);
+        if (!old_routes) continue;
+        for (size_t type = 0; type < kTypeCount; ++type) {
+            auto value_type = static_cast<SimProtocol::ValueType>(type);
+            for (const auto& binding : entry.second.outputs[type]) {
+                if (const auto* old = find_output(*old_routes, value_type, binding.reference)) {
+                    moves.push_back({value_type, old->slot, binding.slot});
+                }
+            }
+        }
+    }
+    return moves;
+}
+
+void RoutingTable::take_values(RoutingTable& previous, const std::vector<SlotMove>& moves) {
+    for (const auto& move : moves) {
+        switch (move.type) {
+            case SimProtocol::ValueType_Real:
+                real_slots_[move.to] = previous.real_slots_[move.from];
+                break;
+            case SimProtocol::ValueType_Integer:
+                integer_slots_[move.to] = previous.integer_slots_[move.from];
+                break;
+            case SimProtocol::ValueType_Boolean:
+                boolean_slots_[move.to] = previous.boolean_slots_[move.from];
+                break;
+            case SimProtocol::ValueType_String:
+                string_slots_[move.to] = std::move(previous.string_slots_[move.from]);
+                if (string_pool_ && previous.string_pool_ == string_pool_) {
+                    std::swap(string_offsets_[move.to], previous.string_offsets_[move.from]);
+                }
+                break;
+            case SimProtocol::ValueType_Binary:
+                binary_slots_[move.to] = std::move(previous.binary_slots_[move.from]);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+const RoutingTable::ClientRoutes* RoutingTable::routes(uint32_t client_id) const {
+    auto it = routes_.find(client_id);
+    return it != routes_.end() ? &it->second : nullptr;
+}
+
+const RoutingTable::Binding* RoutingTable::find_output(
+    const ClientRoutes& routes, SimProtocol::ValueType type, uint32_t reference) {
+    if (static_cast<size_t>(type) >= kTypeCount) return nullptr;
+
+    const auto& outputs = routes.outputs[type];
+    auto it = std::lower_bound(outputs.begin(), outputs.end(), reference,
+        [](const Binding& binding, uint32_t ref) { return binding.reference < ref; });
+    return (it != outputs.end() && it->reference == reference) ? &*it : nullptr;
+}
+
+void RoutingTable::store_variables(const ClientRoutes& routes,
+                                   const flatbuffers::Vector<flatbuffers::Offset<SimProtocol::Variable>>* outputs) {
+    if (!outputs) return;
+    for (const auto* output : *outputs) {
+        const auto* binding = find_output(routes, output->value_type(), output->value_reference());
+        if (!binding) continue;
+
+        switch (output->value_type()) {
+            case SimProtocol::ValueType_Real:
+                real_slots_[binding->slot] = output->real_value();
+                break;
+            case SimProtocol::ValueType_Integer:
+                integer_slots_[binding->slot] = output->integer_value();
+                break;
+            case SimProtocol::ValueType_Boolean:
+                boolean_slots_[binding->slot] = output->boolean_value() ? 1 : 0;
+                break;
+            case SimProtocol::ValueType_String:
+                if (const auto* value = output->string_value()) {
+                    store_string(binding->slot, std::string_view(value->c_str(), value->size()));
+                } else {
+                    store_string(binding->slot, std::string_view());
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void RoutingTable::store_signals(const ClientRoutes& routes, const SimProtocol::SignalVector* outputs,
+                                 bool positional) {
+    if (!outputs) return;
+
+    store_outputs(routes, SimProtocol::ValueType_Real,
+                  outputs->real_refs(), outputs->real_values(), real_slots_.data(), positional);
+    store_outputs(routes, SimProtocol::ValueType_Integer,
+                  outputs->integer_refs(), outputs->integer_values(), integer_slots_.data(), positional);
+    store_outputs(routes, SimProtocol::ValueType_Boolean,
+                  outputs->boolean_refs(), outputs->boolean_values(), boolean_slots_.data(), positional);
+
+    const auto* refs = outputs->string_refs();
+    const auto* values = outputs->string_values();
+    if (!refs || !values) return;
+    size_t count = std::min<size_t>(refs->size(), values->size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto* binding = find_output(routes, SimProtocol::ValueType_String, refs->Get(i));
+        if (!binding) continue;
+        const auto* value = values->Get(i);
+        store_string(binding->slot, std::string_view(value->c_str(), value->size()));
+    }
+}
+
+void RoutingTable::store_string(uint32_t slot, std::string_view value) {
+    if (!string_pool_) {
+        string_slots_[slot].assign(value.data(), value.size());
+        return;
+    }
+    // An exhausted pool keeps the previous value rather than dropping it
+    if (!string_pool_->assign(string_offsets_[slot], value)) {
+        async_log(LogCategory::Step, "String pool exhausted storing slot {} ({} bytes)", slot, value.size());
+    }
+}
+
+std::string_view RoutingTable::string_value(uint32_t slot) const {
+    if (!string_pool_) return string_slots_[slot];
+    return string_pool_->view(string_offsets_[slot]);
+}
+
+uint32_t RoutingTable::string_offset(uint32_t slot) const {
+    return string_pool_ ? string_offsets_[slot] : SharedStringPool::kNullOffset;
+}
+
+size_t RoutingTable::slot_count(SimProtocol::ValueType type) const {
+    switch (type) {
+        case SimProtocol::ValueType_Real: return real_slots_.size();
+        case SimProtocol::ValueType_Integer: return integer_slots_.size();
+        case SimProtocol::ValueType_Boolean: return boolean_slots_.size();
+        case SimProtocol::ValueType_String: return string_slots_.size();
+        case SimProtocol::ValueType_Binary: return binary_slots_.size();
+        default: return 0;
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "simulation_protocol_generated.h"
+#include "common/blob.hpp"
+#include "common/string_pool.hpp"
+
+// Dense signal store for one run. Every connected output owns one slot in
+// the array of its type; after a step the producing client writes its
+// outputs into their slots and, before the next step, consumers read the
+// slots their inputs are connected to.
+class RoutingTable {
+public:
+    static constexpr size_t kTypeCount = 5;  // indexed by SimProtocol::ValueType
+
+    // One `connections:` entry from the configuration
+    struct SignalConnection {
+        uint32_t from_client;
+        std::string from_variable;
+        uint32_t to_client;
+        std::string to_variable;
+    };
+
+    // What a resolver reports about a named variable of a client
+    struct VariableInfo {
+        uint32_t reference;
+        SimProtocol::ValueType type;
+        bool is_output;
+    };
+    using Resolver = std::function<bool(uint32_t client_id, const std::string& name, VariableInfo& info)>;
+
+    // Value reference of a client variable and the slot it reads or writes
+    struct Binding {
+        uint32_t reference;
+        uint32_t slot;
+    };
+
+    // A binary slot holds a blob received over QUIC, or where a local client
+    // left the value in a shared blob store. offset 0 with no blob means empty.
+    struct BinaryValue {
+        std::shared_ptr<const Blob> blob;
+        uint32_t store = 0;
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    struct ClientRoutes {
+        std::array<std::vector<Binding>, kTypeCount> outputs;
+        std::array<std::vector<Binding>, kTypeCount> inputs;
+    };
+
+    // A slot value carried over from the table of the previous epoch
+    struct SlotMove {
+        SimProtocol::ValueType type;
+        uint32_t from;
+        uint32_t to;
+    };
+
+private:
+    std::map<uint32_t, ClientRoutes> routes_;
+
+    // Slot storage, one array per type
+    std::vector<double> real_slots_;
+    std::vector<int32_t> integer_slots_;
+    std::vector<uint8_t> boolean_slots_;
+    std::vector<std::string> string_slots_;
+    std::vector<BinaryValue> binary_slots_;
+
+    // With a string pool, string values live there and string_slots_ stay empty
+    SharedStringPool* string_pool_ = nullptr;
+    std::vector<uint32_t> string_offsets_;
+
+    uint32_t add_slot(SimProtocol::ValueType type);
+    void store_string(uint32_t slot, std::string_view value);
+
+public:
+    RoutingTable() = default;
+    RoutingTable(const RoutingTable&) = delete;
+    RoutingTable& operator=(const RoutingTable&) = delete;
+    RoutingTable(RoutingTable&& other) noexcept;
+    RoutingTable& operator=(RoutingTable&& other) noexcept;
+    ~RoutingTable();
+
+    // Keeps string values in `pool`, whose only writer this table becomes,
+    // so local clients can read them by offset. Call before build() or assign().
+    void use_string_pool(SharedStringPool* pool) { string_pool_ = pool; }
+
+    // Resolves every connection and assigns slots. Returns false and reports
+    // the offending entry if a variable is unknown or the types do not match.
+    bool build(const std::vector<SignalConnection>& connections, const Resolver& resolve);
+
+    // Takes routes resolved ahead of time, as by a run plan, with the slot
+    // count of each type; every binding must lie within those counts
+    void assign(std::map<uint32_t, ClientRoutes> routes, const std::array<uint32_t, kTypeCount>& slot_counts);
+
+    // Gives output `reference` of a client a slot unless it has one, so it
+    // is stored without a consumer; returns the slot
+    uint32_t add_output(uint32_t client_id, SimProtocol::ValueType type, uint32_t reference);
+
+    // Slot values of the outputs this table shares with `previous`
+    std::vector<SlotMove> carried_from(const RoutingTable& previous) const;
+
+    // Moves the values of `moves` out of `previous` into this table
+    void take_values(RoutingTable& previous, const std::vector<SlotMove>& moves);
+
+    // Routes of a client, or nullptr if it takes part in no connection
+    const ClientRoutes* routes(uint32_t client_id) const;
+    const std::map<uint32_t, ClientRoutes>& all_routes() const { return routes_; }
+
+    // Output binding of `reference`, or nullptr if that output is not connected
+    static const Binding* find_output(const ClientRoutes& routes, SimProtocol::ValueType type, uint32_t reference);
+
+    // Stores the connected outputs of a v1 response in their slots
+    void store_variables(const ClientRoutes& routes,
+                         const flatbuffers::Vector<flatbuffers::Offset<SimProtocol::Variable>>* outputs);
+
+    // Stores the connected real, integer, boolean and string outputs of a v2
+    // response in their slots; binary values are left to the caller. Real,
+    // integer and boolean values without references are taken in the order
+    // of the client's output bindings, unless not `positional` because they
+    // follow the slot map of an earlier epoch.
+    void store_signals(const ClientRoutes& routes, const SimProtocol::SignalVector* outputs, bool positional = true);
+
+    double* real_slots() { return real_slots_.data(); }
+    int32_t* integer_slots() { return integer_slots_.data(); }
+    uint8_t* boolean_slots() { return boolean_slots_.data(); }
+    std::string* string_slots() { return string_slots_.data(); }
+    std::string_view string_value(uint32_t slot) const;
+    // Offset of a string slot's value in the pool, kNullOffset without one
+    uint32_t string_offset(uint32_t slot) const;
+    BinaryValue* binary_slots() { return binary_slots_.data(); }
+
+    size_t slot_count(SimProtocol::ValueType type) const;
+};
@@ -1,15 +1,127 @@
 #include "server.hpp"
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <boost/interprocess/mapped_region.hpp>
+#include "common/async_log.hpp"
+#include "common/fmu_cache.hpp"
+#include "common/osmp.hpp"
+#include "common/phase_timer.hpp"
+#include "plan_compiler.hpp"
+
+namespace {
+
+// Columns of the signals listed under `recorder.signals`, or of every
+// connected real, integer and boolean output if there is no list. Only
+// connected outputs have a slot in the signal store.
+std::vector<Recorder::Column> recorder_columns(const YAML::Node& recorder, const RoutingTable& routing,
+                                               const ModelCatalog& catalog) {
+    uint32_t every = std::max<uint32_t>(1, recorder["every"].as<uint32_t>(1));
+    auto recordable = [](SimProtocol::ValueType type) {
+        return type == SimProtocol::ValueType_Real || type == SimProtocol::ValueType_Integer ||
+               type == SimProtocol::ValueType_Boolean;
+    };
+
+    std::vector<Recorder::Column> columns;
+    if (!recorder["signals"]) {
+        for (const auto& entry : routing.all_routes()) {
+            for (size_t type = 0; type < RoutingTable::kTypeCount; ++type) {
+                auto value_type = static_cast<SimProtocol::ValueType>(type);
+                if (!recordable(value_type)) continue;
+                for (const auto& binding : entry.second.outputs[type]) {
+                    std::string name = catalog.variable_name(entry.first, value_type, binding.reference);
+                    columns.push_back({std::to_string(entry.first) + "." + name, entry.first, binding.reference,
+                                       value_type, binding.slot, every});
+                }
+            }
+        }
+        // In slot order every type is one run of slots, copied in one go
+        std::sort(columns.begin(), columns.end(), [](const Recorder::Column& a, const Recorder::Column& b) {
+            return a.type != b.type ? a.type < b.type : a.slot < b.slot;
+        });
+        return columns;
+    }
+
+    for (const auto& signal : recorder["signals"]) {
+        uint32_t client_id = signal["client"].as<uint32_t>();
+        std::string name = signal["variable"].as<std::string>();
+        RoutingTable::VariableInfo info{};
+        const RoutingTable::Binding* binding = nullptr;
+        const auto* routes = routing.routes(client_id);
+        if (routes && catalog.resolve(client_id, name, info) && info.is_output && recordable(info.type)) {
+            binding = RoutingTable::find_output(*routes, info.type, info.reference);
+        }
+        if (!binding) {
+            std::cerr << "Not recording " << client_id << "." << name
+                      << ": only connected real, integer and boolean outputs can be recorded" << std::endl;
+            continue;
+        }
+        columns.push_back({std::to_string(client_id) + "." + name, client_id, info.reference, info.type,
+                           binding->slot, std::max<uint32_t>(1, signal["every"].as<uint32_t>(every))});
+    }
+    return columns;
+}
+
+// True if a client's real, integer and boolean values travel in the same
+// order in both tables, so its slot map still holds
+bool same_slot_map(const RoutingTable::ClientRoutes* before, const RoutingTable::ClientRoutes* after) {
+    static const RoutingTable::ClientRoutes kNone;
+    const auto& a = before ? *before : kNone;
+    const auto& b = after ? *after : kNone;
+    auto same = [](const std::vector<RoutingTable::Binding>& x, const std::vector<RoutingTable::Binding>& y) {
+        return std::equal(x.begin(), x.end(), y.begin(), y.end(),
+                          [](const RoutingTable::Binding& p, const RoutingTable::Binding& q) {
+                              return p.reference == q.reference;
+                          });
+    };
+    for (auto type : {SimProtocol::ValueType_Real, SimProtocol::ValueType_Integer, SimProtocol::ValueType_Boolean}) {
+        if (!same(a.inputs[type], b.inputs[type]) || !same(a.outputs[type], b.outputs[type])) return false;
+    }
+    return true;
+}
+
+// Binary outputs of a model; every one is written, connected or not
+size_t binary_outputs(const cosim::model_description& model) {
+    size_t outputs = 0;
+    for (const auto& binary : binary_variables(model)) {
+        if (binary.causality == cosim::variable_causality::output) ++outputs;
+    }
+    return outputs;
+}
+
+// Waits for MsQuic to hand back a buffer it reads in place, which it does
+// as soon as the data is buffered or acknowledged
+bool wait_for_send(const PendingSend& pending) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (pending.in_flight.load(std::memory_order_acquire)) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+}  // namespace
 
 QuicServer::QuicServer(const std::string& config_path)
     : send_buffer_(1024 * 1024)  // 1MB pre-allocated buffer
-    , receive_buffer_(1024 * 1024) {
+    , receive_buffer_(1024 * 1024)
+    , config_path_(config_path) {
     
+    PhaseTimer timer;
     try {
-        // Load configuration
-        YAML::Node config = YAML::LoadFile(config_path);
+        // A compiled run plan stands in for the configuration, its variable
+        // tables and its connections
+        std::unique_ptr<RunPlan> plan;
+        YAML::Node config;
+        if (RunPlan::is_plan(config_path)) {
+            plan = std::make_unique<RunPlan>(config_path);
+            plan->check_fmus();
+            config = plan->settings();
+        } else {
+            config = YAML::LoadFile(config_path);
+        }
         
         // Initialize shared memory
         size_t shm_size = config["server"]["shared_memory_size"].as<size_t>();
@@ -18,14 +130,82 @@ QuicServer::QuicServer(const std::string& config_path)
             "simulation_shared_memory",
             shm_size
         );
+
+        // String pool for string-valued variables, located by clients through its handle
+        uint32_t pool_size = config["server"]["string_pool_size"].as<uint32_t>(256 * 1024);
+        size_t pool_bytes = SharedStringPool::required_size(pool_size);
+        void* pool_region = allocate_shared_region("simulation_string_pool", pool_bytes);
+        string_pool_ = std::make_unique<SharedStringPool>(
+            SharedStringPool::create(pool_region, pool_bytes));
+        routing_.use_string_pool(string_pool_.get());
         
+        // Message rings for local clients; messages are built and read in place
+        ring_slots_ = config["server"]["local_slot_count"].as<uint32_t>(4);
+        ring_slot_size_ = config["server"]["local_slot_size"].as<uint32_t>(16 * 1024);
+
+        // Compression of large requests to QUIC clients, overridable per client
+        uint32_t compression_threshold = config["server"]["compression_threshold"].as<uint32_t>(0);
+
+        // Tracing is on for the whole run; clients learn of it in the Welcome
+        trace_file_ = config["server"]["trace_file"].as<std::string>("");
+        if (!trace_file_.empty()) {
+            set_tracing(true, config["server"]["trace_spans"].as<size_t>(0));
+            set_trace_process("server");
+            trace_track_ = trace_name("server");
+            trace_step_ = trace_name("step");
+        }
+
+        // Variable tables resolve the connection variables to references and types
+        FmuCache cache(config["fmu_cache"].as<std::string>(""));
+        timer.mark("shared memory");
+
         // Setup connections from config
         for (const auto& client : config["clients"]) {
-            Connection conn;
-            conn.is_local = (client["type"].as<std::string>() == "local");
-            conn.client_id = client["id"].as<uint32_t>();
-            connections_.push_back(conn);
+            connections_.push_back(create_connection(client_settings(client, compression_threshold)));
+        }
+
+        // Live statistics; an empty segment name keeps them in private memory
+        std::vector<std::pair<uint32_t, bool>> stats_clients;
+        for (const auto& conn : connections_) stats_clients.emplace_back(conn.client_id, conn.is_local);
+        stats_ = std::make_unique<StatsPublisher>(
+            stats_clients, config["server"]["stats_segment"].as<std::string>(stats::kDefaultSegment));
+        size_t stats_index = 0;
+        for (auto& conn : connections_) conn.stats = &stats_->client(stats_index++);
+
+        // A sub-system client exposes only its boundary variables. A QUIC
+        // client whose FMU the server cannot read sends its own table.
+        auto models = plan ? plan_models(*plan) : client_models(config["clients"], cache);
+        if (models.size() != connections_.size()) throw std::runtime_error("Run plan does not match its clients");
+        std::vector<uint32_t> missing;
+        auto conn = connections_.begin();
+        for (size_t i = 0; i < models.size(); ++i, ++conn) {
+            connection_index_[conn->client_id] = &*conn;
+            if (models[i]) {
+                catalog_.add(conn->client_id, models[i]);
+            } else if (conn->is_local) {
+                throw std::runtime_error("Local client " + std::to_string(conn->client_id) + " has no readable FMU");
+            } else {
+                missing.push_back(conn->client_id);
+            }
+        }
+        timer.mark("model descriptions");
+
+        blob_slot_size_ = config["server"]["blob_slot_size"].as<uint32_t>(8 * 1024 * 1024);
+        create_blob_stores(models);
+        if (config["recorder"]) recorder_config_ = config["recorder"];
+        if (plan) {
+            load_plan_routes(*plan, routing_);
+        } else {
+            pending_connections_ = signal_connections(config["connections"]);
+        }
+        if (missing.empty()) {
+            resolve_connections();
+            timer.mark("routing");
+        } else {
+            std::cout << "Resolving connections once " << missing.size()
+                      << " clients have sent their variable tables" << std::endl;
         }
+        timer.report("Server");
         
     } catch (const std::exception& e) {
         std::cerr << "Error initializing server: " << e.what() << std::endl;
@@ -34,15 +214,19 @@ QuicServer::QuicServer(const std::string& config_path)
 
 bool QuicServer::init() {
     try {
+        // Messages over QUIC name their client: Hello lists its ids, responses carry instance_id
         quic_connection_ = std::make_unique<QuicConnection>(true);
+        quic_connection_->set_peer_handler([this](const std::shared_ptr<QuicConnection>& peer) {
+            std::weak_ptr<QuicConnection> weak = peer;
+            peer->set_message_handler([this, weak](const uint8_t* data, size_t len) {
+                handle_client_message(0, data, len, weak.lock());
+            });
+        });
         if (!quic_connection_->listen(8080)) {
             throw std::runtime_error("Failed to start QUIC server");
         }
-        
-        quic_connection_->set_message_handler(
-            [this](const uint8_t* data, size_t len) {
-                // Handle new client connections
-            });
+
+        prepare_simulation();
             
         return true;
     } catch (const std::exception& e) {
@@ -51,48 +235,1143 @@ bool QuicServer::init() {
     }
 }
 
-bool QuicServer::step(uint64_t timestep_us) {
-    flatbuffers::FlatBufferBuilder builder;
-    
-    // Create step request
+QuicServer::~QuicServer() {
+    if (reconfigure_thread_.joinable()) reconfigure_thread_.join();
+}
+
+QuicServer::ClientSettings QuicServer::client_settings(const YAML::Node& client, uint32_t compression_threshold) {
+    ClientSettings settings;
+    settings.id = client["id"].as<uint32_t>();
+    settings.is_local = client["type"].as<std::string>() == "local";
+    settings.compression_threshold = client["compression_threshold"].as<uint32_t>(compression_threshold);
+    settings.batch_steps = std::max<uint32_t>(1, client["batch_steps"].as<uint32_t>(1));
+    settings.batch_all_outputs = client["batch_outputs"].as<std::string>("last") == "all";
+    settings.input_profile = client["input_profile"].as<std::string>("");
+    return settings;
+}
+
+void QuicServer::apply_settings(Connection& conn, const ClientSettings& settings) {
+    conn.compression_threshold = settings.compression_threshold;
+    if (conn.batch_steps != settings.batch_steps) conn.batch_position = 0;
+    conn.batch_steps = settings.batch_steps;
+    conn.batch_all_outputs = settings.batch_all_outputs;
+    conn.input_profile = settings.input_profile;
+}
+
+QuicServer::Connection QuicServer::create_connection(const ClientSettings& settings) {
+    Connection conn;
+    conn.is_local = settings.is_local;
+    conn.client_id = settings.id;
+    apply_settings(conn, settings);
+    conn.latencies = std::make_unique<PhaseLatencies>(
+        "server/client " + std::to_string(conn.client_id),
+        std::vector<const char*>{"serialize", "send", "round_trip", "route"});
+
+    if (conn.is_local) {
+        std::string suffix = std::to_string(conn.client_id);
+        size_t ring_bytes = SharedMessageRing::required_size(ring_slots_, ring_slot_size_);
+        conn.request_writer = std::make_unique<SharedMessageWriter>(SharedMessageRing::create(
+            allocate_shared_region("request_ring_" + suffix, ring_bytes), ring_slots_, ring_slot_size_));
+        conn.response_ring = std::make_unique<SharedMessageRing>(SharedMessageRing::create(
+            allocate_shared_region("response_ring_" + suffix, ring_bytes), ring_slots_, ring_slot_size_));
+    }
+    return conn;
+}
+
+void* QuicServer::allocate_shared_region(const std::string& name, size_t bytes) {
+    // A client removed and added again by a reconfiguration finds its regions where they were
+    auto it = shared_regions_.find(name);
+    if (it != shared_regions_.end()) {
+        if (it->second.second < bytes) throw std::runtime_error("Shared region " + name + " is too small to reuse");
+        return it->second.first;
+    }
+
+    // Clients locate the region through the handle stored under `name`
+    void* region = shared_memory_->allocate_aligned(bytes, 64);
+    shared_memory_->construct<boost::interprocess::managed_shared_memory::handle_t>(
+        name.c_str())(shared_memory_->get_handle_from_address(region));
+    shared_regions_.emplace(name, std::make_pair(region, bytes));
+    return region;
+}
+
+uint32_t QuicServer::blob_store_slots(size_t values) const {
+    // A slot is rewritten only after a producer has run ring_slots + 2 steps
+    // ahead, by which time the ring has held back every consumer of the old value
+    return static_cast<uint32_t>(values * (ring_slots_ + 2));
+}
+
+SharedBlobStore QuicServer::create_blob_store(uint32_t store_id, size_t values) {
+    uint32_t slots = blob_store_slots(values);
+    void* region = allocate_shared_region("blob_store_" + std::to_string(store_id),
+                                          SharedBlobStore::required_size(slots, blob_slot_size_));
+    return SharedBlobStore::create(region, slots, blob_slot_size_);
+}
+
+void QuicServer::create_blob_stores(const std::vector<std::shared_ptr<const cosim::model_description>>& models) {
+    auto conn = connections_.begin();
+    for (size_t i = 0; i < models.size(); ++i, ++conn) {
+        if (!conn->is_local || !models[i]) continue;
+        size_t outputs = binary_outputs(*models[i]);
+        if (outputs > 0) blob_stores_.emplace(conn->client_id, create_blob_store(conn->client_id, outputs));
+    }
+}
+
+void QuicServer::create_forward_store() {
+    // Local clients look up store 0 when a request first refers to it
+    size_t forwarded = 0;
+    for (const auto& conn : connections_) {
+        if (!conn.is_local) continue;
+        if (const auto* routes = routing_.routes(conn.client_id)) {
+            forwarded += routes->inputs[SimProtocol::ValueType_Binary].size();
+        }
+    }
+    if (forwarded > 0) blob_stores_.emplace(0, create_blob_store(0, forwarded));
+}
+
+void QuicServer::resolve_connections() {
+    if (!pending_connections_.empty()) {
+        routing_.build(pending_connections_,
+            [this](uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) {
+                return catalog_.resolve(client_id, name, info);
+            });
+        pending_connections_.clear();
+    }
+    create_forward_store();
+    for (auto& conn : connections_) {
+        if (!conn.input_profile.empty()) conn.profile = load_profile(conn.client_id, conn.input_profile, routing_);
+    }
+
+    if (recorder_config_.IsMap() && !recorder_config_["file"].as<std::string>("").empty()) {
+        recorder_ = std::make_unique<Recorder>(
+            recorder_config_["file"].as<std::string>(), recorder_columns(recorder_config_, routing_, catalog_),
+            recorder_config_["chunk_rows"].as<uint32_t>(4096),
+            recorder_config_["queue_bytes"].as<size_t>(64 * 1024 * 1024));
+    }
+    routing_ready_.store(true, std::memory_order_release);
+}
+
+void QuicServer::build_step_request(flatbuffers::FlatBufferBuilder& builder, Connection& conn,
+                                    uint64_t timestep_us, uint32_t steps) {
+    conn.requested_at = PhaseLatencies::now();
+    conn.awaiting_response = true;
+    const auto* routes = routing_.routes(conn.client_id);
+    bool pooled_strings = hold_strings(conn);
+    if (conn.protocol_version >= 2) {
+        build_signal_request(builder, routes, conn, timestep_us, steps, pooled_strings);
+        return;
+    }
+
+    // Inputs are grouped by type, so the client sees one contiguous run per type
+    input_offsets_.clear();
+    if (routes) {
+        for (const auto& binding : routes->inputs[SimProtocol::ValueType_Real]) {
+            input_offsets_.push_back(SimProtocol::CreateVariable(
+                builder, 0, SimProtocol::ValueType_Real, binding.reference,
+                routing_.real_slots()[binding.slot]));
+        }
+        for (const auto& binding : routes->inputs[SimProtocol::ValueType_Integer]) {
+            input_offsets_.push_back(SimProtocol::CreateVariable(
+                builder, 0, SimProtocol::ValueType_Integer, binding.reference,
+                0.0, routing_.integer_slots()[binding.slot]));
+        }
+        for (const auto& binding : routes->inputs[SimProtocol::ValueType_Boolean]) {
+            input_offsets_.push_back(SimProtocol::CreateVariable(
+                builder, 0, SimProtocol::ValueType_Boolean, binding.reference,
+                0.0, 0, routing_.boolean_slots()[binding.slot] != 0));
+        }
+        for (const auto& binding : routes->inputs[SimProtocol::ValueType_String]) {
+            auto text = routing_.string_value(binding.slot);
+            auto value = builder.CreateString(text.data(), text.size());
+            input_offsets_.push_back(SimProtocol::CreateVariable(
+                builder, 0, SimProtocol::ValueType_String, binding.reference,
+                0.0, 0, false, value));
+        }
+    }
+
     auto request = SimProtocol::CreateStepRequest(
         builder,
         timestep_us,
-        builder.CreateVector(std::vector<flatbuffers::Offset<SimProtocol::Variable>>())  // Empty inputs for now
+        builder.CreateVector(input_offsets_.data(), input_offsets_.size()),
+        conn.client_id
     );
-    
+
     auto message = SimProtocol::CreateMessage(
         builder,
         SimProtocol::MessageType_StepRequest,
         request.Union());
-    
+
     builder.Finish(message);
+}
+
+void QuicServer::build_signal_request(flatbuffers::FlatBufferBuilder& builder, const RoutingTable::ClientRoutes* routes,
+                                      const Connection& conn, uint64_t timestep_us, uint32_t steps,
+                                      bool pooled_strings) {
+    static const std::vector<RoutingTable::Binding> kNoBindings;
+    auto bindings = [routes](SimProtocol::ValueType type) -> const std::vector<RoutingTable::Binding>& {
+        return routes ? routes->inputs[type] : kNoBindings;
+    };
+
+    // Each vector is filled before the next one is started, which may move the buffer
+    auto refs_of = [&builder](const std::vector<RoutingTable::Binding>& list) {
+        uint32_t* refs = nullptr;
+        auto vector = builder.CreateUninitializedVector(list.size(), &refs);
+        for (size_t i = 0; i < list.size(); ++i) refs[i] = list[i].reference;
+        return vector;
+    };
+    auto values_of = [&builder](const std::vector<RoutingTable::Binding>& list, const auto* slots) {
+        using T = std::decay_t<decltype(*slots)>;
+        T* values = nullptr;
+        auto vector = builder.CreateUninitializedVector(list.size(), &values);
+        for (size_t i = 0; i < list.size(); ++i) values[i] = slots[list[i].slot];
+        return vector;
+    };
+
+    const auto& reals = bindings(SimProtocol::ValueType_Real);
+    const auto& integers = bindings(SimProtocol::ValueType_Integer);
+    const auto& booleans = bindings(SimProtocol::ValueType_Boolean);
+    const auto& strings = bindings(SimProtocol::ValueType_String);
+
+    // A client holding the slot map knows the references of these; only strings and binaries name theirs
+    using RefVector = flatbuffers::Offset<flatbuffers::Vector<uint32_t>>;
+    RefVector real_refs, integer_refs, boolean_refs;
+    if (!conn.positional) real_refs = refs_of(reals);
+    auto real_values = values_of(reals, routing_.real_slots());
+    if (!conn.positional) integer_refs = refs_of(integers);
+    auto integer_values = values_of(integers, routing_.integer_slots());
+    if (!conn.positional) boolean_refs = refs_of(booleans);
+    auto boolean_values = values_of(booleans, routing_.boolean_slots());
+
+    // A local client reads its strings out of the pool, held there by hold_strings()
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> string_values;
+    RefVector pool_offsets;
+    if (pooled_strings) {
+        uint32_t* offsets = nullptr;
+        pool_offsets = builder.CreateUninitializedVector(strings.size(), &offsets);
+        for (size_t i = 0; i < strings.size(); ++i) offsets[i] = routing_.string_offset(strings[i].slot);
+    } else {
+        string_offsets_.clear();
+        for (const auto& binding : strings) {
+            auto text = routing_.string_value(binding.slot);
+            string_offsets_.push_back(builder.CreateString(text.data(), text.size()));
+        }
+        string_values = builder.CreateVector(string_offsets_);
+    }
+    auto string_refs = refs_of(strings);
+
+    const auto& binaries = bindings(SimProtocol::ValueType_Binary);
+    outgoing_blobs_.clear();
+    auto binary_refs = refs_of(binaries);
+    SimProtocol::BlobRef* blob_refs = nullptr;
+    auto binary_values = builder.CreateUninitializedVectorOfStructs(binaries.size(), &blob_refs);
+    for (size_t i = 0; i < binaries.size(); ++i) {
+        blob_refs[i] = forward_blob(conn, routing_.binary_slots()[binaries[i].slot]);
+    }
+
+    auto inputs = SimProtocol::CreateSignalVector(
+        builder,
+        real_refs, real_values,
+        integer_refs, integer_values,
+        boolean_refs, boolean_values,
+        string_refs, string_values,
+        binary_refs, binary_values,
+        pool_offsets);
+
+    // The further steps of a batch take their inputs from the client's
+    // profile, at the time each starts; without one, inputs hold
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SimProtocol::TrajectoryStep>>> trajectory;
+    if (steps > 1) {
+        trajectory_offsets_.clear();
+        for (uint32_t i = 1; i < steps; ++i) {
+            flatbuffers::Offset<SimProtocol::SignalVector> held;
+            if (conn.profile) held = conn.profile->inputs_at(builder, sim_time_us_ + i * timestep_us);
+            trajectory_offsets_.push_back(SimProtocol::CreateTrajectoryStep(builder, timestep_us, held));
+        }
+        trajectory = builder.CreateVector(trajectory_offsets_);
+    }
+
+    auto request = SimProtocol::CreateStepRequestV2(
+        builder, timestep_us, conn.client_id, inputs, trajectory, steps > 1 && conn.batch_all_outputs);
+    builder.Finish(SimProtocol::CreateMessage(
+        builder,
+        SimProtocol::MessageType_StepRequestV2,
+        request.Union()));
+}
+
+bool QuicServer::hold_strings(Connection& conn) {
+    if (!conn.is_local || !string_pool_) return false;
+    if (conn.string_reader >= SharedStringPool::kMaxReaders) {
+        if (~string_readers_ == 0) return false;
+        uint32_t reader = 0;
+        while (string_readers_ & (1ull << reader)) ++reader;
+        string_readers_ |= 1ull << reader;
+        conn.string_reader = reader;
+        // Unanswered requests fill at most both rings and the one being answered
+        conn.string_holds.assign(2 * ring_slots_ + 1, 0);
+        conn.holds_front = 0;
+        conn.holds_count = 0;
+    }
+    if (conn.holds_count == conn.string_holds.size()) {
+        throw std::runtime_error("Local client " + std::to_string(conn.client_id) + " has too many unanswered requests");
+    }
+
+    // Every request is held, so responses release them in order
+    uint64_t generation = string_pool_->generation();
+    conn.string_holds[(conn.holds_front + conn.holds_count) % conn.string_holds.size()] = generation;
+    if (conn.holds_count++ == 0) string_pool_->hold(conn.string_reader, generation);
+    return true;
+}
+
+void QuicServer::release_strings(Connection& conn) {
+    if (conn.holds_count == 0) return;
+    conn.holds_front = (conn.holds_front + 1) % conn.string_holds.size();
+    if (--conn.holds_count == 0) {
+        string_pool_->end_read(conn.string_reader);
+    } else {
+        string_pool_->hold(conn.string_reader, conn.string_holds[conn.holds_front]);
+    }
+}
+
+SimProtocol::BlobRef QuicServer::forward_blob(const Connection& conn, const RoutingTable::BinaryValue& value) {
+    if (!value.blob && value.offset == 0) return SimProtocol::BlobRef(0, 0, 0, 0);
+
+    if (!conn.is_local) {
+        uint64_t id = ++blob_count_;
+        outgoing_blobs_.push_back({id, value});
+        return SimProtocol::BlobRef(id, 0, 0, value.size);
+    }
+
+    // A local producer's value is read where it lies; a received one is copied into store 0
+    if (!value.blob) return SimProtocol::BlobRef(0, value.store, value.offset, value.size);
+    auto it = blob_stores_.find(0);
+    uint32_t offset = it != blob_stores_.end() ? it->second.write(binary_view(value)) : SharedBlobStore::kNoSlot;
+    if (offset == SharedBlobStore::kNoSlot) {
+        throw std::runtime_error("No blob slot for a value of " + std::to_string(value.size) + " bytes");
+    }
+    return SimProtocol::BlobRef(0, 0, offset, value.size);
+}
+
+BinaryView QuicServer::binary_view(const RoutingTable::BinaryValue& value) const {
+    if (value.blob) return {value.blob->data(), value.blob->size()};
+    auto it = blob_stores_.find(value.store);
+    return it != blob_stores_.end() ? it->second.view(value.offset, value.size) : BinaryView{};
+}
+
+bool QuicServer::step(uint64_t timestep_us) {
+    auto step_start = PhaseLatencies::now();
+    poll_local_responses();
+    if (!routing_ready_.load(std::memory_order_acquire)) return true;
+
+    // A reconfiguration takes over between two steps
+    if (epoch_ready_.load(std::memory_order_acquire)) swap_epoch();
+
+    // The outputs routed so far, with those of the next step of a batch
+    // response, hold at the time this step starts from
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        for (auto& conn : connections_) {
+            if (!conn.held_response.empty()) release_held_outputs(conn, false);
+        }
+        if (recorder_) recorder_->record(sim_time_us_, routing_);
+    }
     
-    // Send to all clients
-    for (const auto& conn : connections_) {
+    // Send to all clients, each read and serialized under one lock
+    for (auto& conn : connections_) {
+        // The previous request is read in place until MsQuic is done with it
+        if (!conn.is_local && !wait_for_send(*conn.request_send)) {
+            async_log(LogCategory::Network, "Previous request to client {} is still being sent", conn.client_id);
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(routing_mutex_);
+        // The slot map goes ahead of the first request that relies on it
+        if (conn.slot_map_wanted) {
+            lock.unlock();
+            send_slot_map(conn);
+            lock.lock();
+        }
+
+        // A batched client gets one request covering its next batch_steps steps
+        uint32_t steps = batch_size(conn);
+        if (steps > 1) {
+            bool due = conn.batch_position == 0;
+            conn.batch_position = (conn.batch_position + 1) % steps;
+            if (!due) continue;
+        }
+
         if (conn.is_local) {
-            // Use shared memory
-            // TODO: Copy to shared memory region
+            // Build the request in place in the client's request ring
+            auto* local_builder = conn.request_writer->begin();
+            if (!local_builder) {
+                async_log(LogCategory::Step, "Local client {} is not keeping up", conn.client_id);
+                return false;
+            }
+            try {
+                auto start = PhaseLatencies::now();
+                build_step_request(*local_builder, conn, timestep_us, steps);
+                lock.unlock();
+                start = conn.latencies->lap(kSerialize, start);
+                size_t bytes = local_builder->GetSize();
+                conn.request_writer->commit();
+                conn.latencies->lap(kSend, start);
+                if (conn.stats) {
+                    stats::add(conn.stats->requests.count, 1);
+                    stats::add(conn.stats->requests.bytes, bytes);
+                }
+            } catch (const std::exception& e) {
+                conn.request_writer->abort();
+                async_log(LogCategory::Step, "Failed to build local step request: {}", e.what());
+                return false;
+            }
         } else {
-            // Send via QUIC
-            // TODO: Implement QUIC send
+            // Send via QUIC once the client has connected
+            auto peer = client_connections_.find(conn.client_id);
+            if (peer == client_connections_.end()) continue;
+            auto quic = peer->second;
+
+            auto start = PhaseLatencies::now();
+            conn.builder->Clear();
+            build_step_request(*conn.builder, conn, timestep_us, steps);
+            bool compress = compresses(conn, conn.builder->GetSize());
+            lock.unlock();
+            start = conn.latencies->lap(kSerialize, start);
+
+            // Binary inputs travel ahead of the request that refers to them
+            for (const auto& outgoing : outgoing_blobs_) {
+                if (!blob_sender_.send(*quic, outgoing.id, binary_view(outgoing.value))) {
+                    async_log(LogCategory::Transfer, "Failed to send binary input to client {}", conn.client_id);
+                    return false;
+                }
+            }
+            outgoing_blobs_.clear();
+
+            const flatbuffers::FlatBufferBuilder* message = conn.builder.get();
+            if (compress) {
+                conn.packed->Clear();
+                if (compressor_.compress(conn.builder->GetBufferPointer(), conn.builder->GetSize(), *conn.packed)) {
+                    message = conn.packed.get();
+                }
+            }
+            conn.request_send->buffer.Length = static_cast<uint32_t>(message->GetSize());
+            conn.request_send->buffer.Buffer = message->GetBufferPointer();
+            if (!quic->send(*conn.request_send)) {
+                async_log(LogCategory::Network, "Failed to send step request to client {}", conn.client_id);
+                return false;
+            }
+            conn.latencies->lap(kSend, start);
+            if (conn.stats) {
+                stats::add(conn.stats->requests.count, 1);
+                stats::add(conn.stats->requests.bytes, message->GetSize());
+            }
         }
     }
-    
+
+    // Strings replaced this step are reused once no request refers to them any more
+    if (string_pool_) {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        string_pool_->publish();
+    }
+
+    publish_step(timestep_us, step_start);
     return true;
 }
 
+void QuicServer::publish_step(uint64_t timestep_us, PhaseLatencies::Clock::time_point step_start) {
+    auto end = PhaseLatencies::now();
+    trace_span(trace_track_, trace_step_, step_start, end);
+
+    // Lateness counts from the start of the first step
+    if (sim_time_us_ == 0) run_start_ = step_start;
+    sim_time_us_ += timestep_us;
+    if (!stats_) return;
+    auto ns = [](PhaseLatencies::Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    };
+    auto& run = stats_->run();
+    stats::add(run.steps, 1);
+    run.sim_time_us.store(sim_time_us_, std::memory_order_relaxed);
+    stats::set(run.lateness_ns, ns(end - run_start_) - static_cast<int64_t>(sim_time_us_) * 1000);
+    stats::set(run.step_ns, ns(end - step_start));
+    stats::set(run.updated_ns, ns(end.time_since_epoch()));
+}
+
 void QuicServer::prepare_simulation() {
-    // Pre-allocate resources
-    // TODO: Pre-allocate connection buffers
+    // Size the per-step containers for the client with the most inputs
+    size_t max_inputs = 0;
+    size_t max_strings = 0;
+    for (auto& conn : connections_) {
+        if (const auto* routes = routing_.routes(conn.client_id)) {
+            size_t inputs = 0;
+            for (const auto& bindings : routes->inputs) inputs += bindings.size();
+            max_inputs = std::max(max_inputs, inputs);
+            max_strings = std::max(max_strings, routes->inputs[SimProtocol::ValueType_String].size());
+        }
+        trajectory_offsets_.reserve(conn.batch_steps);
+        if (!conn.is_local && !conn.builder) {
+            conn.builder = std::make_unique<flatbuffers::FlatBufferBuilder>(64 * 1024);
+            conn.packed = std::make_unique<flatbuffers::FlatBufferBuilder>(64 * 1024);
+            conn.request_send = std::make_unique<PendingSend>();
+            conn.welcome = std::make_unique<flatbuffers::FlatBufferBuilder>(256);
+        }
+    }
+    input_offsets_.reserve(max_inputs);
+    string_offsets_.reserve(max_strings);
+}
+
+bool QuicServer::collect_responses() {
+    poll_local_responses();
+    std::lock_guard<std::mutex> lock(routing_mutex_);
+    return std::none_of(connections_.begin(), connections_.end(),
+                        [](const Connection& conn) { return conn.awaiting_response; });
 }
 
-void QuicServer::handle_client_message(uint32_t client_id, const uint8_t* data, size_t len) {
+void QuicServer::poll_local_responses() {
+    for (const auto& conn : connections_) {
+        if (!conn.is_local) continue;
+
+        // Messages are routed straight out of the segment and released afterwards
+        const uint8_t* data;
+        size_t len;
+        while (conn.response_ring->front(data, len)) {
+            handle_client_message(conn.client_id, data, len);
+            conn.response_ring->pop();
+        }
+    }
+}
+
+std::shared_ptr<QuicConnection> QuicServer::peer_of(uint32_t client_id) {
+    std::lock_guard<std::mutex> lock(routing_mutex_);
+    auto it = client_connections_.find(client_id);
+    return it != client_connections_.end() ? it->second : nullptr;
+}
+
+void QuicServer::handle_client_message(uint32_t client_id, const uint8_t* data, size_t len,
+                                       const std::shared_ptr<QuicConnection>& peer) {
+    auto start = PhaseLatencies::now();
     auto msg = flatbuffers::GetRoot<SimProtocol::Message>(data);
-    
-    if (msg->message_type_type() == SimProtocol::MessageType_StepResponse) {
-        auto response = msg->message_type_as_StepResponse();
-        // Process response and update connected clients
-        // TODO: Implement response handling
+    const uint8_t* message = data;
+    size_t message_size = len;
+
+    // QUIC messages arrive on several MsQuic threads, each with its own buffer
+    thread_local std::vector<uint8_t> inflated;
+    if (const auto* compressed = msg->message_type_as_CompressedMessage()) {
+        if (!decompress_message(compressed, inflated)) {
+            async_log(LogCategory::Protocol, "Dropping corrupt compressed message");
+            return;
+        }
+        msg = flatbuffers::GetRoot<SimProtocol::Message>(inflated.data());
+        message = inflated.data();
+        message_size = inflated.size();
+    }
+
+    if (const auto* hello = msg->message_type_as_Hello()) {
+        handle_hello(client_id, hello, start, peer);
+
+    } else if (const auto* trace = msg->message_type_as_TraceData()) {
+        handle_trace_data(client_id, trace);
+
+    } else if (const auto* chunk = msg->message_type_as_BlobChunk()) {
+        assembler_.add(chunk);
+
+    } else if (const auto* table = msg->message_type_as_VariableTable()) {
+        handle_variable_table(client_id, table);
+
+    } else if (const auto* response = msg->message_type_as_StepResponse()) {
+        // Responses over a shared host connection name the client they belong to
+        if (response->instance_id() != 0) client_id = response->instance_id();
+        // Store connected outputs in their slots; they are sent with the next step requests
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        auto* conn = record_round_trip(client_id, start, len);
+        const auto* routes = routing_.routes(client_id);
+        if (!routes) return;
+        routing_.store_variables(*routes, response->outputs());
+        if (conn) conn->latencies->lap(kRoute, start);
+
+    } else if (const auto* response = msg->message_type_as_StepResponseV2()) {
+        if (response->instance_id() != 0) client_id = response->instance_id();
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        auto* conn = record_round_trip(client_id, start, len);
+        const auto* routes = routing_.routes(client_id);
+        if (!routes) return;
+        const auto* step_outputs = response->step_outputs();
+        if (conn && step_outputs && step_outputs->size() > 0) {
+            // step() routes the outputs of a batch one step at a time, each
+            // for the step after the one that produced it; what is left of an
+            // earlier batch goes first
+            if (!conn->held_response.empty()) release_held_outputs(*conn, true);
+            conn->held_response.assign(message, message + message_size);
+            conn->held_next = 0;
+        } else {
+            // Values by position follow the client's map only if it is the current epoch's
+            bool positional = conn && response->slot_map() == conn->map_epoch;
+            store_signals(*routes, response->outputs(), positional);
+        }
+        if (conn) conn->latencies->lap(kRoute, start);
+    }
+}
+
+void QuicServer::release_held_outputs(Connection& conn, bool all) {
+    const auto* response =
+        flatbuffers::GetRoot<SimProtocol::Message>(conn.held_response.data())->message_type_as_StepResponseV2();
+    const auto* step_outputs = response->step_outputs();
+    const auto* routes = routing_.routes(conn.client_id);
+    bool positional = response->slot_map() == conn.map_epoch;
+    do {
+        bool last = conn.held_next >= step_outputs->size();
+        if (routes) {
+            store_signals(*routes, last ? response->outputs() : step_outputs->Get(conn.held_next), positional);
+        }
+        ++conn.held_next;
+        if (last) {
+            conn.held_response.clear();
+            return;
+        }
+    } while (all);
+}
+
+std::unique_ptr<InputProfile> QuicServer::load_profile(uint32_t client_id, const std::string& path,
+                                                       const RoutingTable& routing) {
+    try {
+        auto profile = std::make_unique<InputProfile>(path, client_id, routing);
+        std::cout << "Client " << client_id << " takes " << profile->size()
+                  << " batched inputs from " << path << std::endl;
+        return profile;
+    } catch (const std::exception& e) {
+        std::cerr << "No input profile for client " << client_id << ", inputs hold over its batches: "
+                  << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+QuicServer::Connection* QuicServer::record_round_trip(uint32_t client_id, PhaseLatencies::Clock::time_point received,
+                                                     size_t bytes) {
+    auto it = connection_index_.find(client_id);
+    if (it == connection_index_.end()) return nullptr;
+    auto* conn = it->second;
+    conn->awaiting_response = false;
+    release_strings(*conn);
+
+    // A connection sent no request yet has no round trip to time
+    if (conn->requested_at == PhaseLatencies::Clock::time_point{}) return conn;
+    conn->latencies->record(kRoundTrip, conn->requested_at, received);
+    if (conn->stats) {
+        auto round_trip = std::chrono::duration_cast<std::chrono::nanoseconds>(received - conn->requested_at).count();
+        auto& responses = conn->stats->responses;
+        stats::add(responses.count, 1);
+        stats::add(responses.bytes, bytes);
+        stats::add(responses.round_trip_ns, static_cast<uint64_t>(std::max<int64_t>(0, round_trip)));
+        stats::set(responses.last_round_trip_ns, round_trip);
+    }
+    return conn;
+}
+
+void QuicServer::store_signals(const RoutingTable::ClientRoutes& routes, const SimProtocol::SignalVector* outputs,
+                               bool positional) {
+    if (!outputs) return;
+    routing_.store_signals(routes, outputs, positional);
+
+    const auto* binary_refs = outputs->binary_refs();
+    const auto* binary_values = outputs->binary_values();
+    if (!binary_refs || !binary_values) return;
+    size_t count = std::min<size_t>(binary_refs->size(), binary_values->size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto* ref = binary_values->Get(i);
+
+        // Received blobs are taken even when unconnected, so the assembler lets go of them
+        std::shared_ptr<const Blob> blob;
+        if (ref->blob_id() != 0) {
+            blob = assembler_.take(ref->blob_id());
+            if (!blob) continue;
+        }
+        const auto* binding = RoutingTable::find_output(routes, SimProtocol::ValueType_Binary, binary_refs->Get(i));
+        if (!binding) continue;
+
+        auto& slot = routing_.binary_slots()[binding->slot];
+        slot.blob = std::move(blob);
+        slot.store = ref->store();
+        slot.offset = ref->offset();
+        slot.size = ref->size();
+    }
+}
+
+void QuicServer::handle_hello(uint32_t client_id, const SimProtocol::Hello* hello,
+                              PhaseLatencies::Clock::time_point received,
+                              const std::shared_ptr<QuicConnection>& peer) {
+    std::vector<uint32_t> ids;
+    if (const auto* client_ids = hello->client_ids()) {
+        for (uint32_t id : *client_ids) ids.push_back(id);
+    }
+    if (ids.empty()) ids.push_back(client_id);
+
+    uint32_t version = negotiated_version(hello->protocol_version());
+    uint32_t features = static_cast<uint32_t>(hello->features()) & kSupportedFeatures;
+    Connection* first = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        for (uint32_t id : ids) {
+            auto it = connection_index_.find(id);
+            if (it == connection_index_.end()) continue;
+            it->second->protocol_version = version;
+            it->second->features = features;
+            if (id == ids.front()) first = it->second;
+            // A reconnecting client replaces its old connection
+            if (peer && !it->second->is_local) client_connections_[id] = peer;
+        }
+    }
+
+    // Answer over the transport the Hello arrived on; one Welcome per connection
+    if (!first) return;
+    auto& conn = *first;
+    uint32_t threshold = has_feature(features, SimProtocol::Feature_Compression) ? conn.compression_threshold : 0;
+    if (conn.is_local) {
+        auto* builder = conn.request_writer->begin();
+        if (!builder) {
+            std::cerr << "Request ring of client " << conn.client_id << " full" << std::endl;
+            return;
+        }
+        // Local clients share the server's clock; an empty reading keeps their offset at 0
+        build_welcome(*builder, features, threshold, HandshakeClock{}, !trace_file_.empty());
+        conn.request_writer->commit();
+    } else {
+        if (!peer || !conn.welcome) return;
+        conn.welcome->Clear();
+        build_welcome(*conn.welcome, features, threshold,
+                      HandshakeClock{hello->clock_ns(), trace_clock_ns(received)}, !trace_file_.empty());
+        if (!peer->send(conn.welcome->GetBufferPointer(), conn.welcome->GetSize())) {
+            std::cerr << "Failed to welcome client " << conn.client_id << std::endl;
+        }
+    }
+}
+
+void QuicServer::handle_variable_table(uint32_t client_id, const SimProtocol::VariableTable* table) {
+    if (table->instance_id() != 0) client_id = table->instance_id();
+
+    std::lock_guard<std::mutex> lock(routing_mutex_);
+    auto it = connection_index_.find(client_id);
+    if (it == connection_index_.end()) return;
+    auto& conn = *it->second;
+    if (const auto* variables = table->variables()) {
+        for (const auto* var : *variables) {
+            conn.variable_table.push_back({var->name() ? var->name()->str() : std::string(), var->reference(),
+                                           var->type(), var->causality()});
+        }
+    }
+    if (!table->last()) return;
+
+    std::vector<SignalVariable> variables = std::move(conn.variable_table);
+    conn.variable_table.clear();
+    if (catalog_.contains(client_id)) {
+        // Values keep their references if the client runs another FMU than the one resolved against
+        std::string differs = catalog_.mismatch(client_id, variables);
+        if (!differs.empty()) {
+            std::cerr << "Variable '" << differs << "' of client " << client_id
+                      << " differs from its FMU on the server" << std::endl;
+            return;
+        }
+    } else {
+        catalog_.add(client_id, std::move(variables));
+        bool complete = std::all_of(connections_.begin(), connections_.end(),
+                                    [this](const Connection& other) { return catalog_.contains(other.client_id); });
+        if (complete && !routing_ready_.load(std::memory_order_relaxed)) {
+            resolve_connections();
+            prepare_simulation();
+            std::cout << "Resolved the connections with the variable tables of the clients" << std::endl;
+        }
+    }
+    conn.slot_map_wanted = has_feature(conn.features, SimProtocol::Feature_SlotMap);
+}
+
+void QuicServer::send_slot_map(Connection& conn) {
+    // Runs of references in message order: real, integer and boolean inputs, then outputs
+    static const std::vector<RoutingTable::Binding> kNoBindings;
+    constexpr size_t kRuns = 2 * std::tuple_size<SlotMapRefs>::value;
+
+    // A local message fits a ring slot; over QUIC 8KB of references go in one
+    size_t budget = conn.is_local
+        ? std::max<size_t>(16, conn.request_writer->slot_size() / 2 / sizeof(uint32_t)) : 2048;
+    std::shared_ptr<QuicConnection> quic;
+    if (!conn.is_local) {
+        quic = peer_of(conn.client_id);
+        if (!quic) return;
     }
+
+    bool complete = false;
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        const auto* routes = routing_.routes(conn.client_id);
+        auto run = [routes](size_t index) -> const std::vector<RoutingTable::Binding>& {
+            if (!routes) return kNoBindings;
+            return index < kRuns / 2 ? routes->inputs[index] : routes->outputs[index - kRuns / 2];
+        };
+        size_t total = 0;
+        for (size_t index = 0; index < kRuns; ++index) total += run(index).size();
+
+        SlotMapRefs inputs, outputs;
+        while (!complete) {
+            // The next `budget` references, an empty map still being one message
+            size_t end = std::min(total, conn.slot_map_sent + budget);
+            size_t position = 0;
+            for (size_t index = 0; index < kRuns; ++index) {
+                auto& refs = index < kRuns / 2 ? inputs[index] : outputs[index - kRuns / 2];
+                refs.clear();
+                for (const auto& binding : run(index)) {
+                    if (position >= conn.slot_map_sent && position < end) refs.push_back(binding.reference);
+                    ++position;
+                }
+            }
+
+            bool last = end == total;
+            if (conn.is_local) {
+                // The rest goes ahead of a later step if the ring is full
+                auto* builder = conn.request_writer->begin();
+                if (!builder) break;
+                build_slot_map(*builder, conn.client_id, inputs, outputs, last, conn.map_epoch);
+                conn.request_writer->commit();
+            } else {
+                conn.slot_map_messages.push_back(std::make_unique<flatbuffers::FlatBufferBuilder>(
+                    (end - conn.slot_map_sent) * sizeof(uint32_t) + 256));
+                build_slot_map(*conn.slot_map_messages.back(), conn.client_id, inputs, outputs, last,
+                               conn.map_epoch);
+            }
+            conn.slot_map_sent = end;
+            complete = last;
+        }
+        if (complete) conn.slot_map_wanted = false;
+    }
+
+    // send() copies the messages, so they need not outlive this call
+    bool sent = true;
+    for (const auto& message : conn.slot_map_messages) {
+        if (!sent) break;
+        sent = quic->send(message->GetBufferPointer(), message->GetSize());
+    }
+    conn.slot_map_messages.clear();
+    if (!sent) {
+        std::cerr << "Failed to send the slot map of client " << conn.client_id << std::endl;
+        return;
+    }
+    conn.positional = complete;
+}
+
+bool QuicServer::reconfigure(const std::string& path) {
+    if (!routing_ready_.load(std::memory_order_acquire)) {
+        std::cerr << "Cannot reconfigure before the connections are resolved" << std::endl;
+        return false;
+    }
+    if (reconfiguring_.exchange(true)) {
+        std::cerr << "A reconfiguration is already under way" << std::endl;
+        return false;
+    }
+    if (reconfigure_thread_.joinable()) reconfigure_thread_.join();
+
+    // Reading FMUs and resolving connections takes longer than a step, so it runs aside
+    std::string source = path.empty() ? config_path_ : path;
+    reconfigure_thread_ = std::thread([this, source] {
+        try {
+            next_epoch_ = build_epoch(source);
+            epoch_ready_.store(true, std::memory_order_release);
+            return;
+        } catch (const std::exception& e) {
+            std::cerr << "Staying in epoch " << epoch() << ": " << e.what() << std::endl;
+        }
+        reconfiguring_.store(false, std::memory_order_release);
+    });
+    return true;
+}
+
+std::unique_ptr<QuicServer::Epoch> QuicServer::build_epoch(const std::string& path) {
+    PhaseTimer timer;
+    std::unique_ptr<RunPlan> plan;
+    YAML::Node config;
+    if (RunPlan::is_plan(path)) {
+        plan = std::make_unique<RunPlan>(path);
+        plan->check_fmus();
+        config = plan->settings();
+    } else {
+        config = YAML::LoadFile(path);
+    }
+
+    auto epoch = std::make_unique<Epoch>();
+    epoch->number = epoch_.load(std::memory_order_relaxed) + 1;
+    // The table writes no string to the pool before swap_epoch() takes it over
+    epoch->routing.use_string_pool(string_pool_.get());
+
+    // Only swap_epoch() changes the connections and routes, and it waits for
+    // this epoch, so they are read here as they stand
+    std::map<uint32_t, Connection*> running;
+    ModelCatalog previous;
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        running = connection_index_;
+        previous = catalog_;
+    }
+
+    uint32_t compression_threshold = config["server"]["compression_threshold"].as<uint32_t>(0);
+    for (const auto& client : config["clients"]) {
+        auto settings = client_settings(client, compression_threshold);
+        std::string name = std::to_string(settings.id);
+        if (!epoch->settings.emplace(settings.id, settings).second) {
+            throw std::runtime_error("Client " + name + " is listed twice");
+        }
+        auto it = running.find(settings.id);
+        if (it != running.end() && it->second->is_local != settings.is_local) {
+            throw std::runtime_error("Client " + name + " cannot change its type while running");
+        }
+        epoch->clients.push_back(settings.id);
+    }
+    timer.mark("config");
+
+    // Running clients keep the table they were resolved with; one whose FMU
+    // changed has to be added again under another id
+    FmuCache cache(config["fmu_cache"].as<std::string>(""));
+    auto models = plan ? plan_models(*plan) : client_models(config["clients"], cache);
+    if (models.size() != epoch->clients.size()) throw std::runtime_error("Run plan does not match its clients");
+    for (size_t i = 0; i < models.size(); ++i) {
+        uint32_t id = epoch->clients[i];
+        if (running.count(id) && previous.contains(id)) {
+            if (models[i]) {
+                std::string differs = previous.mismatch(id, signal_variables(*models[i]));
+                if (!differs.empty()) {
+                    throw std::runtime_error("Variable '" + differs + "' of running client " + std::to_string(id) +
+                                             " differs from its FMU");
+                }
+            }
+            epoch->catalog.add(id, *previous.table(id));
+        } else if (models[i]) {
+            epoch->catalog.add(id, models[i]);
+        } else {
+            throw std::runtime_error("No variable table for added client " + std::to_string(id));
+        }
+    }
+    timer.mark("model descriptions");
+
+    if (plan) {
+        load_plan_routes(*plan, epoch->routing);
+    } else {
+        const auto& catalog = epoch->catalog;
+        bool resolved = epoch->routing.build(signal_connections(config["connections"]),
+            [&catalog](uint32_t client_id, const std::string& name, RoutingTable::VariableInfo& info) {
+                return catalog.resolve(client_id, name, info);
+            });
+        if (!resolved) throw std::runtime_error("The connections of " + path + " do not resolve");
+    }
+
+    // Recorded outputs keep their slots, so the columns of a removed client hold its last values
+    if (recorder_) {
+        for (const auto& column : recorder_->columns()) {
+            epoch->routing.add_output(column.client_id, column.type, column.reference);
+        }
+        epoch->recorder_slots = recorder_->slots_in(epoch->routing);
+    }
+    for (uint32_t id : epoch->clients) {
+        const auto& path = epoch->settings.at(id).input_profile;
+        if (!path.empty()) epoch->profiles[id] = load_profile(id, path, epoch->routing);
+    }
+    epoch->carried = epoch->routing.carried_from(routing_);
+    for (uint32_t id : epoch->clients) {
+        if (running.count(id) && !same_slot_map(routing_.routes(id), epoch->routing.routes(id))) {
+            epoch->remapped.push_back(id);
+        }
+    }
+    timer.mark("routing");
+
+    // Blob stores are never freed: a client added again writes to the one it
+    // had, and store 0 only serves as many forwarded values as it was sized for
+    size_t forwarded = 0;
+    std::vector<std::pair<uint32_t, size_t>> new_stores;
+    for (size_t i = 0; i < models.size(); ++i) {
+        const auto& settings = epoch->settings.at(epoch->clients[i]);
+        if (!settings.is_local) continue;
+        if (const auto* routes = epoch->routing.routes(settings.id)) {
+            forwarded += routes->inputs[SimProtocol::ValueType_Binary].size();
+        }
+        if (running.count(settings.id) || !models[i]) continue;
+        size_t outputs = binary_outputs(*models[i]);
+        auto store = blob_stores_.find(settings.id);
+        if (store == blob_stores_.end()) {
+            if (outputs > 0) new_stores.emplace_back(settings.id, outputs);
+        } else if (store->second.slot_count() < blob_store_slots(outputs)) {
+            throw std::runtime_error("Blob store of client " + std::to_string(settings.id) + " is too small to reuse");
+        }
+    }
+    auto forward = blob_stores_.find(0);
+    if (forward == blob_stores_.end()) {
+        if (forwarded > 0) new_stores.emplace_back(0, forwarded);
+    } else if (forward->second.slot_count() < blob_store_slots(forwarded)) {
+        throw std::runtime_error("More binary values are forwarded to local clients than the server has room for");
+    }
+    for (const auto& store : new_stores) epoch->stores.emplace_back(store.first, create_blob_store(store.first, store.second));
+
+    for (uint32_t id : epoch->clients) {
+        auto it = running.find(id);
+        if (it != running.end()) {
+            epoch->index[id] = it->second;
+            continue;
+        }
+        epoch->added.push_back(create_connection(epoch->settings.at(id)));
+        epoch->added.back().map_epoch = epoch->number;
+        epoch->index[id] = &epoch->added.back();
+    }
+    timer.mark("connections");
+    timer.report("Epoch " + std::to_string(epoch->number));
+    return epoch;
+}
+
+void QuicServer::swap_epoch() {
+    auto epoch = std::move(next_epoch_);
+    epoch_ready_.store(false, std::memory_order_relaxed);
+    size_t added = epoch->added.size();
+    size_t removed = 0;
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        epoch->routing.take_values(routing_, epoch->carried);
+        routing_ = std::move(epoch->routing);
+        catalog_ = std::move(epoch->catalog);
+        for (const auto& store : epoch->stores) blob_stores_.emplace(store.first, store.second);
+
+        // Connections are taken into the new step order; those left over are retired
+        connections_.splice(connections_.end(), epoch->added);
+        std::map<uint32_t, std::list<Connection>::iterator> positions;
+        for (auto it = connections_.begin(); it != connections_.end(); ++it) positions.emplace(it->client_id, it);
+        std::list<Connection> schedule;
+        for (uint32_t id : epoch->clients) schedule.splice(schedule.end(), connections_, positions.at(id));
+        removed = connections_.size();
+        for (auto& conn : connections_) {
+            if (conn.string_reader >= SharedStringPool::kMaxReaders) continue;
+            string_pool_->end_read(conn.string_reader);
+            string_readers_ &= ~(1ull << conn.string_reader);
+            conn.string_reader = SharedStringPool::kMaxReaders;
+            conn.holds_count = 0;
+        }
+        retired_.splice(retired_.end(), connections_);
+        connections_.swap(schedule);
+        connection_index_ = std::move(epoch->index);
+        for (auto& conn : connections_) {
+            apply_settings(conn, epoch->settings.at(conn.client_id));
+            auto profile = epoch->profiles.find(conn.client_id);
+            conn.profile = profile != epoch->profiles.end() ? std::move(profile->second) : nullptr;
+        }
+
+        // The stats segment has a row per client, so a new client list gets a
+        // new segment; quicsim-top sees its new start time and attaches again
+        if (stats_ && (added > 0 || removed > 0)) {
+            std::vector<std::pair<uint32_t, bool>> stats_clients;
+            for (const auto& conn : connections_) stats_clients.emplace_back(conn.client_id, conn.is_local);
+            stats_->republish(stats_clients);
+            size_t stats_index = 0;
+            for (auto& conn : connections_) conn.stats = &stats_->client(stats_index++);
+            for (auto& conn : retired_) conn.stats = nullptr;
+        }
+
+        // A client whose values travel in another order gets a new map ahead of its next request
+        for (uint32_t id : epoch->remapped) {
+            auto& conn = *connection_index_.at(id);
+            conn.map_epoch = epoch->number;
+            if (!conn.positional && !conn.slot_map_wanted && conn.slot_map_sent == 0) continue;
+            conn.slot_map_wanted = true;
+            conn.slot_map_sent = 0;
+            conn.positional = false;
+        }
+
+        if (recorder_) recorder_->set_slots(epoch->recorder_slots);
+        prepare_simulation();
+        epoch_.store(epoch->number, std::memory_order_relaxed);
+    }
+    reconfiguring_.store(false, std::memory_order_release);
+    async_log(LogCategory::Step, "Routing epoch {}: {} clients, {} added, {} removed",
+              epoch->number, connections_.size(), added, removed);
+}
+
+void QuicServer::handle_trace_data(uint32_t client_id, const SimProtocol::TraceData* data) {
+    if (data->instance_id() != 0) client_id = data->instance_id();
+
+    std::lock_guard<std::mutex> lock(routing_mutex_);
+    auto& process = client_traces_[client_id];
+    if (process.process.empty()) {
+        process.process = data->process() && data->process()->size() != 0
+            ? data->process()->str() : "client " + std::to_string(client_id);
+    }
+    if (const auto* names = data->names()) {
+        process.trace.names.clear();
+        for (const auto* name : *names) process.trace.names.push_back(name->str());
+    }
+    if (const auto* spans = data->spans()) {
+        for (const auto* span : *spans) {
+            process.trace.spans.push_back({span->track(), span->name(), span->begin_ns(), span->end_ns()});
+        }
+    }
+    if (data->last()) {
+        auto it = connection_index_.find(client_id);
+        if (it != connection_index_.end()) it->second->trace_pending = false;
+    }
+}
+
+bool QuicServer::write_trace() {
+    if (trace_file_.empty()) return true;
+
+    // A host hands over all of its spans with the first request on its connection and none with the rest
+    for (auto& conn : connections_) {
+        {
+            std::lock_guard<std::mutex> lock(routing_mutex_);
+            conn.trace_pending = true;
+        }
+        bool sent = false;
+        if (conn.is_local) {
+            if (auto* builder = conn.request_writer->begin()) {
+                build_trace_request(*builder, conn.client_id);
+                conn.request_writer->commit();
+                sent = true;
+            }
+        } else {
+            auto quic = peer_of(conn.client_id);
+            if (quic && conn.welcome) {
+                conn.welcome->Clear();
+                build_trace_request(*conn.welcome, conn.client_id);
+                sent = quic->send(conn.welcome->GetBufferPointer(), conn.welcome->GetSize());
+            }
+        }
+        if (!sent) {
+            std::cerr << "Cannot request the trace of client " << conn.client_id << std::endl;
+            std::lock_guard<std::mutex> lock(routing_mutex_);
+            conn.trace_pending = false;
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (;;) {
+        poll_local_responses();
+        {
+            std::lock_guard<std::mutex> lock(routing_mutex_);
+            if (std::none_of(connections_.begin(), connections_.end(),
+                             [](const Connection& conn) { return conn.trace_pending; })) {
+                break;
+            }
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            std::cerr << "Timed out collecting client traces, writing what arrived" << std::endl;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<ProcessTrace> processes;
+    processes.push_back({trace_process(), take_trace()});
+    {
+        std::lock_guard<std::mutex> lock(routing_mutex_);
+        for (auto& entry : client_traces_) {
+            if (!entry.second.trace.spans.empty()) processes.push_back(std::move(entry.second));
+        }
+        client_traces_.clear();
+    }
+    if (!write_chrome_trace(trace_file_, processes)) return false;
+    std::cout << "Wrote trace of " << processes.size() << " processes to " << trace_file_ << std::endl;
+    return true;
+}
+
+uint32_t QuicServer::batch_size(const Connection& conn) {
+    return conn.protocol_version >= 2 ? conn.batch_steps : 1;
+}
+
+bool QuicServer::compresses(const Connection& conn, size_t size) {
+    return has_feature(conn.features, SimProtocol::Feature_Compression) &&
+           conn.compression_threshold != 0 && size > conn.compression_threshold;
 }
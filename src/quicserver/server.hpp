@@ -1,12 +1,30 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
+#include <list>
 #include <string>
+#include <thread>
 #include <vector>
 #include <memory>
 #include <boost/interprocess/managed_shared_memory.hpp>
+#include <yaml-cpp/yaml.h>
 #include "simulation_protocol_generated.h"
+#include "common/blob_store.hpp"
+#include "common/blob_transfer.hpp"
+#include "common/compression.hpp"
+#include "common/latency.hpp"
 #include "common/network.hpp"
+#include "common/protocol.hpp"
+#include "common/string_pool.hpp"
+#include "common/shm_transport.hpp"
+#include "common/stats.hpp"
+#include "common/trace.hpp"
+#include "input_profile.hpp"
+#include "model_catalog.hpp"
+#include "recorder.hpp"
+#include "routing.hpp"
 #include <map>
+#include <mutex>
 
 class QuicServer {
 private:
@@ -16,22 +34,287 @@ private:
     
     // Shared memory for local connections
     std::unique_ptr<boost::interprocess::managed_shared_memory> shared_memory_;
+    std::unique_ptr<SharedStringPool> string_pool_;
+    uint64_t string_readers_ = 0;  // Reader slots of the pool in use, one bit each
     
     // Connection mapping
     struct Connection {
         bool is_local;  // true = shared memory, false = QUIC
         uint32_t client_id;
-        // Additional connection info
+        // Shared-memory rings, only set for local clients
+        std::unique_ptr<SharedMessageWriter> request_writer;
+        std::unique_ptr<SharedMessageRing> response_ring;
+        // Request builder of a QUIC client, reused across steps. The request,
+        // or its compressed form in `packed`, is sent in place through
+        // request_send, and neither builder is cleared while that is in flight.
+        std::unique_ptr<flatbuffers::FlatBufferBuilder> builder;
+        std::unique_ptr<PendingSend> request_send;
+        // Wire protocol and features agreed through the client's Hello; guarded by routing_mutex_
+        uint32_t protocol_version = 1;
+        uint32_t features = 0;
+        // Requests above this size are compressed if the client agreed, 0 = never
+        uint32_t compression_threshold = 0;
+        // Welcome and later trace request of a QUIC client, which are sent as
+        // copies, and its compressed requests
+        std::unique_ptr<flatbuffers::FlatBufferBuilder> welcome;
+        std::unique_ptr<flatbuffers::FlatBufferBuilder> packed;
+        // Open-loop clients get one request per batch_steps steps, with inputs
+        // held over the batch; batch_position counts the steps into the batch
+        uint32_t batch_steps = 1;
+        uint32_t batch_position = 0;
+        bool batch_all_outputs = false;
+        // Recording the later steps of a batch take their inputs from; without
+        // one they hold. Loaded with the routes of each epoch.
+        std::string input_profile;
+        std::unique_ptr<InputProfile> profile;
+        // Copy of a batch response with the outputs of every step. step()
+        // routes entry held_next of its step_outputs, then the final outputs,
+        // one per step; empty once all are routed. Guarded by routing_mutex_.
+        std::vector<uint8_t> held_response;
+        uint32_t held_next = 0;
+        // Step path timings; requested_at and awaiting_response are guarded by routing_mutex_
+        std::unique_ptr<PhaseLatencies> latencies;
+        PhaseLatencies::Clock::time_point requested_at;
+        bool awaiting_response = false;
+        // Set while the client's spans are being collected; guarded by routing_mutex_
+        bool trace_pending = false;
+        // Live counters in the stats segment; the response half is written under routing_mutex_
+        stats::ClientStats* stats = nullptr;
+        // Variable table arriving from the client, and whether a slot map is
+        // owed to it; both guarded by routing_mutex_
+        std::vector<SignalVariable> variable_table;
+        bool slot_map_wanted = false;
+        // References of the slot map sent so far, and the messages of it
+        // built for a QUIC client in one go. Once the whole map is sent,
+        // requests leave out the references of real, integer and boolean inputs.
+        // The map is stamped with the routing epoch it was built in; responses
+        // following an older one are not positional any more.
+        size_t slot_map_sent = 0;
+        std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>> slot_map_messages;
+        bool positional = false;
+        uint32_t map_epoch = 1;
+        // Reader slot of the string pool kept on behalf of a local client,
+        // and a ring of the pool generations of its unanswered requests,
+        // oldest first, the one the slot holds; guarded by routing_mutex_
+        uint32_t string_reader = SharedStringPool::kMaxReaders;
+        std::vector<uint64_t> string_holds;
+        size_t holds_front = 0;
+        size_t holds_count = 0;
     };
-    std::vector<Connection> connections_;
+    // Connections in step order. A list, so a reconfiguration moves them
+    // without invalidating connection_index_. Removed connections are
+    // retired rather than freed, as MsQuic may still read their buffers.
+    std::list<Connection> connections_;
+    std::list<Connection> retired_;
+    std::map<uint32_t, Connection*> connection_index_;
 
+    // Per-client entries of `clients:` that a reconfiguration may change
+    struct ClientSettings {
+        uint32_t id;
+        bool is_local;
+        uint32_t compression_threshold;
+        uint32_t batch_steps;
+        bool batch_all_outputs;
+        std::string input_profile;
+    };
+
+    // Phases timed per client: building and sending its request, the wait
+    // from request to response, and routing the response
+    enum Phase : size_t { kSerialize, kSend, kRoundTrip, kRoute };
+
+    // Signal routing between clients; QUIC responses arrive on MsQuic threads
+    ModelCatalog catalog_;
+    RoutingTable routing_;
+    std::mutex routing_mutex_;
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>> input_offsets_;
+    std::vector<flatbuffers::Offset<flatbuffers::String>> string_offsets_;
+    std::vector<flatbuffers::Offset<SimProtocol::TrajectoryStep>> trajectory_offsets_;
+    MessageCompressor compressor_;
+
+    // Connections are resolved once every client has a variable table; the
+    // tables of clients whose FMU the server cannot read come in over the
+    // wire. Until then step() sends nothing.
+    std::vector<RoutingTable::SignalConnection> pending_connections_;
+    std::atomic<bool> routing_ready_{false};
+
+    // Binary signals. Local clients with binary outputs write them to their
+    // own blob store, named after their client id; store 0 is the server's,
+    // for values from QUIC clients forwarded to local ones. Client ids start at 1.
+    std::map<uint32_t, SharedBlobStore> blob_stores_;
+    BlobAssembler assembler_;
+    BlobSender blob_sender_;
+    uint64_t blob_count_ = 0;
+    uint32_t ring_slots_ = 0;
+    uint32_t ring_slot_size_ = 0;
+    uint32_t blob_slot_size_ = 0;
+    // Named regions of the segment and their sizes, reused by clients re-added under their id
+    std::map<std::string, std::pair<void*, size_t>> shared_regions_;
+    // Blobs a QUIC request refers to, sent as chunks ahead of it
+    struct OutgoingBlob {
+        uint64_t id;
+        RoutingTable::BinaryValue value;
+    };
+    std::vector<OutgoingBlob> outgoing_blobs_;
+
+    // Listener, and the connection each QUIC client's Hello arrived on. Clients
+    // hosted by one process share its connection. Guarded by routing_mutex_.
     std::unique_ptr<QuicConnection> quic_connection_;
-    std::map<uint32_t, std::unique_ptr<QuicConnection>> client_connections_;
+    std::map<uint32_t, std::shared_ptr<QuicConnection>> client_connections_;
+
+    // Step spans of the server and, collected by write_trace(), of the clients,
+    // keyed by the client whose request they answer; guarded by routing_mutex_
+    std::string trace_file_;
+    uint32_t trace_track_ = 0;
+    uint32_t trace_step_ = 0;
+    std::map<uint32_t, ProcessTrace> client_traces_;
+
+    // Result file of the recorded outputs, if `recorder.file` is set; created once the routes are known
+    YAML::Node recorder_config_;
+    std::unique_ptr<Recorder> recorder_;
+
+    // Reconfiguration: the next epoch's routing table, schedule and new
+    // connections are built on reconfigure_thread_ from the configuration
+    // file, and step() swaps them in at the start of a step. Epochs count
+    // from 1.
+    struct Epoch {
+        uint32_t number = 0;
+        std::vector<uint32_t> clients;  // Step order
+        std::map<uint32_t, ClientSettings> settings;
+        std::list<Connection> added;
+        std::map<uint32_t, Connection*> index;
+        ModelCatalog catalog;
+        RoutingTable routing;
+        std::vector<RoutingTable::SlotMove> carried;
+        std::vector<uint32_t> remapped;  // Clients whose slot map changes
+        std::vector<std::pair<uint32_t, SharedBlobStore>> stores;
+        std::vector<uint32_t> recorder_slots;
+        std::map<uint32_t, std::unique_ptr<InputProfile>> profiles;
+    };
+    std::string config_path_;
+    std::atomic<uint32_t> epoch_{1};
+    std::unique_ptr<Epoch> next_epoch_;
+    std::atomic<bool> epoch_ready_{false};
+    std::atomic<bool> reconfiguring_{false};
+    std::thread reconfigure_thread_;
+
+    // Live statistics for quicsim-top, see common/stats.hpp
+    std::unique_ptr<StatsPublisher> stats_;
+    uint64_t sim_time_us_ = 0;
+    PhaseLatencies::Clock::time_point run_start_;
+
+    // Routes a message of local client `client_id`, or one that arrived over
+    // QUIC on `peer`, whose messages name their client
+    void handle_client_message(uint32_t client_id, const uint8_t* data, size_t len,
+                               const std::shared_ptr<QuicConnection>& peer = nullptr);
+
+    // Connection of a QUIC client, or nullptr before its Hello
+    std::shared_ptr<QuicConnection> peer_of(uint32_t client_id);
+
+    // Settings of one `clients:` entry, falling back to the server-wide compression threshold
+    static ClientSettings client_settings(const YAML::Node& client, uint32_t compression_threshold);
+    static void apply_settings(Connection& conn, const ClientSettings& settings);
+
+    // A connection with its timings and, for a local client, its message rings
+    Connection create_connection(const ClientSettings& settings);
+
+    // Reads the configuration at `path` into the next epoch. Throws
+    // std::runtime_error if it cannot take over from the running one.
+    std::unique_ptr<Epoch> build_epoch(const std::string& path);
+
+    // Moves the running state over to next_epoch_; step thread only
+    void swap_epoch();
+
+    // Records the protocol version of the clients behind a Hello, and for a
+    // QUIC client the connection it came on, and answers with a Welcome,
+    // which carries the clock readings for the trace offset
+    void handle_hello(uint32_t client_id, const SimProtocol::Hello* hello, PhaseLatencies::Clock::time_point received,
+                      const std::shared_ptr<QuicConnection>& peer);
+
+    // Adds the spans of a TraceData message to the client's trace
+    void handle_trace_data(uint32_t client_id, const SimProtocol::TraceData* data);
+
+    // Collects a client's variable table. A complete table is checked
+    // against the one the connections were resolved with, or, if the server
+    // had none, taken to resolve them; either way a slot map is owed.
+    void handle_variable_table(uint32_t client_id, const SimProtocol::VariableTable* table);
+
+    // Resolves the pending connections and sets up what depends on the
+    // routes; caller holds routing_mutex_ or runs before the clients connect
+    void resolve_connections();
 
-    void handle_client_message(uint32_t client_id, const uint8_t* data, size_t len);
+    // Sends as much of the slot map owed to `conn` as fits; step thread only
+    void send_slot_map(Connection& conn);
+
+    // Allocates a named, cache-line aligned region in the shared-memory
+    // segment, or returns the one allocated earlier under `name`
+    void* allocate_shared_region(const std::string& name, size_t bytes);
+
+    // Serializes a step request with the current inputs of `conn` into
+    // `builder`, in the protocol version agreed with that client. A v2
+    // request covers `steps` steps. Caller holds routing_mutex_.
+    void build_step_request(flatbuffers::FlatBufferBuilder& builder, Connection& conn,
+                            uint64_t timestep_us, uint32_t steps = 1);
+    void build_signal_request(flatbuffers::FlatBufferBuilder& builder, const RoutingTable::ClientRoutes* routes,
+                              const Connection& conn, uint64_t timestep_us, uint32_t steps, bool pooled_strings);
+
+    // Keeps the pool's strings of a request to local `conn` from being reused
+    // until it is answered; false if strings have to travel by value. Caller
+    // holds routing_mutex_.
+    bool hold_strings(Connection& conn);
+
+    // Lets go of the strings of the oldest request to `conn`; caller holds routing_mutex_
+    void release_strings(Connection& conn);
+
+    // Input profile `path` of a batched client under `routing`, or nullptr if it cannot be read
+    static std::unique_ptr<InputProfile> load_profile(uint32_t client_id, const std::string& path,
+                                                      const RoutingTable& routing);
+
+    // Routes the next held step of a batch response, or with `all` every
+    // one left; caller holds routing_mutex_
+    void release_held_outputs(Connection& conn, bool all);
+
+    // Steps covered by each request to `conn`; batches need protocol v2.
+    // Caller holds routing_mutex_.
+    uint32_t batch_size(const Connection& conn);
+
+    // Stores the connected outputs of a v2 response in their slots; caller holds routing_mutex_
+    void store_signals(const RoutingTable::ClientRoutes& routes, const SimProtocol::SignalVector* outputs,
+                       bool positional);
+
+    // Creates the blob stores of the local clients with binary outputs
+    void create_blob_stores(const std::vector<std::shared_ptr<const cosim::model_description>>& models);
+
+    // Creates store 0 once the routes show binary values forwarded to local clients
+    void create_forward_store();
+
+    // Formats a store holding `values` binary values at a time in flight
+    SharedBlobStore create_blob_store(uint32_t store_id, size_t values);
+    uint32_t blob_store_slots(size_t values) const;
+
+    // Where `conn` finds the binary value of a slot; caller holds routing_mutex_
+    SimProtocol::BlobRef forward_blob(const Connection& conn, const RoutingTable::BinaryValue& value);
+
+    // Bytes of a binary slot value
+    BinaryView binary_view(const RoutingTable::BinaryValue& value) const;
+
+    // True if a request of `size` bytes to `conn` goes out compressed; caller holds routing_mutex_
+    bool compresses(const Connection& conn, size_t size);
+
+    // Records the wait for a response of `bytes` received at `received`; caller holds routing_mutex_
+    Connection* record_round_trip(uint32_t client_id, PhaseLatencies::Clock::time_point received, size_t bytes);
+
+    // Advances the simulated time and publishes the counters of a finished step
+    void publish_step(uint64_t timestep_us, PhaseLatencies::Clock::time_point step_start);
+
+    // Routes all responses waiting in the local clients' response rings
+    void poll_local_responses();
 
 public:
     QuicServer(const std::string& config_path);
+    ~QuicServer();
+
+    QuicServer(const QuicServer&) = delete;
+    QuicServer& operator=(const QuicServer&) = delete;
     
     // Initialize server and load configuration
     bool init();
@@ -41,4 +324,24 @@ public:
     
     // Pre-allocate buffers and resources
     void prepare_simulation();
+
+    // Starts building the next epoch from the configuration file or run plan
+    // at `path`, by default the one the server started from: clients may be
+    // added, removed and reordered, and connections changed. step() swaps it
+    // in once built. False if the connections are not resolved yet or a
+    // reconfiguration is already under way; a file that cannot take over
+    // from the running epoch is reported and leaves the run as it is.
+    bool reconfigure(const std::string& path = "");
+
+    // Routing epoch the run is in
+    uint32_t epoch() const { return epoch_.load(std::memory_order_relaxed); }
+
+    // Routes the responses waiting in the local response rings. True once
+    // every client has answered its last request.
+    bool collect_responses();
+
+    // With server.trace_file set, collects the spans of every client and
+    // writes them with the server's own as one Chrome trace. Call once the
+    // run has stopped, while the clients are still connected.
+    bool write_trace();
 }; 
\ No newline at end of file
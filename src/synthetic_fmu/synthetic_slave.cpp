@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cppfmu_cs.hpp"
+
+// Co-simulation slave of a controlled shape, for scale tests without real
+// models. The shape comes from parameters whose start values the config
+// generator (tools/generate_synthetic.py) writes into the model description
+// and, for the slave to read at instantiation, into resources/parameters.txt.
+//
+// Value references, separate per type:
+//   Integer 0-5  real, integer and boolean input and output counts (fixed)
+//   Integer 6    seed of the change, jitter and failure draws
+//   Real 0       change_rate: fraction of outputs that change per step
+//   Real 1       work_us: busy-wait per step, in microseconds
+//   Real 2       jitter_us: largest extra busy-wait, drawn per step
+//   Real 3       failure_rate: probability that a step fails
+//   16 onwards   inputs, then outputs, of each type
+namespace {
+
+constexpr cppfmu::FMIValueReference kFirstSignal = 16;
+
+enum Count : size_t { kRealIn, kRealOut, kIntegerIn, kIntegerOut, kBooleanIn, kBooleanOut, kCountParameters };
+constexpr cppfmu::FMIValueReference kSeed = kCountParameters;
+
+enum Tunable : size_t { kChangeRate, kWorkUs, kJitterUs, kFailureRate, kTunables };
+
+const char* const kCountNames[] = {
+    "real_inputs", "real_outputs", "integer_inputs", "integer_outputs", "boolean_inputs", "boolean_outputs"};
+const char* const kTunableNames[] = {"change_rate", "work_us", "jitter_us", "failure_rate"};
+
+template <typename T>
+using Values = std::vector<T, cppfmu::Allocator<T>>;
+
+struct Parameters {
+    cppfmu::FMIInteger counts[kCountParameters] = {};
+    cppfmu::FMIInteger seed = 1;
+    cppfmu::FMIReal tunables[kTunables] = {1.0, 0.0, 0.0, 0.0};
+};
+
+// Local path of a file: URI as handed to fmi2Instantiate
+std::string uri_to_path(const std::string& uri) {
+    std::string path = uri.compare(0, 7, "file://") == 0 ? uri.substr(7) : uri;
+#ifdef _WIN32
+    if (path.size() > 2 && path[0] == '/' && path[2] == ':') path.erase(0, 1);
+#endif
+    std::string decoded;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '%' && i + 2 < path.size()) {
+            decoded += static_cast<char>(std::strtol(path.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += path[i];
+        }
+    }
+    return decoded;
+}
+
+// Reads the name=value lines of resources/parameters.txt
+Parameters read_parameters(cppfmu::FMIString resource_location) {
+    Parameters parameters;
+    if (!resource_location) return parameters;
+
+    std::string path = uri_to_path(resource_location);
+    if (!path.empty() && path.back() != '/') path += '/';
+    std::ifstream file(path + "parameters.txt");
+    if (!file) throw std::runtime_error("Missing resources/parameters.txt");
+
+    std::string line;
+    while (std::getline(file, line)) {
+        auto separator = line.find('=');
+        if (separator == std::string::npos) continue;
+        std::string name = line.substr(0, separator);
+        std::string value = line.substr(separator + 1);
+        for (size_t i = 0; i < kCountParameters; ++i) {
+            if (name == kCountNames[i]) parameters.counts[i] = std::stoi(value);
+        }
+        for (size_t i = 0; i < kTunables; ++i) {
+            if (name == kTunableNames[i]) parameters.tunables[i] = std::stod(value);
+        }
+        if (name == "seed") parameters.seed = std::stoi(value);
+    }
+    for (auto count : parameters.counts) {
+        if (count < 0) throw std::runtime_error("Negative variable count in parameters.txt");
+    }
+    return parameters;
+}
+
+class SyntheticSlave : public cppfmu::SlaveInstance {
+private:
+    Parameters parameters_;
+    uint64_t instance_hash_;
+    std::mt19937_64 random_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+    uint64_t step_count_ = 0;
+
+    Values<cppfmu::FMIReal> reals_;
+    Values<cppfmu::FMIInteger> integers_;
+    Values<cppfmu::FMIBoolean> booleans_;
+
+    size_t count(Count which) const { return static_cast<size_t>(parameters_.counts[which]); }
+
+    // Index into the value array of a type, inputs first; throws if out of range
+    template <typename T>
+    size_t index(const Values<T>& values, cppfmu::FMIValueReference vr) const {
+        if (vr < kFirstSignal || vr - kFirstSignal >= values.size()) {
+            throw std::out_of_range("Unknown value reference " + std::to_string(vr));
+        }
+        return vr - kFirstSignal;
+    }
+
+    // Whether the next output changes in this step
+    bool changes() {
+        double rate = parameters_.tunables[kChangeRate];
+        return rate >= 1.0 || (rate > 0.0 && uniform_(random_) < rate);
+    }
+
+    void busy_wait(double microseconds) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::micro>(microseconds);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    }
+
+    void reseed() {
+        random_.seed(static_cast<uint64_t>(parameters_.seed) ^ instance_hash_);
+        step_count_ = 0;
+    }
+
+public:
+    SyntheticSlave(cppfmu::FMIString instance_name, const Parameters& parameters, const cppfmu::Memory& memory)
+        : parameters_(parameters)
+        , instance_hash_(std::hash<std::string>{}(instance_name ? instance_name : ""))
+        , reals_(count(kRealIn) + count(kRealOut), 0.0, cppfmu::Allocator<cppfmu::FMIReal>{memory})
+        , integers_(count(kIntegerIn) + count(kIntegerOut), 0, cppfmu::Allocator<cppfmu::FMIInteger>{memory})
+        , booleans_(count(kBooleanIn) + count(kBooleanOut), cppfmu::FMIFalse,
+                    cppfmu::Allocator<cppfmu::FMIBoolean>{memory}) {
+        reseed();
+    }
+
+    void Reset() override {
+        std::fill(reals_.begin(), reals_.end(), 0.0);
+        std::fill(integers_.begin(), integers_.end(), 0);
+        std::fill(booleans_.begin(), booleans_.end(), cppfmu::FMIFalse);
+        reseed();
+    }
+
+    void SetReal(const cppfmu::FMIValueReference vr[], std::size_t nvr, const cppfmu::FMIReal value[]) override {
+        for (std::size_t i = 0; i < nvr; ++i) {
+            if (vr[i] < kTunables) parameters_.tunables[vr[i]] = value[i];
+            else reals_[index(reals_, vr[i])] = value[i];
+        }
+    }
+
+    void SetInteger(const cppfmu::FMIValueReference vr[], std::size_t nvr, const cppfmu::FMIInteger value[]) override {
+        for (std::size_t i = 0; i < nvr; ++i) {
+            if (vr[i] == kSeed) {
+                parameters_.seed = value[i];
+                reseed();
+            } else if (vr[i] < kCountParameters) {
+                // Counts shape the variable list and are fixed with it
+                if (value[i] != parameters_.counts[vr[i]]) throw std::logic_error("Variable counts are fixed");
+            } else {
+                integers_[index(integers_, vr[i])] = value[i];
+            }
+        }
+    }
+
+    void SetBoolean(const cppfmu::FMIValueReference vr[], std::size_t nvr, const cppfmu::FMIBoolean value[]) override {
+        for (std::size_t i = 0; i < nvr; ++i) booleans_[index(booleans_, vr[i])] = value[i];
+    }
+
+    void GetReal(const cppfmu::FMIValueReference vr[], std::size_t nvr, cppfmu::FMIReal value[]) const override {
+        for (std::size_t i = 0; i < nvr; ++i) {
+            value[i] = vr[i] < kTunables ? parameters_.tunables[vr[i]] : reals_[index(reals_, vr[i])];
+        }
+    }
+
+    void GetInteger(const cppfmu::FMIValueReference vr[], std::size_t nvr, cppfmu::FMIInteger value[]) const override {
+        for (std::size_t i = 0; i < nvr; ++i) {
+            if (vr[i] == kSeed) value[i] = parameters_.seed;
+            else if (vr[i] < kCountParameters) value[i] = parameters_.counts[vr[i]];
+            else value[i] = integers_[index(integers_, vr[i])];
+        }
+    }
+
+    void GetBoolean(const cppfmu::FMIValueReference vr[], std::size_t nvr, cppfmu::FMIBoolean value[]) const override {
+        for (std::size_t i = 0; i < nvr; ++i) value[i] = booleans_[index(booleans_, vr[i])];
+    }
+
+    bool DoStep(cppfmu::FMIReal current_time, cppfmu::FMIReal step_size, cppfmu::FMIBoolean,
+                cppfmu::FMIReal& end_of_step) override {
+        ++step_count_;
+        double failure_rate = parameters_.tunables[kFailureRate];
+        if (failure_rate > 0.0 && uniform_(random_) < failure_rate) {
+            end_of_step = current_time;
+            throw std::runtime_error("Injected failure in step " + std::to_string(step_count_));
+        }
+
+        // Output k follows input k of its type, if there is one, plus the time
+        double time = current_time + step_size;
+        for (size_t k = 0; k < count(kRealOut); ++k) {
+            if (!changes()) continue;
+            double input = k < count(kRealIn) ? reals_[k] : 0.0;
+            reals_[count(kRealIn) + k] = input + time;
+        }
+        for (size_t k = 0; k < count(kIntegerOut); ++k) {
+            if (!changes()) continue;
+            cppfmu::FMIInteger input = k < count(kIntegerIn) ? integers_[k] : 0;
+            integers_[count(kIntegerIn) + k] = input + static_cast<cppfmu::FMIInteger>(step_count_);
+        }
+        for (size_t k = 0; k < count(kBooleanOut); ++k) {
+            if (!changes()) continue;
+            bool input = k < count(kBooleanIn) && booleans_[k] != cppfmu::FMIFalse;
+            booleans_[count(kBooleanIn) + k] = (input != (step_count_ % 2 == 1)) ? cppfmu::FMITrue : cppfmu::FMIFalse;
+        }
+
+        double work = parameters_.tunables[kWorkUs];
+        double jitter = parameters_.tunables[kJitterUs];
+        if (jitter > 0.0) work += jitter * uniform_(random_);
+        if (work > 0.0) busy_wait(work);
+
+        end_of_step = time;
+        return true;
+    }
+};
+
+}  // namespace
+
+cppfmu::UniquePtr<cppfmu::SlaveInstance> CppfmuInstantiateSlave(
+    cppfmu::FMIString instanceName,
+    cppfmu::FMIString /*fmuGUID*/,
+    cppfmu::FMIString fmuResourceLocation,
+    cppfmu::FMIString /*mimeType*/,
+    cppfmu::FMIReal /*timeout*/,
+    cppfmu::FMIBoolean /*visible*/,
+    cppfmu::FMIBoolean /*interactive*/,
+    cppfmu::Memory memory,
+    cppfmu::Logger /*logger*/) {
+    return cppfmu::AllocateUnique<SyntheticSlave>(memory, instanceName, read_parameters(fmuResourceLocation), memory);
+}
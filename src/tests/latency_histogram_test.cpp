@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include "common/latency.hpp"
+
+// Checks that LatencyHistogram keeps every value in range, from 0 up to
+// UINT64_MAX: values past its top bucket count there, and percentiles never
+// fall below the values recorded up to that top.
+
+namespace {
+
+constexpr uint64_t kTop = (uint64_t{1} << 40) - 1;
+
+bool check(bool condition, const char* what, uint64_t value) {
+    if (!condition) std::cerr << what << " for " << value << std::endl;
+    return condition;
+}
+
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    auto longest = std::make_unique<LatencyHistogram>();
+    longest->record(UINT64_MAX);
+    ok = check(longest->count() == 1, "count() is not 1", UINT64_MAX) && ok;
+    ok = check(longest->max() == UINT64_MAX, "max() is not the value", UINT64_MAX) && ok;
+    ok = check(longest->percentile(0.5) == kTop, "percentile(0.5) is not the top bucket", UINT64_MAX) && ok;
+    ok = check(longest->percentile(1.0) == kTop, "percentile(1.0) is not the top bucket", UINT64_MAX) && ok;
+
+    // Each power of two and its neighbours, on their own
+    for (int bits = 0; bits < 64; ++bits) {
+        for (uint64_t value : {(uint64_t{1} << bits) - 1, uint64_t{1} << bits, (uint64_t{1} << bits) + 1}) {
+            auto histogram = std::make_unique<LatencyHistogram>();
+            histogram->record(value);
+            uint64_t p = histogram->percentile(1.0);
+            ok = check(histogram->count() == 1, "count() is not 1", value) && ok;
+            ok = check(p <= value, "percentile above the value", value) && ok;
+            ok = check(p >= (value < kTop ? value - value / 16 : kTop), "percentile too far below the value", value) && ok;
+        }
+    }
+
+    if (ok) std::cout << "LatencyHistogram: all values in range" << std::endl;
+    return ok ? 0 : 1;
+}
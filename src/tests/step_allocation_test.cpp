@@ -0,0 +1,173 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "simulation_protocol_generated.h"
+#include "quicclient/fmu_instance.hpp"
+
+// Checks that FmuInstance::handle_step_request makes no heap allocation once
+// warmed up, for both protocol versions and for string values longer than
+// the small-string buffer. Every operator new of the process is counted while
+// the steady-state steps run.
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<size_t> allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr uint32_t kInput = 0;
+constexpr uint32_t kOutput = 1;
+constexpr uint32_t kLabelInput = 2;
+constexpr uint32_t kLabelOutput = 3;
+constexpr uint64_t kStepUs = 1000;
+constexpr size_t kBatch = 3;
+
+// Doubles its real input and echoes its string input, holding the string in
+// a buffer reserved up front as an FMU would
+class EchoUnit : public SimulationUnit {
+private:
+    std::shared_ptr<cosim::model_description> description_;
+    double input_ = 0.0;
+    std::string label_;
+
+public:
+    EchoUnit() : description_(std::make_shared<cosim::model_description>()) {
+        using cosim::variable_causality;
+        auto add = [this](const char* name, uint32_t ref, cosim::variable_type type, variable_causality causality) {
+            description_->variables.push_back(
+                {name, ref, type, causality, cosim::variable_variability::discrete, std::nullopt});
+        };
+        add("u", kInput, cosim::variable_type::real, variable_causality::input);
+        add("y", kOutput, cosim::variable_type::real, variable_causality::output);
+        add("label_in", kLabelInput, cosim::variable_type::string, variable_causality::input);
+        add("label_out", kLabelOutput, cosim::variable_type::string, variable_causality::output);
+        label_.reserve(4096);
+    }
+
+    std::shared_ptr<const cosim::model_description> model_description() const override { return description_; }
+    void setup(cosim::time_point) override {}
+    bool do_step(cosim::time_point, cosim::duration) override { return true; }
+
+    void set_real_variables(gsl::span<const cosim::value_reference>, gsl::span<const double> values) override {
+        input_ = values[0];
+    }
+    void set_integer_variables(gsl::span<const cosim::value_reference>, gsl::span<const int>) override {}
+    void set_boolean_variables(gsl::span<const cosim::value_reference>, gsl::span<const bool>) override {}
+    void set_string_variables(gsl::span<const cosim::value_reference>, gsl::span<const std::string> values) override {
+        label_.assign(values[0]);
+    }
+
+    void get_real_variables(gsl::span<const cosim::value_reference>, gsl::span<double> values) override {
+        values[0] = 2.0 * input_;
+    }
+    void get_integer_variables(gsl::span<const cosim::value_reference>, gsl::span<int>) override {}
+    void get_boolean_variables(gsl::span<const cosim::value_reference>, gsl::span<bool>) override {}
+    void get_string_variables(gsl::span<const cosim::value_reference>, gsl::span<std::string> values) override {
+        values[0].assign(label_);
+    }
+};
+
+// A different string each step, from short to well past the small-string
+// buffer. The first request of either version, the warm-up, has short ones.
+std::string label(size_t step) {
+    if (step <= kBatch) return std::string(8, 'w');
+    static const size_t lengths[] = {8, 40, 900, 17, 600, 300, 1000};
+    return std::string(lengths[step % 7], static_cast<char>('a' + step % 26));
+}
+
+std::vector<uint8_t> finish(flatbuffers::FlatBufferBuilder& builder, SimProtocol::MessageType type,
+                            flatbuffers::Offset<void> message) {
+    builder.Finish(SimProtocol::CreateMessage(builder, type, message));
+    return {builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize()};
+}
+
+std::vector<uint8_t> step_request(size_t step) {
+    flatbuffers::FlatBufferBuilder builder;
+    std::vector<flatbuffers::Offset<SimProtocol::Variable>> inputs{
+        SimProtocol::CreateVariable(builder, 0, SimProtocol::ValueType_Real, kInput, static_cast<double>(step)),
+        SimProtocol::CreateVariable(builder, 0, SimProtocol::ValueType_String, kLabelInput, 0.0, 0, false,
+                                    builder.CreateString(label(step)))};
+    auto request = SimProtocol::CreateStepRequest(builder, kStepUs, builder.CreateVector(inputs));
+    return finish(builder, SimProtocol::MessageType_StepRequest, request.Union());
+}
+
+flatbuffers::Offset<SimProtocol::SignalVector> signal_inputs(flatbuffers::FlatBufferBuilder& builder, size_t step) {
+    std::vector<uint32_t> real_refs{kInput};
+    std::vector<double> real_values{static_cast<double>(step)};
+    std::vector<uint32_t> string_refs{kLabelInput};
+    auto real_refs_offset = builder.CreateVector(real_refs);
+    auto real_values_offset = builder.CreateVector(real_values);
+    auto string_refs_offset = builder.CreateVector(string_refs);
+    auto string_values_offset = builder.CreateVectorOfStrings(std::vector<std::string>{label(step)});
+    return SimProtocol::CreateSignalVector(builder, real_refs_offset, real_values_offset, 0, 0, 0, 0,
+                                           string_refs_offset, string_values_offset);
+}
+
+// A batch of kBatch + 1 steps asking for the outputs of every step
+std::vector<uint8_t> step_request_v2(size_t step) {
+    flatbuffers::FlatBufferBuilder builder;
+    std::vector<flatbuffers::Offset<SimProtocol::TrajectoryStep>> trajectory;
+    for (size_t i = 1; i <= kBatch; ++i) {
+        trajectory.push_back(SimProtocol::CreateTrajectoryStep(builder, kStepUs, signal_inputs(builder, step + i)));
+    }
+    auto inputs = signal_inputs(builder, step);
+    auto request = SimProtocol::CreateStepRequestV2(builder, kStepUs, 0, inputs, builder.CreateVector(trajectory), true);
+    return finish(builder, SimProtocol::MessageType_StepRequestV2, request.Union());
+}
+
+// Runs `warmup` requests, then counts the allocations of the rest
+bool run(const char* name, std::vector<uint8_t> (*make)(size_t), size_t warmup, size_t steps) {
+    std::vector<std::vector<uint8_t>> requests;
+    for (size_t i = 0; i < warmup + steps; ++i) requests.push_back(make(i * (kBatch + 1)));
+
+    FmuInstance instance(1, std::make_unique<EchoUnit>());
+    if (!instance.loaded()) {
+        std::cerr << name << ": instance failed to load" << std::endl;
+        return false;
+    }
+    flatbuffers::FlatBufferBuilder builder(256 * 1024);
+
+    bool ok = true;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (i == warmup) counting.store(true);
+        ok = instance.handle_step_request(SimProtocol::GetMessage(requests[i].data()), builder) && ok;
+    }
+    counting.store(false);
+    size_t counted = allocations.exchange(0);
+
+    if (!ok) {
+        std::cerr << name << ": a step failed" << std::endl;
+        return false;
+    }
+    if (counted != 0) {
+        std::cerr << name << ": " << counted << " allocations in " << steps << " steady-state steps" << std::endl;
+        return false;
+    }
+    std::cout << name << ": no allocations in " << steps << " steady-state steps" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    // The long strings after the warm-up must fit the capacity reserved in prepare_simulation()
+    bool ok = run("StepRequest", step_request, 1, 200);
+    ok = run("StepRequestV2", step_request_v2, 1, 200) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/signals.hpp"
+#include "common/stats.hpp"
+
+// Live view of a running server: attaches read-only to its statistics
+// segment and redraws step rate, lateness and per-client tables every
+// interval. Reading never blocks or slows the server.
+namespace {
+
+struct Options {
+    std::string segment = stats::kDefaultSegment;
+    int interval_ms = 1000;
+    std::string sort = "id";  // id, rtt, tx or rx
+    size_t rows = 0;          // 0 = every client
+    bool once = false;        // Print one sample and exit
+};
+
+// Counters of one client at one sample
+struct ClientSample {
+    uint32_t client_id;
+    bool is_local;
+    uint64_t requests, request_bytes;
+    uint64_t responses, response_bytes, round_trip_ns;
+    int64_t last_round_trip_ns;
+};
+
+struct Sample {
+    std::chrono::steady_clock::time_point taken;
+    int64_t started_ns;
+    uint64_t steps, sim_time_us;
+    int64_t lateness_ns, step_ns, updated_ns;
+    std::vector<ClientSample> clients;
+};
+
+// Per-client figures over one interval
+struct ClientRow {
+    uint32_t client_id;
+    bool is_local;
+    double requests_per_s, responses_per_s;
+    double rtt_us, last_rtt_us;
+    double tx_kb_per_s, rx_kb_per_s;
+};
+
+Sample take_sample(const StatsReader& reader) {
+    Sample sample;
+    sample.taken = std::chrono::steady_clock::now();
+    sample.started_ns = reader.header().started_ns;
+    const auto& run = reader.run();
+    sample.steps = stats::read(run.steps);
+    sample.sim_time_us = stats::read(run.sim_time_us);
+    sample.lateness_ns = stats::read(run.lateness_ns);
+    sample.step_ns = stats::read(run.step_ns);
+    sample.updated_ns = stats::read(run.updated_ns);
+    for (uint32_t i = 0; i < reader.header().client_count; ++i) {
+        const auto& client = reader.client(i);
+        sample.clients.push_back({client.requests.client_id, client.requests.is_local != 0,
+                                  stats::read(client.requests.count), stats::read(client.requests.bytes),
+                                  stats::read(client.responses.count), stats::read(client.responses.bytes),
+                                  stats::read(client.responses.round_trip_ns),
+                                  stats::read(client.responses.last_round_trip_ns)});
+    }
+    return sample;
+}
+
+std::vector<ClientRow> client_rows(const Sample& before, const Sample& after, double seconds) {
+    std::vector<ClientRow> rows;
+    for (size_t i = 0; i < after.clients.size() && i < before.clients.size(); ++i) {
+        const auto& a = before.clients[i];
+        const auto& b = after.clients[i];
+        uint64_t responses = b.responses - a.responses;
+        rows.push_back({b.client_id, b.is_local,
+                        (b.requests - a.requests) / seconds, responses / seconds,
+                        responses ? static_cast<double>(b.round_trip_ns - a.round_trip_ns) / responses / 1000.0 : 0.0,
+                        b.last_round_trip_ns / 1000.0,
+                        (b.request_bytes - a.request_bytes) / seconds / 1024.0,
+                        (b.response_bytes - a.response_bytes) / seconds / 1024.0});
+    }
+    return rows;
+}
+
+void sort_rows(std::vector<ClientRow>& rows, const std::string& key) {
+    auto by = [&rows](auto field) {
+        std::stable_sort(rows.begin(), rows.end(),
+                         [field](const ClientRow& a, const ClientRow& b) { return a.*field > b.*field; });
+    };
+    if (key == "rtt") by(&ClientRow::rtt_us);
+    else if (key == "tx") by(&ClientRow::tx_kb_per_s);
+    else if (key == "rx") by(&ClientRow::rx_kb_per_s);
+}
+
+void render(const Options& options, const Sample& before, const Sample& after) {
+    double seconds = std::chrono::duration<double>(after.taken - before.taken).count();
+    if (seconds <= 0.0) seconds = 1e-9;
+    auto rows = client_rows(before, after, seconds);
+    sort_rows(rows, options.sort);
+
+    double tx_total = 0.0, rx_total = 0.0;
+    for (const auto& row : rows) {
+        tx_total += row.tx_kb_per_s;
+        rx_total += row.rx_kb_per_s;
+    }
+
+    // No step for a while: the run is paused, stopped or stuck
+    auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        after.taken.time_since_epoch()).count();
+    bool idle = after.updated_ns == 0 || now_ns - after.updated_ns > 2'000'000'000;
+
+    if (!options.once) std::printf("\x1b[H\x1b[2J");
+    std::printf("quicsim-top  %s  every %d ms%s\n", options.segment.c_str(), options.interval_ms,
+                idle ? "  [no steps]" : "");
+    std::printf("steps %llu  rate %.1f/s  sim time %.3f s  lateness %.3f ms  last step %.1f us\n",
+                static_cast<unsigned long long>(after.steps), (after.steps - before.steps) / seconds,
+                after.sim_time_us / 1e6, after.lateness_ns / 1e6, after.step_ns / 1000.0);
+    std::printf("clients %zu  tx %.1f KB/s  rx %.1f KB/s\n\n", rows.size(), tx_total, rx_total);
+
+    std::printf("%8s %6s %10s %10s %10s %10s %11s %11s\n",
+                "client", "link", "req/s", "resp/s", "rtt us", "last us", "tx KB/s", "rx KB/s");
+    size_t shown = options.rows ? std::min(options.rows, rows.size()) : rows.size();
+    for (size_t i = 0; i < shown; ++i) {
+        const auto& row = rows[i];
+        std::printf("%8u %6s %10.1f %10.1f %10.1f %10.1f %11.1f %11.1f\n", row.client_id,
+                    row.is_local ? "shm" : "quic", row.requests_per_s, row.responses_per_s,
+                    row.rtt_us, row.last_rtt_us, row.tx_kb_per_s, row.rx_kb_per_s);
+    }
+    if (shown < rows.size()) std::printf("... %zu more\n", rows.size() - shown);
+    std::fflush(stdout);
+}
+
+bool parse(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const std::string& prefix) { return arg.substr(prefix.size()); };
+        if (arg.rfind("--segment=", 0) == 0) options.segment = value("--segment=");
+        else if (arg.rfind("--interval=", 0) == 0) options.interval_ms = std::max(50, std::stoi(value("--interval=")));
+        else if (arg.rfind("--sort=", 0) == 0) options.sort = value("--sort=");
+        else if (arg.rfind("--rows=", 0) == 0) options.rows = std::stoul(value("--rows="));
+        else if (arg == "--once") options.once = true;
+        else return false;
+    }
+    return options.sort == "id" || options.sort == "rtt" || options.sort == "tx" || options.sort == "rx";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        if (!parse(argc, argv, options)) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--segment=NAME] [--interval=MS] [--sort=id|rtt|tx|rx] [--rows=N] [--once]" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid number in arguments" << std::endl;
+        return 1;
+    }
+
+    watch_signals();
+    auto interval = std::chrono::milliseconds(options.interval_ms);
+    StatsReader reader;
+    while (!stop_requested()) {
+        // Wait for a server, and follow it when it restarts
+        if (!reader.open(options.segment)) {
+            if (options.once) {
+                std::cerr << "No statistics segment " << options.segment << std::endl;
+                return 1;
+            }
+            std::printf("\x1b[H\x1b[2JWaiting for statistics segment %s...\n", options.segment.c_str());
+            std::fflush(stdout);
+            std::this_thread::sleep_for(interval);
+            continue;
+        }
+
+        Sample before = take_sample(reader);
+        while (!stop_requested()) {
+            std::this_thread::sleep_for(interval);
+            Sample after = take_sample(reader);
+            render(options, before, after);
+            if (options.once) return 0;
+            before = std::move(after);
+
+            // A restarted server publishes a new segment under the same name
+            StatsReader current;
+            if (!current.open(options.segment) || current.header().started_ns != before.started_ns) break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""Generates a synthetic FMU and a configuration that wires many instances of
+it together, for repeatable scaling studies without real models.
+
+The FMU packs the synthetic_fmu library (built with -DQUICSIM_BUILD_SYNTHETIC_FMU=ON)
+with a model description of the requested shape. Its parameters' start
+values set the shape and load; the slave reads them from
+resources/parameters.txt. All randomness is seeded, so the same arguments
+give the same files.
+
+Example, 1000 clients with 100 outputs each on a random graph:
+    generate_synthetic.py --library build/synthetic_fmu.so --clients 1000 \\
+        --reals 100 --topology random --out-dir scale_1000
+"""
+
+import argparse
+import hashlib
+import os
+import platform
+import random
+import sys
+import zipfile
+
+# Value references of the slave, see src/synthetic_fmu/synthetic_slave.cpp
+COUNT_NAMES = ["real_inputs", "real_outputs", "integer_inputs", "integer_outputs",
+               "boolean_inputs", "boolean_outputs"]
+TUNABLE_NAMES = ["change_rate", "work_us", "jitter_us", "failure_rate"]
+SEED_REFERENCE = 6
+FIRST_SIGNAL = 16
+MODEL_IDENTIFIER = "synthetic_fmu"
+
+# Connected signals per type: (name prefix, FMI type element, input count key, output count key)
+SIGNAL_TYPES = [
+    ("real", "Real", "real_inputs", "real_outputs"),
+    ("integer", "Integer", "integer_inputs", "integer_outputs"),
+    ("boolean", "Boolean", "boolean_inputs", "boolean_outputs"),
+]
+
+
+def platform_folder():
+    bits = "64" if sys.maxsize > 2**32 else "32"
+    system = platform.system()
+    if system == "Windows":
+        return "win" + bits
+    if system == "Darwin":
+        return "darwin" + bits
+    return "linux" + bits
+
+
+def model_description(shape, tunables, seed):
+    variables = []
+    outputs = []
+
+    def add(name, reference, causality, variability, element, start=None):
+        start_attribute = ' start="%s"' % start if start is not None else ""
+        variables.append(
+            '    <ScalarVariable name="%s" valueReference="%d" causality="%s" variability="%s">\n'
+            '      <%s%s/>\n'
+            '    </ScalarVariable>' % (name, reference, causality, variability, element, start_attribute))
+        if causality == "output":
+            outputs.append(len(variables))
+
+    for reference, name in enumerate(COUNT_NAMES):
+        add(name, reference, "parameter", "fixed", "Integer", shape[name])
+    add("seed", SEED_REFERENCE, "parameter", "fixed", "Integer", seed)
+    for reference, name in enumerate(TUNABLE_NAMES):
+        add(name, reference, "parameter", "tunable", "Real", repr(float(tunables[name])))
+
+    for prefix, element, inputs_key, outputs_key in SIGNAL_TYPES:
+        variability = "continuous" if element == "Real" else "discrete"
+        inputs = shape[inputs_key]
+        initial = "0.0" if element == "Real" else ("false" if element == "Boolean" else "0")
+        for i in range(inputs):
+            add("%s_in_%d" % (prefix, i), FIRST_SIGNAL + i, "input", variability, element, initial)
+        for k in range(shape[outputs_key]):
+            add("%s_out_%d" % (prefix, k), FIRST_SIGNAL + inputs + k, "output", variability, element)
+
+    shape_key = repr((sorted(shape.items()), sorted(tunables.items()), seed)).encode()
+    guid = "{%s}" % hashlib.md5(shape_key).hexdigest()
+    unknowns = "\n".join('      <Unknown index="%d"/>' % index for index in outputs)
+    return (
+        '<?xml version="1.0" encoding="UTF-8"?>\n'
+        '<fmiModelDescription fmiVersion="2.0" modelName="synthetic" guid="%s"\n'
+        '    generationTool="generate_synthetic.py" variableNamingConvention="flat" numberOfEventIndicators="0">\n'
+        '  <CoSimulation modelIdentifier="%s" canHandleVariableCommunicationStepSize="true"/>\n'
+        '  <ModelVariables>\n%s\n  </ModelVariables>\n'
+        '  <ModelStructure>\n    <Outputs>\n%s\n    </Outputs>\n  </ModelStructure>\n'
+        '</fmiModelDescription>\n' % (guid, MODEL_IDENTIFIER, "\n".join(variables), unknowns))
+
+
+def write_fmu(path, library, shape, tunables, seed):
+    parameters = ["%s=%d" % (name, shape[name]) for name in COUNT_NAMES]
+    parameters.append("seed=%d" % seed)
+    parameters += ["%s=%r" % (name, float(tunables[name])) for name in TUNABLE_NAMES]
+
+    extension = os.path.splitext(library)[1]
+    with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as fmu:
+        fmu.writestr("modelDescription.xml", model_description(shape, tunables, seed))
+        fmu.write(library, "binaries/%s/%s%s" % (platform_folder(), MODEL_IDENTIFIER, extension))
+        fmu.writestr("resources/parameters.txt", "\n".join(parameters) + "\n")
+
+
+def connect(connections, used_inputs, source, target, prefix, output, input_):
+    """Adds one connection unless the input is already fed."""
+    key = (target, prefix, input_)
+    if key in used_inputs:
+        return
+    used_inputs.add(key)
+    connections.append((source, "%s_out_%d" % (prefix, output), target, "%s_in_%d" % (prefix, input_)))
+
+
+def build_connections(args, shape, rng):
+    clients = list(range(1, args.clients + 1))
+    connections = []
+    used_inputs = set()
+
+    for prefix, _, inputs_key, outputs_key in SIGNAL_TYPES:
+        inputs = shape[inputs_key]
+        outputs = shape[outputs_key]
+        if inputs == 0 or outputs == 0:
+            continue
+        width = min(inputs, outputs)
+
+        if args.topology == "chain":
+            # Client i feeds client i + 1, output k to input k
+            for source, target in zip(clients, clients[1:]):
+                for k in range(width):
+                    connect(connections, used_inputs, source, target, prefix, k, k)
+
+        elif args.topology == "star":
+            # The hub feeds every leaf, and each leaf feeds its share of the hub's inputs
+            hub, leaves = clients[0], clients[1:]
+            for leaf in leaves:
+                for k in range(width):
+                    connect(connections, used_inputs, hub, leaf, prefix, k, k)
+            for index, leaf in enumerate(leaves):
+                input_ = index % inputs
+                connect(connections, used_inputs, leaf, hub, prefix, index % outputs, input_)
+
+        else:
+            # Each input is fed, with probability `density`, by a random output of another client
+            for target in clients:
+                for input_ in range(inputs):
+                    if len(clients) < 2 or rng.random() >= args.density:
+                        continue
+                    source = rng.choice(clients)
+                    while source == target:
+                        source = rng.choice(clients)
+                    connect(connections, used_inputs, source, target, prefix, rng.randrange(outputs), input_)
+
+    return connections
+
+
+def write_config(path, args, fmu_path, connections):
+    lines = [
+        "# Generated by generate_synthetic.py: %d synthetic clients, %s topology, %d connections"
+        % (args.clients, args.topology, len(connections)),
+        "# Arguments: %s" % " ".join(sys.argv[1:]),
+        'fmu_cache: ""',
+        "",
+        "server:",
+        "  port: 8080",
+        "  max_clients: %d" % args.clients,
+        "  shared_memory_size: %d" % args.shared_memory_size,
+        "  string_pool_size: 262144",
+        "  local_slot_count: 4",
+        "  local_slot_size: %d" % args.slot_size,
+        "  worker_threads: 0",
+        "  compression_threshold: 0",
+        "",
+        "clients:",
+    ]
+    for client in range(1, args.clients + 1):
+        lines += [
+            "  - id: %d" % client,
+            '    type: "%s"' % args.client_type,
+            '    fmu_path: "%s"' % fmu_path,
+        ]
+
+    if args.hosts > 0:
+        lines += ["", "hosts:"]
+        for host in range(args.hosts):
+            instances = list(range(host + 1, args.clients + 1, args.hosts))
+            lines += [
+                '  - name: "node%d"' % (host + 1),
+                '    server: "localhost"',
+                "    port: 8080",
+                "    worker_threads: 0",
+                "    step_cpu: -1",
+                "    instances: [%s]" % ", ".join(str(i) for i in instances),
+            ]
+
+    lines += ["", "connections:"]
+    for source, output, target, input_ in connections:
+        lines += [
+            "  - from: { client: %d, variable: \"%s\" }" % (source, output),
+            "    to: { client: %d, variable: \"%s\" }" % (target, input_),
+        ]
+    if not connections:
+        lines[-1] = "connections: []"
+
+    with open(path, "w") as config:
+        config.write("\n".join(lines) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--library", required=True, help="built synthetic_fmu shared library")
+    parser.add_argument("--out-dir", required=True, help="where synthetic.fmu and simulation.yaml go")
+    parser.add_argument("--clients", type=int, default=10)
+    parser.add_argument("--topology", choices=["chain", "star", "random"], default="chain")
+    parser.add_argument("--density", type=float, default=0.5,
+                        help="random topology: fraction of inputs that are connected")
+    parser.add_argument("--reals", type=int, default=10, help="real inputs and outputs per client")
+    parser.add_argument("--integers", type=int, default=0, help="integer inputs and outputs per client")
+    parser.add_argument("--booleans", type=int, default=0, help="boolean inputs and outputs per client")
+    parser.add_argument("--change-rate", type=float, default=1.0, help="fraction of outputs changed per step")
+    parser.add_argument("--work-us", type=float, default=0.0, help="busy-wait per step in microseconds")
+    parser.add_argument("--jitter-us", type=float, default=0.0, help="largest extra busy-wait per step")
+    parser.add_argument("--failure-rate", type=float, default=0.0, help="probability that a step fails")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the FMU draws and the random topology")
+    parser.add_argument("--client-type", choices=["local", "remote"], default="local")
+    parser.add_argument("--hosts", type=int, default=1, help="client hosts the instances are spread over, 0 = none")
+    parser.add_argument("--slot-size", type=int, default=16384, help="server.local_slot_size")
+    parser.add_argument("--shared-memory-size", type=int, default=0,
+                        help="server.shared_memory_size, 0 = sized for the rings")
+    args = parser.parse_args()
+
+    if args.clients < 1:
+        parser.error("--clients must be at least 1")
+    if args.shared_memory_size == 0:
+        # Two rings of four slots per client plus the string pool, with headroom
+        args.shared_memory_size = 2 * (args.clients * 2 * 4 * (args.slot_size + 128) + 262144) + 1048576
+
+    shape = {
+        "real_inputs": args.reals, "real_outputs": args.reals,
+        "integer_inputs": args.integers, "integer_outputs": args.integers,
+        "boolean_inputs": args.booleans, "boolean_outputs": args.booleans,
+    }
+    tunables = {
+        "change_rate": args.change_rate, "work_us": args.work_us,
+        "jitter_us": args.jitter_us, "failure_rate": args.failure_rate,
+    }
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    fmu_path = os.path.abspath(os.path.join(args.out_dir, "synthetic.fmu"))
+    write_fmu(fmu_path, args.library, shape, tunables, args.seed)
+
+    connections = build_connections(args, shape, random.Random(args.seed))
+    config_path = os.path.join(args.out_dir, "simulation.yaml")
+    write_config(config_path, args, fmu_path.replace("\\", "/"), connections)
+    print("Wrote %s and %s with %d connections" % (fmu_path, config_path, len(connections)))
+
+
+if __name__ == "__main__":
+    main()